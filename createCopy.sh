@@ -32,4 +32,4 @@ fi
 
 ##Copying the files to the new directory. 
 printf "Copying the files to $Directory ...\n"
-`cp -r *.cpp *.c *.h Makefile *.py createCopy.sh input docs  instructionNewFormat_3_0_8_PerOpClassEnergyMap_TechScaled.txt execute.sh LICENSE README AUTHORS $Directory`
+`cp -r *.cpp *.c *.h Makefile *.py createCopy.sh input docs  instructionNewFormat_3_0_8_PerOpClassEnergyMap_TechScaled.txt execute.sh scalingBenchmark.sh LICENSE README AUTHORS $Directory`
@@ -12,3 +12,6 @@ export SAFE_INPUT_PATH=$SAFE_PATH/input
 #cd /home/jmonsal/intel/projdocs/sa-api/
 #./safe Queue1.NoLocality.BLAS2
 ./safe $QUEUE_NAME
+
+#write the block logs from the binary log (LOG_ASYNC)
+[[ -f logs/safe-log.bin ]] && ./safe-log2text logs/safe-log.bin
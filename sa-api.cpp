@@ -35,8 +35,36 @@
 #include "ss-conf.h"
 #include "ss-agent.h"
 #include "ss-pack.h"
+#include "sa-fields.h"
+#include "ss-trace.h"
+#include "ss-guidmap.h"
 
 /* C style declarations because these implement the SA API. */
+//Note: both are generated from the field table in sa-fields.h, the typed
+//      accessors there (sa::get/sa::set) avoid the runtime dispatch.
+
+#define _SA_SET_FIELD(TYPE, ATTR, CODEC) \
+    case ATTR: { sa::Field<TYPE, ATTR>::set(*md, *(sa::Field<TYPE, ATTR>::Value*)val); break; }
+
+#define _SA_GET_FIELD(TYPE, ATTR, CODEC) \
+    case ATTR: { *(sa::Field<TYPE, ATTR>::Value*)val = sa::Field<TYPE, ATTR>::get(*md); break; }
+
+#define _SA_TYPE(TYPE, STRUCTURE, FIELDS, NAME, ACCESS, VERB) \
+    case TYPE: \
+    { \
+        STRUCTURE* md = (STRUCTURE*)metadata; \
+        switch (attr) \
+        { \
+            FIELDS(ACCESS, TYPE) \
+            default: \
+                printf("WARNING: attempt to " VERB " unsupported attribute for " NAME " metadata.\n"); \
+                return -1; \
+        } \
+        return 0; \
+    }
+
+#define _SA_SET_TYPE(TYPE, STRUCTURE, FIELDS, NAME) _SA_TYPE(TYPE, STRUCTURE, FIELDS, NAME, _SA_SET_FIELD, "set")
+#define _SA_GET_TYPE(TYPE, STRUCTURE, FIELDS, NAME) _SA_TYPE(TYPE, STRUCTURE, FIELDS, NAME, _SA_GET_FIELD, "retrieve")
 
 u8 saSetMetadata(void* metadata, saMetadataAttr attr, void* val)
 {
@@ -44,108 +72,7 @@ u8 saSetMetadata(void* metadata, saMetadataAttr attr, void* val)
     {
         switch (((saMetadata*)metadata)->SA_ATR_METADATA_TYPE)
         {
-            case SA_METADATA_TYPE_EDT_INFO:
-            {
-                saEdtInfoMetadata* md = (saEdtInfoMetadata*)metadata;
-                assert(md->SA_ATR_METADATA_TYPE==SA_METADATA_TYPE_EDT_INFO);
-                switch (attr)
-                {
-                    case SA_ATR_METADATA_TYPE:        { md->SA_ATR_METADATA_TYPE        = *(u64*)val; break; }
-                    case SA_ATR_URGENCY:              { md->SA_ATR_URGENCY              = *(u64*)val; break; }
-                    case SA_ATR_UTILITY_SCORE:        { md->SA_ATR_UTILITY_SCORE        = *(u64*)val; break; }
-                    case SA_ATR_OPS_FP:               { md->SA_ATR_OPS_FP               = *(u64*)val; break; }
-                    case SA_ATR_OPS_INT:              { md->SA_ATR_OPS_INT              = *(u64*)val; break; }
-                    case SA_ATR_MEM_DMA_SCORE:        { md->SA_ATR_MEM_DMA_SCORE        = *(u64*)val; break; }
-                    case SA_ATR_MEM_LOCAL_SCORE:      { md->SA_ATR_MEM_LOCAL_SCORE      = *(u64*)val; break; }
-                    case SA_ATR_MEM_REMOTE_SCORE:     { md->SA_ATR_MEM_REMOTE_SCORE     = *(u64*)val; break; }
-                    case SA_ATR_POW_STATIC:           { md->SA_ATR_POW_STATIC           = *(u64*)val; break; }
-                    case SA_ATR_POW_DYNAMIC_INTERNAL: { md->SA_ATR_POW_DYNAMIC_INTERNAL = *(u64*)val; break; }
-                    case SA_ATR_POW_DYNAMIC_EXTERNAL: { md->SA_ATR_POW_DYNAMIC_EXTERNAL = *(u64*)val; break; }
-                    default:
-                        printf("WARNING: attempt to retrieve unsupported attribute for EDT metadata.\n");
-                        return -1;
-                }
-                return 0;
-            }
-            case SA_METADATA_TYPE_BLK_INFO:
-            {
-                saBlkInfoMetadata* md = (saBlkInfoMetadata*)metadata;
-                assert(md->SA_ATR_METADATA_TYPE==SA_METADATA_TYPE_BLK_INFO);
-                switch (attr)
-                {
-                    case SA_ATR_METADATA_TYPE:    { md->SA_ATR_METADATA_TYPE    = *(u64*)val; break; }
-                    case SA_ATR_URGENCY:          { md->SA_ATR_URGENCY          = *(u64*)val; break; }
-                    case SA_ATR_UTILITY_SCORE:    { md->SA_ATR_UTILITY_SCORE    = *(u64*)val; break; }
-                    case SA_ATR_MEM_DMA_SCORE:    { md->SA_ATR_MEM_DMA_SCORE    = *(u64*)val; break; }
-                    case SA_ATR_MEM_LOCAL_SCORE:  { md->SA_ATR_MEM_LOCAL_SCORE  = *(u64*)val; break; }
-                    case SA_ATR_MEM_REMOTE_SCORE: { md->SA_ATR_MEM_REMOTE_SCORE = *(u64*)val; break; }
-                    case SA_ATR_FUB_XE_COUNT:     { md->SA_ATR_FUB_XE_COUNT     = *(u64*)val; break; }
-                    case SA_ATR_FUB_FPU_COUNT:    { md->SA_ATR_FUB_FPU_COUNT    = *(u64*)val; break; }
-                    case SA_ATR_FUB_BSM_COUNT:    { md->SA_ATR_FUB_BSM_COUNT    = *(u64*)val; break; }
-                    case SA_ATR_FUB_DVFS_SCORE:   { md->SA_ATR_FUB_DVFS_SCORE   = *(u64*)val; break; }
-                    case SA_ATR_FUB_POW_SCORE:    { md->SA_ATR_FUB_POW_SCORE    = packPowerData(*(FLOAT_TYPE*)val, MAX_POWER_PER_BLOCK, 16); break; }
-                    case SA_ATR_FUB_TEMP_SCORE:   { md->SA_ATR_FUB_TEMP_SCORE   = *(FLOAT_TYPE*)val; break; }
-                    default:
-                        printf("WARNING: attempt to retrieve unsupported attribute for BLK INFO metadata.\n");
-                        return -1;
-                }
-                return 0;
-            }
-            case SA_METADATA_TYPE_AGG_INFO:
-            {
-                saAggInfoMetadata* md = (saAggInfoMetadata*)metadata;
-                assert(md->SA_ATR_METADATA_TYPE==SA_METADATA_TYPE_AGG_INFO);
-                switch (attr)
-                {
-                    case SA_ATR_METADATA_TYPE: { md->SA_ATR_METADATA_TYPE = *(u64*)val; break; }
-                    case SA_ATR_URGENCY:       { md->SA_ATR_URGENCY       = *(u64*)val; break; }
-                    case SA_ATR_AGG_POW_MEAN:  { md->SA_ATR_AGG_POW_MEAN  = packPowerData(*(FLOAT_TYPE*)val, MAX_POWER_PER_BLOCK, 16); break; }
-                    case SA_ATR_AGG_POW_SD:    { md->SA_ATR_AGG_POW_SD    = packPowerData(*(FLOAT_TYPE*)val, MAX_POWER_PER_BLOCK, 12); break; }
-                    case SA_ATR_AGG_POW_SKEW:  { md->SA_ATR_AGG_POW_SKEW  = packSkewData(*(FLOAT_TYPE*)val); break; }
-                    case SA_ATR_AGG_TEMP_MEAN: { md->SA_ATR_AGG_TEMP_MEAN = packTemperatureData(*(FLOAT_TYPE*)val); break; }
-                    case SA_ATR_AGG_TEMP_SD:   { md->SA_ATR_AGG_TEMP_SD   = packTemperatureData(*(FLOAT_TYPE*)val); break; }
-                    case SA_ATR_AGG_TEMP_SKEW: { md->SA_ATR_AGG_TEMP_SKEW = packSkewData(*(FLOAT_TYPE*)val); break; }
-                    default:
-                        printf("WARNING: attempt to retrieve unsupported attribute for AGG INFO metadata.\n");
-                        return -1;
-                }
-                return 0;
-            }
-            case SA_METADATA_TYPE_BLK_CTRL:
-            {
-                saBlkCtrlMetadata* md = (saBlkCtrlMetadata*)metadata;
-                assert(md->SA_ATR_METADATA_TYPE==SA_METADATA_TYPE_BLK_CTRL);
-                switch (attr)
-                {
-                    case SA_ATR_METADATA_TYPE:    { md->SA_ATR_METADATA_TYPE     = *(u64*)val; break; }
-                    case SA_ATR_URGENCY:          { md->SA_ATR_URGENCY           = *(u64*)val; break; }
-                    case SA_ATR_FUB_CTRL:         { md->SA_ATR_FUB_CTRL          = *(u64*)val; break; }
-                    case SA_ATR_FUB_XE_COUNT:     { md->SA_ATR_FUB_XE_COUNT      = *(u64*)val; break; }
-                    case SA_ATR_FUB_FPU_COUNT:    { md->SA_ATR_FUB_FPU_COUNT     = *(u64*)val; break; }
-                    case SA_ATR_FUB_BSM_COUNT:    { md->SA_ATR_FUB_BSM_COUNT     = *(u64*)val; break; }
-                    case SA_ATR_FUB_DVFS_SCORE:   { md->SA_ATR_FUB_DVFS_SCORE    = *(u64*)val; break; }
-                    case SA_ATR_FUB_POWER_GOAL:   { md->SA_ATR_FUB_POWER_GOAL    = packPowerData(*(FLOAT_TYPE*)val, MAX_POWER_PER_BLOCK, 16); break; }
-                    case SA_ATR_FUB_UNDER_CONTROL:{ md->SA_ATR_FUB_UNDER_CONTROL = *(u64*)val; break; }
-                    default:
-                        printf("WARNING: attempt to retrieve unsupported attribute for CTRL metadata.\n");
-                        return -1;
-                }
-                return 0;
-            }
-            case SA_METADATA_TYPE_ERR_INFO:
-            {
-                saErrInfoMetadata* md = (saErrInfoMetadata*)metadata;
-                assert(md->SA_ATR_METADATA_TYPE==SA_METADATA_TYPE_ERR_INFO);
-                switch (attr)
-                {
-                    case SA_ATR_METADATA_TYPE:    { md->SA_ATR_METADATA_TYPE = *(u64*)val; break; }
-                    case SA_ATR_URGENCY:          { md->SA_ATR_URGENCY       = *(u64*)val; break; }
-                    default:
-                        printf("WARNING: attempt to retrieve unsupported attribute for CTRL metadata.\n");
-                        return -1;
-                }
-                return 0;
-            }
+            SA_METADATA_TABLE(_SA_SET_TYPE)
         }
         printf("WARNING: unsupported metadata type.\n");
         return -1;
@@ -154,116 +81,14 @@ u8 saSetMetadata(void* metadata, saMetadataAttr attr, void* val)
     return -1;
 }
 
-//Code is almost exactly the same as saSetMetadata.
+//Code is exactly the same as saSetMetadata.
 u8 saGetMetadata(void* metadata, saMetadataAttr attr, void* val)
 {
     if (metadata != NULL)
     {
         switch (((saMetadata*)metadata)->SA_ATR_METADATA_TYPE)
         {
-
-            case SA_METADATA_TYPE_EDT_INFO:
-            {
-                saEdtInfoMetadata* md = (saEdtInfoMetadata*)metadata;
-                assert(md->SA_ATR_METADATA_TYPE==SA_METADATA_TYPE_EDT_INFO);
-                switch (attr)
-                {
-                    case SA_ATR_METADATA_TYPE:        { *(u64*)val = md->SA_ATR_METADATA_TYPE; break; }
-                    case SA_ATR_URGENCY:              { *(u64*)val = md->SA_ATR_URGENCY; break; }
-                    case SA_ATR_UTILITY_SCORE:        { *(u64*)val = md->SA_ATR_UTILITY_SCORE; break; }
-                    case SA_ATR_OPS_FP:               { *(u64*)val = md->SA_ATR_OPS_FP; break; }
-                    case SA_ATR_OPS_INT:              { *(u64*)val = md->SA_ATR_OPS_INT; break; }
-                    case SA_ATR_MEM_DMA_SCORE:        { *(u64*)val = md->SA_ATR_MEM_DMA_SCORE; break; }
-                    case SA_ATR_MEM_LOCAL_SCORE:      { *(u64*)val = md->SA_ATR_MEM_LOCAL_SCORE; break; }
-                    case SA_ATR_MEM_REMOTE_SCORE:     { *(u64*)val = md->SA_ATR_MEM_REMOTE_SCORE; break; }
-                    case SA_ATR_POW_STATIC:           { *(u64*)val = md->SA_ATR_POW_STATIC; break; }
-                    case SA_ATR_POW_DYNAMIC_INTERNAL: { *(u64*)val = md->SA_ATR_POW_DYNAMIC_INTERNAL; break; }
-                    case SA_ATR_POW_DYNAMIC_EXTERNAL: { *(u64*)val = md->SA_ATR_POW_DYNAMIC_EXTERNAL; break; }
-                    default:
-                        printf("WARNING: attempt to retrieve unsupported attribute for EDT metadata.\n");
-                        return -1;
-                }
-                return 0;
-            }
-            case SA_METADATA_TYPE_BLK_INFO:
-            {
-                saBlkInfoMetadata* md = (saBlkInfoMetadata*)metadata;
-                assert(md->SA_ATR_METADATA_TYPE==SA_METADATA_TYPE_BLK_INFO);
-                switch (attr)
-                {
-                    case SA_ATR_METADATA_TYPE:    { *(u64*)val    = md->SA_ATR_METADATA_TYPE; break; }
-                    case SA_ATR_URGENCY:          { *(u64*)val    = md->SA_ATR_URGENCY; break; }
-                    case SA_ATR_UTILITY_SCORE:    { *(u64*)val    = md->SA_ATR_UTILITY_SCORE; break; }
-                    case SA_ATR_MEM_DMA_SCORE:    { *(u64*)val    = md->SA_ATR_MEM_DMA_SCORE; break; }
-                    case SA_ATR_MEM_LOCAL_SCORE:  { *(u64*)val    = md->SA_ATR_MEM_LOCAL_SCORE; break; }
-                    case SA_ATR_MEM_REMOTE_SCORE: { *(u64*)val    = md->SA_ATR_MEM_REMOTE_SCORE; break; }
-                    case SA_ATR_FUB_XE_COUNT:     { *(u64*)val    = md->SA_ATR_FUB_XE_COUNT; break; }
-                    case SA_ATR_FUB_FPU_COUNT:    { *(u64*)val    = md->SA_ATR_FUB_FPU_COUNT; break; }
-                    case SA_ATR_FUB_BSM_COUNT:    { *(u64*)val    = md->SA_ATR_FUB_BSM_COUNT; break; }
-                    case SA_ATR_FUB_DVFS_SCORE:   { *(u64*)val    = md->SA_ATR_FUB_DVFS_SCORE; break; }
-                    case SA_ATR_FUB_POW_SCORE:    { *(FLOAT_TYPE*)val = unpackPowerData(md->SA_ATR_FUB_POW_SCORE, MAX_POWER_PER_BLOCK, 16); break; }
-                    case SA_ATR_FUB_TEMP_SCORE:   { *(FLOAT_TYPE*)val = md->SA_ATR_FUB_TEMP_SCORE; break; }
-                    default:
-                        printf("WARNING: attempt to retrieve unsupported attribute for BLK INFO metadata.\n");
-                        return -1;
-                }
-                return 0;
-            }
-            case SA_METADATA_TYPE_AGG_INFO:
-            {
-                saAggInfoMetadata* md = (saAggInfoMetadata*)metadata;
-                assert(md->SA_ATR_METADATA_TYPE==SA_METADATA_TYPE_AGG_INFO);
-                switch (attr)
-                {
-                    case SA_ATR_METADATA_TYPE: { *(u64*)val    = md->SA_ATR_METADATA_TYPE; break; }
-                    case SA_ATR_URGENCY:       { *(u64*)val    = md->SA_ATR_URGENCY; break; }
-                    case SA_ATR_AGG_POW_MEAN:  { *(FLOAT_TYPE*)val = unpackPowerData(md->SA_ATR_AGG_POW_MEAN, MAX_POWER_PER_BLOCK, 16); break; }
-                    case SA_ATR_AGG_POW_SD:    { *(FLOAT_TYPE*)val = unpackPowerData(md->SA_ATR_AGG_POW_SD, MAX_POWER_PER_BLOCK, 12); break; }
-                    case SA_ATR_AGG_POW_SKEW:  { *(FLOAT_TYPE*)val = unpackSkewData(md->SA_ATR_AGG_POW_SKEW); break; }
-                    case SA_ATR_AGG_TEMP_MEAN: { *(FLOAT_TYPE*)val = unpackTemperatureData(md->SA_ATR_AGG_TEMP_MEAN); break; }
-                    case SA_ATR_AGG_TEMP_SD:   { *(FLOAT_TYPE*)val = unpackTemperatureData(md->SA_ATR_AGG_TEMP_SD); break; }
-                    case SA_ATR_AGG_TEMP_SKEW: { *(FLOAT_TYPE*)val = unpackSkewData(md->SA_ATR_AGG_TEMP_SKEW); break; }
-                    default:
-                        printf("WARNING: attempt to retrieve unsupported attribute for AGG INFO metadata.\n");
-                        return -1;
-                }
-                return 0;
-            }
-            case SA_METADATA_TYPE_BLK_CTRL:
-            {
-                saBlkCtrlMetadata* md = (saBlkCtrlMetadata*)metadata;
-                assert(md->SA_ATR_METADATA_TYPE==SA_METADATA_TYPE_BLK_CTRL);
-                switch (attr)
-                {
-                    case SA_ATR_METADATA_TYPE:    { *(u64*)val = md->SA_ATR_METADATA_TYPE; break; }
-                    case SA_ATR_URGENCY:          { *(u64*)val = md->SA_ATR_URGENCY; break; }
-                    case SA_ATR_FUB_CTRL:         { *(u64*)val = md->SA_ATR_FUB_CTRL; break; }
-                    case SA_ATR_FUB_XE_COUNT:     { *(u64*)val = md->SA_ATR_FUB_XE_COUNT; break; }
-                    case SA_ATR_FUB_FPU_COUNT:    { *(u64*)val = md->SA_ATR_FUB_FPU_COUNT; break; }
-                    case SA_ATR_FUB_BSM_COUNT:    { *(u64*)val = md->SA_ATR_FUB_BSM_COUNT; break; }
-                    case SA_ATR_FUB_DVFS_SCORE:   { *(u64*)val = md->SA_ATR_FUB_DVFS_SCORE; break; }
-                    case SA_ATR_FUB_POWER_GOAL:   { *(FLOAT_TYPE*)val = unpackPowerData(md->SA_ATR_FUB_POWER_GOAL, MAX_POWER_PER_BLOCK, 16); break; }
-                    case SA_ATR_FUB_UNDER_CONTROL:{ *(u64*)val = md->SA_ATR_FUB_UNDER_CONTROL; break; }
-                    default:
-                      printf("WARNING: attempt to retrieve unsupported attribute for CTRL metadata.\n");
-                      return -1;
-                }
-                return 0;
-            }
-            case SA_METADATA_TYPE_ERR_INFO:
-            {
-                saErrInfoMetadata* md = (saErrInfoMetadata*)metadata;
-                assert(md->SA_ATR_METADATA_TYPE==SA_METADATA_TYPE_ERR_INFO);
-                switch (attr)
-                {
-                    case SA_ATR_METADATA_TYPE: { *(u64*)val = md->SA_ATR_METADATA_TYPE; break; }
-                    case SA_ATR_URGENCY:       { *(u64*)val = md->SA_ATR_URGENCY; break; }
-                    default:
-                        printf("WARNING: attempt to retrieve unsupported attribute for CTRL metadata.\n");
-                        return -1;
-                }
-                return 0;
-            }
+            SA_METADATA_TABLE(_SA_GET_TYPE)
         }
         printf("WARNING: unsupported metadata type.\n");
         return -1;
@@ -272,85 +97,154 @@ u8 saGetMetadata(void* metadata, saMetadataAttr attr, void* val)
     return -1;
 }
 
+#undef _SA_SET_FIELD
+#undef _SA_GET_FIELD
+#undef _SA_TYPE
+#undef _SA_SET_TYPE
+#undef _SA_GET_TYPE
+
 
-#include <map>
-typedef std::map <ocrGuid_t*, saEdtInfoMetadata> _saGuidMap;
-_saGuidMap _saEdtToMetadataMap;
+/*
+    EDT metadata is kept in a sharded open-addressing table keyed by the GUID
+    so EDTs can be created and looked up from many threads at once.
+*/
+static GuidMap<saEdtInfoMetadata> _saEdtToMetadataMap;
 
 u8 ocrInitMetadata(ocrGuid_t* guid, saEdtInfoMetadata* metadata)
 {
     if (metadata != NULL)
     {
         assert(metadata->SA_ATR_METADATA_TYPE==SA_METADATA_TYPE_EDT_INFO);
-        _saEdtToMetadataMap.at(guid) = *metadata;
+        _saEdtToMetadataMap.insert((const void*) guid, *metadata);
     }
     else
     {
-        saEdtInfoMetadata defaultMetadata = {0};
-        defaultMetadata.SA_ATR_METADATA_TYPE = SA_METADATA_TYPE_EDT_INFO;
-        _saEdtToMetadataMap[guid] = defaultMetadata;
+        saEdtInfoMetadata defaultMetadata = SA_EDT_INFO_METADATA_INITIALIZER;
+        _saEdtToMetadataMap.insert((const void*) guid, defaultMetadata);
     }
     return 0;
 }
 
+u8 ocrInitMetadataBulk(ocrGuid_t** guids, saEdtInfoMetadata* metadata, u64 count)
+{
+    for (u64 i = 0; i < count; i++)
+        assert(metadata[i].SA_ATR_METADATA_TYPE==SA_METADATA_TYPE_EDT_INFO);
+    _saEdtToMetadataMap.insertBulk((const void* const*) guids, metadata, count);
+    return 0;
+}
+
+u8 ocrDestroyMetadata(ocrGuid_t* guid)
+{
+    return _saEdtToMetadataMap.erase((const void*) guid) ? 0 : -1;
+}
+
+u8 ocrDestroyMetadataBulk(ocrGuid_t** guids, u64 count)
+{
+    return _saEdtToMetadataMap.eraseBulk((const void* const*) guids, count) == count ? 0 : -1;
+}
+
 u8 ocrSetMetadata(ocrGuid_t* guid, saMetadataAttr attr, u16* val)
 {
-    _saGuidMap::iterator it = _saEdtToMetadataMap.find(guid);
-    assert(it->second.SA_ATR_METADATA_TYPE==SA_METADATA_TYPE_EDT_INFO); //sanity.
-    if (it != _saEdtToMetadataMap.end())
-    {
-        return saSetMetadata(&it->second, attr, val);
-    }
-    else
+    u8 ret = -1;
+    u64 wide = *val; // the SA API works on 64 bit values.
+    if (!_saEdtToMetadataMap.update((const void*) guid, [&](saEdtInfoMetadata& md)
     {
+        assert(md.SA_ATR_METADATA_TYPE==SA_METADATA_TYPE_EDT_INFO); //sanity.
+        ret = saSetMetadata(&md, attr, &wide);
+    }))
         return -1;
-    }
+    return ret;
 }
 
 u8 ocrGetMetadata(ocrGuid_t* guid, saMetadataAttr attr, u16* val)
 {
-    _saGuidMap::iterator it = _saEdtToMetadataMap.find(guid);
-    assert(it->second.SA_ATR_METADATA_TYPE==SA_METADATA_TYPE_EDT_INFO); //sanity.
-    if (it != _saEdtToMetadataMap.end())
-    {
-        return saGetMetadata(&it->second, attr, val);
-    }
-    else
-    {
+    saEdtInfoMetadata md;
+    if (!_saEdtToMetadataMap.lookup((const void*) guid, md))
         return -1;
-    }
+    assert(md.SA_ATR_METADATA_TYPE==SA_METADATA_TYPE_EDT_INFO); //sanity.
+
+    u64 wide;
+    u8 ret = saGetMetadata(&md, attr, &wide);
+    if (ret == 0)
+        *val = wide;
+    return ret;
 }
 
 /*
-    The new mailbox layout is such that the child 'owns' the slots. This means
-    that the slots are allocated in the child's local memory. For each role
-    the child has a 64-bit read and write slot in the following configuration:
-    [Br][Bw][Ur][Uw][Cr][Cw]
-
-    In other words, there are r/w block, unit, and chip slots allocated consecutively.
+    The mailbox layout is such that the child 'owns' the mailboxes. This means
+    that they are allocated in the child's mailbox area. For each role the
+    child has an up (child to parent) and a down (parent to child) SPSC ring,
+    plus an urgent lane in each direction:
+    [Bu][Bd][Bu!][Bd!] [Uu][Ud][Uu!][Ud!] [Cu][Cd][Cu!][Cd!]
+
+    In other words, there are up/down block, unit, and chip rings. Each ring has
+    exactly one producer and one consumer so no locks are needed. Messages with
+    SA_ATR_URGENCY set travel on the urgent lane, which is received first.
 */
 
-u8 saSendMetadata(saLocation location, void* metadata)
+/* Ring a location refers to -- the direction flips for parent locations. */
+static auto inline saRing(saLocation location, bool send, bool urgent) -> SpscRing<u64, MAILBOX_DEPTH>&
 {
-    //new simplified mailbox layout...
-    //read and write slots flip depending on whether this is for a parent location.
-    u64* slot = (location.parent?((u64*)location.offset)+1:((u64*)location.offset));
+    auto& role = agentMap[location.agent]->mailbox->role[location.role];
+    if (urgent)
+        return (location.parent == send) ? role.urgentUp : role.urgentDown;
+    return (location.parent == send) ? role.up : role.down;
+}
 
-    if(*slot)
-        return -1;
-    *slot = *(u64*) metadata;
+/* Agent receiving the messages sent to a location -- the parent of the role for parent locations. */
+static auto inline saReceiver(saLocation location) -> u64
+{
+    if (!location.parent)
+        return location.agent;
+    return (location.role+1 == ROLE_STATE_UNIT) ? location.agent/N_BLOCKS_IN_UNIT*N_BLOCKS_IN_UNIT : 0;
+}
 
+/* Wakes the role a message sent to a location is for (ROLE_TIMER_WHEEL). */
+//Note: the receiver clears its doorbell before draining, so a message either
+//      rings after the clear or was pushed before the drain saw the ring.
+static auto inline saRingDoorbell(saLocation location) -> void
+{
+    u64 role = location.parent ? location.role+1 : location.role;
+    agentMap[saReceiver(location)]->mailbox->doorbell.fetch_or(1UL << role, std::memory_order_release);
+}
+
+#if TRACE == 1
+/* Trace event names of the messages by type. */
+static const char* saSendNames[SA_METADATA_TYPE_LAST] = {"send NONE", "send EDT_INFO", "send BLK_INFO", "send AGG_INFO", "send CAP_INFO", "send ERR_INFO", "send BLK_CTRL", "send INF_CTRL"};
+static const char* saRecvNames[SA_METADATA_TYPE_LAST] = {"recv NONE", "recv EDT_INFO", "recv BLK_INFO", "recv AGG_INFO", "recv CAP_INFO", "recv ERR_INFO", "recv BLK_CTRL", "recv INF_CTRL"};
+#endif
+
+u8 saSendMetadata(saLocation location, void* metadata)
+{
+    bool urgent = ((saMetadata*) metadata)->SA_ATR_URGENCY;
+    if(!saRing(location, true, urgent).push(*(u64*) metadata))
+        return -1; // full -- try again later.
+    TRACE_INSTANT_EVENT(saSendNames[((saMetadata*) metadata)->SA_ATR_METADATA_TYPE % SA_METADATA_TYPE_LAST], location.agent);
+
+    #if THREAD_PLACEMENT == 1
+    agent.statistics.messagesCrossDomain += agentMap[saReceiver(location)]->domain != agent.domain;
+    #endif
+    #if ROLE_TIMER_WHEEL == 1
+    saRingDoorbell(location);
+    #endif
     return 0;
 }
 
 u8 saRecvMetadata(saLocation location, void* metadata)
 {
-    //new simplified mailbox layout...
-    //read and write slots flip depending on whether this is for a parent location.
-    u64* slot = (location.parent?((u64*)location.offset):((u64*)location.offset)+1);
+    if(!saRing(location, false, true).pop(*(u64*) metadata) &&
+       !saRing(location, false, false).pop(*(u64*) metadata))
+        return -1; // empty.
+    TRACE_INSTANT_EVENT(saRecvNames[((saMetadata*) metadata)->SA_ATR_METADATA_TYPE % SA_METADATA_TYPE_LAST], location.agent);
 
-    *(u64*)metadata = *slot;
-    *slot = 0x0;
+    return 0;
+}
+
+u8 saRecvUrgentMetadata(saLocation location, void* metadata)
+{
+    if(!saRing(location, false, true).pop(*(u64*) metadata))
+        return -1; // no urgent message.
+    TRACE_INSTANT_EVENT(saRecvNames[((saMetadata*) metadata)->SA_ATR_METADATA_TYPE % SA_METADATA_TYPE_LAST], location.agent);
 
     return 0;
 }
@@ -359,7 +253,8 @@ saLocation saGetParentLocation()
 {
     saLocation location;
     location.parent = 1;
-    location.offset = (u64)(agent.memory + agent.role*2);
+    location.role = agent.role;
+    location.agent = agent.id;
 
     return location;
 }
@@ -371,10 +266,12 @@ saLocation saGetChildLocation(u32 num)
     switch(agent.role-1)
     {
         case ROLE_STATE_BLOCK:
-            location.offset = (u64)(agentMap[agent.uid*N_BLOCKS_IN_UNIT+num]->memory);
+            location.role = ROLE_STATE_BLOCK;
+            location.agent = agent.uid*N_BLOCKS_IN_UNIT+num;
             break;
         case ROLE_STATE_UNIT:
-            location.offset = (u64)(agentMap[num*N_BLOCKS_IN_UNIT]->memory + 2);
+            location.role = ROLE_STATE_UNIT;
+            location.agent = num*N_BLOCKS_IN_UNIT;
             break;
         default:
             printf("WARNING: We shouldn't reach here!\n");
@@ -471,7 +368,7 @@ void harness()
     assert(sizeof(saBlkInfoMetadata)*8==64);
     assert(sizeof(saBlkCtrlMetadata)*8==64);
     assert(sizeof(saErrInfoMetadata)*8==64);
-    assert(sizeof(saLocation)*8==64);
+    assert(sizeof(saLocation)*8==32);
 
     //must fit all possible attributes.
     assert(bitCount(SA_ATR_LAST)<sizeof(saMetadataAttr)*8);
@@ -504,6 +401,11 @@ void harness()
     saErrInfoMetadata a4 = SA_ERR_INFO_METADATA_INITIALIZER;
     _TEST_SA(a4, SA_ATR_METADATA_TYPE, SA_METADATA_TYPE_ERR_INFO);
 
+    saInfCtrlMetadata a5 = SA_INF_CTRL_METADATA_INITIALIZER;
+    _TEST_SA(a5, SA_ATR_METADATA_TYPE, SA_METADATA_TYPE_INF_CTRL);
+    _SETTEST_SA(a5, SA_ATR_REQ_METADATA_TYPE, SA_METADATA_TYPE_BLK_INFO);
+    _SETTEST_SA(a5, SA_ATR_TELEMETRY_MODE, SA_ATR_TELEMETRY_MODE_HYBRID);
+
     //Call directly
     saEdtInfoMetadata md = SA_EDT_INFO_METADATA_INITIALIZER;
     u16 val;
@@ -212,6 +212,8 @@ typedef enum saMetadataType
 //|     SA_ATR_AGG_TEMP_MEAN        - Weighted Average temperature.           |
 //|     SA_ATR_AGG_TEMP_SD          - Temperature standard deviation.         |
 //|     SA_ATR_AGG_TEMP_SKEW        - Temperature skew.                       |
+//|     SA_ATR_TELEMETRY_MODE       - How the receiving subtree reports its   |
+//|                                   information (push, pull or hybrid).     |
 //+---------------------------------------------------------------------------+
 /******************************************************************************/
 typedef enum saMetadataAttrList
@@ -245,6 +247,7 @@ typedef enum saMetadataAttrList
     SA_ATR_AGG_TEMP_MEAN        ,
     SA_ATR_AGG_TEMP_SD          ,
     SA_ATR_AGG_TEMP_SKEW        ,
+    SA_ATR_TELEMETRY_MODE       ,
     //
     SA_ATR_LAST
 } saMetadataAttrList;
@@ -622,7 +625,12 @@ typedef struct __attribute__ ((__packed__)) saBlkCtrlMetadata
 //|                                   _1 bit_.                                |
 //|     SA_ATR_REQ_METADATA_TYPE    - Attribute to request metadata           |
 //|                                   information be sent to the requesting   |
-//|                                   CE. _10 bits_.                          |
+//|                                   CE. SA_METADATA_TYPE_NONE only sets the |
+//|                                   telemetry mode. _10 bits_.              |
+//|     SA_ATR_TELEMETRY_MODE       - Telemetry mode of the receiving subtree.|
+//|                                   Push reports on swings, pull only on    |
+//|                                   request and hybrid on large swings plus |
+//|                                   requests. _2 bits_.                     |
 //|     SA_ATR_RESERVED             - Reserved bits. Pads the structure to 64 |
 //|                                   bits.                                   |
 //|                                                                           |
@@ -634,10 +642,16 @@ typedef struct __attribute__ ((__packed__)) saInfCtrlMetadata
 {
     SA_HEADER;
     u64 SA_ATR_REQ_METADATA_TYPE : 10;
-    u64 SA_ATR_RESERVED          : 50;
+    u64 SA_ATR_TELEMETRY_MODE    : 2;
+    u64 SA_ATR_RESERVED          : 48;
 
 } saInfCtrlMetadata;
 
+//Telemetry modes.
+#define SA_ATR_TELEMETRY_MODE_PUSH   0b00
+#define SA_ATR_TELEMETRY_MODE_PULL   0b01
+#define SA_ATR_TELEMETRY_MODE_HYBRID 0b10
+
 #define SA_INF_CTRL_METADATA_INITIALIZER {SA_METADATA_TYPE_INF_CTRL}
 
 ///****************************************************************************
@@ -645,23 +659,20 @@ typedef struct __attribute__ ((__packed__)) saInfCtrlMetadata
 //| Structure: saLocation                                                     |
 //|                                                                           |
 //| Description:                                                              |
-//|     This structure packs where to recv/send messages.                     |
+//|     This structure packs where to recv/send messages. It is a handle to   |
+//|     the mailbox of the child end of a parent-child edge.                  |
 //|                                                                           |
 //| Control Bits:                                                             |
-//|     control    - direct where the message is sent. _5 bits_.              |
-//|     rack_num   - Rack to send to. _8 bits_.                               |
-//|     unit_num   - Unit to send to. _7 bits_.                               |
-//|     board_num  - Board to send to. _5 bits_.                              |
-//|     chip_num   - Chip to send to. _4 bits_.                               |
-//|     block_num  - Block to send to. _5 bits_.                              |
-//|     reserved   - Reserved bits. Pads the structure to 64 bits.            |
+//|     parent     - whether this is a parent location. _1 bit_.              |
+//|     role       - role of the child end of the edge. _2 bits_.             |
+//|     agent      - agent owning the mailbox. _29 bits_.                     |
 //+---------------------------------------------------------------------------+
 /******************************************************************************/
-///FIXME: Change documentation above.
 typedef struct __attribute__ ((__packed__)) saLocation
 {
-   u8 parent:1; //Whether this is a parent location.
-   u64 offset;
+   u32 parent:1; //Whether this is a parent location.
+   u32 role:2;   //Role of the child end.
+   u32 agent:29; //Agent owning the mailbox.
 } saLocation;
 
 ///****************************************************************************
@@ -750,7 +761,7 @@ u8 saGetMetadata(void* metadata, saMetadataAttr attr, void* val);
 //|     metadata - metadata to send.                                          |
 //|                                                                           |
 //| Returns:                                                                  |
-//|     0 on success and and an error code on failure.                        |
+//|     0 on success and an error code if the mailbox is full.                |
 //+---------------------------------------------------------------------------+
 /******************************************************************************/
 u8 saSendMetadata(saLocation location, void* metadata);
@@ -772,11 +783,36 @@ u8 saSendMetadata(saLocation location, void* metadata);
 //|     metadata - allocated memory to store metadata in.                     |
 //|                                                                           |
 //| Returns:                                                                  |
-//|     0 on success and and an error code on failure.                        |
+//|     0 if a message was received and an error code if the mailbox is       |
+//|     empty. Urgent messages (SA_ATR_URGENCY) are received first, then the  |
+//|     rest in the order they were sent.                                     |
 //+---------------------------------------------------------------------------+
 /******************************************************************************/
 u8 saRecvMetadata(saLocation location, void* metadata);
 
+///****************************************************************************
+//+---------------------------------------------------------------------------+
+//| Function: saRecvUrgentMetadata                                            |
+//|                                                                           |
+//| Description:                                                              |
+//|     Retrieves the next urgent (SA_ATR_URGENCY) metadata from the outbox   |
+//|     at the corresponding destination, leaving the routine messages.       |
+//|                                                                           |
+//| Call Information:                                                         |
+//|     To be called by a parent on every child mailbox before it drains any  |
+//|     of them with saRecvMetadata.                                          |
+//|                                                                           |
+//| Parameters:                                                               |
+//|     location - the system destination.                                    |
+//|     metadata - allocated memory to store metadata in.                     |
+//|                                                                           |
+//| Returns:                                                                  |
+//|     0 if a message was received and an error code if the urgent lane is   |
+//|     empty.                                                                |
+//+---------------------------------------------------------------------------+
+/******************************************************************************/
+u8 saRecvUrgentMetadata(saLocation location, void* metadata);
+
 ///****************************************************************************
 ///****************************************************************************
 //+---------------------------------------------------------------------------+
@@ -811,6 +847,61 @@ u8 saRecvMetadata(saLocation location, void* metadata);
 /******************************************************************************/
 u8 ocrInitMetadata(ocrGuid_t* guid, saEdtInfoMetadata* metadata);
 
+///****************************************************************************
+//+---------------------------------------------------------------------------+
+//| Function: ocrInitMetadataBulk                                             |
+//|                                                                           |
+//| Description:                                                              |
+//|     Same as ocrInitMetadata for count EDTs at once. Cheaper than as many  |
+//|     single calls when EDTs are created in batches.                        |
+//|                                                                           |
+//| Parameters:                                                               |
+//|     guids - EDT template GUIDs.                                           |
+//|     metadata - full bit field to initialize each EDT metadata with.       |
+//|     count - number of GUIDs.                                              |
+//|                                                                           |
+//| Returns:                                                                  |
+//|     0 on success and and an error code on failure.                        |
+//+---------------------------------------------------------------------------+
+/******************************************************************************/
+u8 ocrInitMetadataBulk(ocrGuid_t** guids, saEdtInfoMetadata* metadata, u64 count);
+
+///****************************************************************************
+//+---------------------------------------------------------------------------+
+//| Function: ocrDestroyMetadata                                              |
+//|                                                                           |
+//| Description:                                                              |
+//|     Drops the EDT metadata associated with the given OCR GUID.            |
+//|                                                                           |
+//| Parameters:                                                               |
+//|     guid - EDT template GUID.                                             |
+//|                                                                           |
+//| Call Information:                                                         |
+//|     To be called when an EDT template is destroyed.                       |
+//|                                                                           |
+//| Returns:                                                                  |
+//|     0 on success and an error code if the metadata was not initialized.   |
+//+---------------------------------------------------------------------------+
+/******************************************************************************/
+u8 ocrDestroyMetadata(ocrGuid_t* guid);
+
+///****************************************************************************
+//+---------------------------------------------------------------------------+
+//| Function: ocrDestroyMetadataBulk                                          |
+//|                                                                           |
+//| Description:                                                              |
+//|     Same as ocrDestroyMetadata for count EDTs at once.                    |
+//|                                                                           |
+//| Parameters:                                                               |
+//|     guids - EDT template GUIDs.                                           |
+//|     count - number of GUIDs.                                              |
+//|                                                                           |
+//| Returns:                                                                  |
+//|     0 on success and an error code if any of them was not initialized.    |
+//+---------------------------------------------------------------------------+
+/******************************************************************************/
+u8 ocrDestroyMetadataBulk(ocrGuid_t** guids, u64 count);
+
 ///****************************************************************************
 //+---------------------------------------------------------------------------+
 //| Function: ocrEdtSetMetadata                                               |
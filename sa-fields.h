@@ -0,0 +1,229 @@
+/*
+ * Copyright (c) 2014, University of Delaware
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+
+#ifndef _SA_FIELDS_GUARD_
+#define _SA_FIELDS_GUARD_
+#include "ss-conf.h"
+#include "ss-pack.h"
+#include "sa-api.h"
+
+/*
+    Field table of the SA metadata. Every (type, attribute) pair that can be
+    set or retrieved is listed once with the codec used to store its value in
+    the bitfield. The typed accessors below and the C API (saSetMetadata() and
+    saGetMetadata()) are both generated from it:
+
+        FIELDS(X, TYPE) expands to X(TYPE, ATTRIBUTE, CODEC) for each field.
+        SA_METADATA_TABLE(X) expands to X(TYPE, STRUCTURE, FIELDS, NAME).
+*/
+#define SA_HEADER_FIELDS(X, TYPE) \
+    X(TYPE, SA_ATR_METADATA_TYPE, Raw) \
+    X(TYPE, SA_ATR_URGENCY,       Raw)
+
+#define SA_EDT_INFO_FIELDS(X, TYPE) \
+    SA_HEADER_FIELDS(X, TYPE) \
+    X(TYPE, SA_ATR_UTILITY_SCORE,        Raw) \
+    X(TYPE, SA_ATR_OPS_FP,               Raw) \
+    X(TYPE, SA_ATR_OPS_INT,              Raw) \
+    X(TYPE, SA_ATR_MEM_DMA_SCORE,        Raw) \
+    X(TYPE, SA_ATR_MEM_LOCAL_SCORE,      Raw) \
+    X(TYPE, SA_ATR_MEM_REMOTE_SCORE,     Raw) \
+    X(TYPE, SA_ATR_POW_STATIC,           Raw) \
+    X(TYPE, SA_ATR_POW_DYNAMIC_INTERNAL, Raw) \
+    X(TYPE, SA_ATR_POW_DYNAMIC_EXTERNAL, Raw)
+
+#define SA_BLK_INFO_FIELDS(X, TYPE) \
+    SA_HEADER_FIELDS(X, TYPE) \
+    X(TYPE, SA_ATR_UTILITY_SCORE,    Raw) \
+    X(TYPE, SA_ATR_MEM_DMA_SCORE,    Raw) \
+    X(TYPE, SA_ATR_MEM_LOCAL_SCORE,  Raw) \
+    X(TYPE, SA_ATR_MEM_REMOTE_SCORE, Raw) \
+    X(TYPE, SA_ATR_FUB_XE_COUNT,     Raw) \
+    X(TYPE, SA_ATR_FUB_FPU_COUNT,    Raw) \
+    X(TYPE, SA_ATR_FUB_BSM_COUNT,    Raw) \
+    X(TYPE, SA_ATR_FUB_DVFS_SCORE,   Raw) \
+    X(TYPE, SA_ATR_FUB_POW_SCORE,    Power16) \
+    X(TYPE, SA_ATR_FUB_TEMP_SCORE,   Whole)
+
+#define SA_AGG_INFO_FIELDS(X, TYPE) \
+    SA_HEADER_FIELDS(X, TYPE) \
+    X(TYPE, SA_ATR_AGG_POW_MEAN,  Power16) \
+    X(TYPE, SA_ATR_AGG_POW_SD,    Power12) \
+    X(TYPE, SA_ATR_AGG_POW_SKEW,  Skew) \
+    X(TYPE, SA_ATR_AGG_TEMP_MEAN, Temperature) \
+    X(TYPE, SA_ATR_AGG_TEMP_SD,   Temperature) \
+    X(TYPE, SA_ATR_AGG_TEMP_SKEW, Skew)
+
+#define SA_BLK_CTRL_FIELDS(X, TYPE) \
+    SA_HEADER_FIELDS(X, TYPE) \
+    X(TYPE, SA_ATR_FUB_CTRL,          Raw) \
+    X(TYPE, SA_ATR_FUB_XE_COUNT,      Raw) \
+    X(TYPE, SA_ATR_FUB_FPU_COUNT,     Raw) \
+    X(TYPE, SA_ATR_FUB_BSM_COUNT,     Raw) \
+    X(TYPE, SA_ATR_FUB_DVFS_SCORE,    Raw) \
+    X(TYPE, SA_ATR_FUB_POWER_GOAL,    Power16) \
+    X(TYPE, SA_ATR_FUB_UNDER_CONTROL, Raw)
+
+#define SA_ERR_INFO_FIELDS(X, TYPE) \
+    SA_HEADER_FIELDS(X, TYPE)
+
+#define SA_INF_CTRL_FIELDS(X, TYPE) \
+    SA_HEADER_FIELDS(X, TYPE) \
+    X(TYPE, SA_ATR_REQ_METADATA_TYPE, Raw) \
+    X(TYPE, SA_ATR_TELEMETRY_MODE,    Raw)
+
+#define SA_METADATA_TABLE(X) \
+    X(SA_METADATA_TYPE_EDT_INFO, saEdtInfoMetadata, SA_EDT_INFO_FIELDS, "EDT") \
+    X(SA_METADATA_TYPE_BLK_INFO, saBlkInfoMetadata, SA_BLK_INFO_FIELDS, "BLK INFO") \
+    X(SA_METADATA_TYPE_AGG_INFO, saAggInfoMetadata, SA_AGG_INFO_FIELDS, "AGG INFO") \
+    X(SA_METADATA_TYPE_BLK_CTRL, saBlkCtrlMetadata, SA_BLK_CTRL_FIELDS, "CTRL") \
+    X(SA_METADATA_TYPE_ERR_INFO, saErrInfoMetadata, SA_ERR_INFO_FIELDS, "ERR INFO") \
+    X(SA_METADATA_TYPE_INF_CTRL, saInfCtrlMetadata, SA_INF_CTRL_FIELDS, "INF CTRL")
+
+namespace sa
+{
+    /* Codecs -- value type of a field and how it is packed into its bits. */
+    struct Raw
+    {
+        typedef u64 Value;
+        static auto inline pack(Value val) -> u64 { return val; }
+        static auto inline unpack(u64 bits) -> Value { return bits; }
+    };
+
+    //Note: whole degrees, the fraction is dropped.
+    struct Whole
+    {
+        typedef FLOAT_TYPE Value;
+        static auto inline pack(Value val) -> u64 { return (u64) val; }
+        static auto inline unpack(u64 bits) -> Value { return bits; }
+    };
+
+    struct Power16
+    {
+        typedef FLOAT_TYPE Value;
+        static auto inline pack(Value val) -> u64 { return packPowerData(val, MAX_POWER_PER_BLOCK, 16); }
+        static auto inline unpack(u64 bits) -> Value { return unpackPowerData(bits, MAX_POWER_PER_BLOCK, 16); }
+    };
+
+    struct Power12
+    {
+        typedef FLOAT_TYPE Value;
+        static auto inline pack(Value val) -> u64 { return packPowerData(val, MAX_POWER_PER_BLOCK, 12); }
+        static auto inline unpack(u64 bits) -> Value { return unpackPowerData(bits, MAX_POWER_PER_BLOCK, 12); }
+    };
+
+    struct Skew
+    {
+        typedef FLOAT_TYPE Value;
+        static auto inline pack(Value val) -> u64 { return packSkewData(val); }
+        static auto inline unpack(u64 bits) -> Value { return unpackSkewData(bits); }
+    };
+
+    struct Temperature
+    {
+        typedef FLOAT_TYPE Value;
+        static auto inline pack(Value val) -> u64 { return packTemperatureData(val); }
+        static auto inline unpack(u64 bits) -> Value { return unpackTemperatureData(bits); }
+    };
+
+    /* Structure of a metadata type and the other way around. */
+    template <u64 TYPE> struct Metadata;
+    template <class STRUCTURE> struct TypeOf;
+
+    /* A field of a metadata type -- only the pairs of the table exist. */
+    template <u64 TYPE, u64 ATTR>
+    struct Field
+    {
+        static constexpr bool exists = false;
+        typedef u64 Value;
+    };
+
+    #define _SA_STRUCTURE(TYPE, STRUCTURE, FIELDS, NAME) \
+        static_assert(sizeof(STRUCTURE) == sizeof(u64), #STRUCTURE " must be 64 bits"); \
+        template <> struct Metadata<TYPE> { typedef STRUCTURE Type; }; \
+        template <> struct TypeOf<STRUCTURE> { static constexpr u64 value = TYPE; };
+
+    #define _SA_FIELD(TYPE, ATTR, CODEC) \
+        template <> struct Field<TYPE, ATTR> \
+        { \
+            static constexpr bool exists = true; \
+            typedef CODEC::Value Value; \
+            static auto inline get(const Metadata<TYPE>::Type& md) -> Value { return CODEC::unpack(md.ATTR); } \
+            static auto inline set(Metadata<TYPE>::Type& md, Value val) -> void { md.ATTR = CODEC::pack(val); } \
+        };
+
+    #define _SA_FIELDS(TYPE, STRUCTURE, FIELDS, NAME) FIELDS(_SA_FIELD, TYPE)
+
+    //The generic structure only has the header.
+    _SA_STRUCTURE(SA_METADATA_TYPE_NONE, saMetadata, SA_HEADER_FIELDS, "generic")
+    SA_HEADER_FIELDS(_SA_FIELD, SA_METADATA_TYPE_NONE)
+
+    SA_METADATA_TABLE(_SA_STRUCTURE)
+    SA_METADATA_TABLE(_SA_FIELDS)
+
+    #undef _SA_STRUCTURE
+    #undef _SA_FIELD
+    #undef _SA_FIELDS
+
+    /* Retrieves an attribute, e.g. sa::get<SA_ATR_AGG_POW_MEAN>(aggMsg). */
+    template <u64 ATTR, class STRUCTURE>
+    auto inline get(const STRUCTURE& md) -> typename Field<TypeOf<STRUCTURE>::value, ATTR>::Value
+    {
+        static_assert(Field<TypeOf<STRUCTURE>::value, ATTR>::exists, "attribute is not part of this metadata type");
+        return Field<TypeOf<STRUCTURE>::value, ATTR>::get(md);
+    }
+
+    /* Sets an attribute, e.g. sa::set<SA_ATR_FUB_POWER_GOAL>(ctrlMsg, goal). */
+    template <u64 ATTR, class STRUCTURE>
+    auto inline set(STRUCTURE& md, typename Field<TypeOf<STRUCTURE>::value, ATTR>::Value val) -> void
+    {
+        static_assert(Field<TypeOf<STRUCTURE>::value, ATTR>::exists, "attribute is not part of this metadata type");
+        Field<TypeOf<STRUCTURE>::value, ATTR>::set(md, val);
+    }
+
+    /* Views a received message as the structure of its type. */
+    template <u64 TYPE>
+    auto inline as(saMetadata& msg) -> typename Metadata<TYPE>::Type&
+    {
+        assert(msg.SA_ATR_METADATA_TYPE == TYPE);
+        return reinterpret_cast<typename Metadata<TYPE>::Type&>(msg);
+    }
+
+    /* Views a typed message as a generic one (for sending). */
+    template <class STRUCTURE>
+    auto inline generic(STRUCTURE& md) -> saMetadata&
+    {
+        static_assert(sizeof(STRUCTURE) == sizeof(saMetadata), "metadata must be 64 bits");
+        return reinterpret_cast<saMetadata&>(md);
+    }
+}
+#endif
@@ -0,0 +1,98 @@
+#!/bin/bash
+# End-to-end scaling benchmark on the synthetic workloads (safe --synthetic).
+#
+# Builds SAFE once per chip geometry and INST_PER_MEGA_INST of the sweep (in a
+# scratch copy, the tree is left alone), runs every workload restricted to each
+# host CPU count (taskset) and prints one CSV row per run:
+#
+#   workload,units,blocks,inst_per_mega_inst,threads,cpus,cycles,startup_s,run_s,cycles_per_s,peak_rss_mb
+#
+# Given a baseline (a previous output), every run more than SAFE_REGRESSION
+# percent slower in cycles_per_s than the same configuration there is reported
+# on stderr and the exit status is 1.
+#
+# The sweep is set from the environment (space separated lists):
+#   SAFE_GEOMETRIES  units x blocks per unit (square numbers)   default "4x4 16x16"
+#   SAFE_MEGA        INST_PER_MEGA_INST values                  default "512"
+#   SAFE_CPUS        host CPU counts                            default 1, 2, 4... up to nproc
+#   SAFE_WORKLOADS   synthetic workloads                        default "compute dram mixed"
+#   SAFE_MAX_TIME    simulated time per run in ms               default 20
+#   SAFE_REGRESSION  allowed slowdown against the baseline (%)  default 10
+
+#Check the number of parameters
+if [[ $# -gt 1 ]]; then
+	printf "Use: $0 [BASELINE.csv] > results.csv\n"
+	exit 1
+fi
+baseline=$1
+if [[ -n $baseline && ! -f $baseline ]]; then
+	printf "Baseline $baseline not found.\n" >&2
+	exit 1
+fi
+
+source=$(cd "$(dirname "$0")" && pwd)
+geometries=${SAFE_GEOMETRIES:-"4x4 16x16"}
+megas=${SAFE_MEGA:-"512"}
+workloads=${SAFE_WORKLOADS:-"compute dram mixed"}
+maxTime=${SAFE_MAX_TIME:-20}
+regression=${SAFE_REGRESSION:-10}
+hostCpus=$(nproc)
+if [[ -z $SAFE_CPUS ]]; then
+	SAFE_CPUS=""
+	for ((n = 1; n < hostCpus; n *= 2)); do SAFE_CPUS="$SAFE_CPUS $n"; done
+	SAFE_CPUS="$SAFE_CPUS $hostCpus"
+fi
+
+scratch=$(mktemp -d)
+trap 'rm -rf "$scratch"' EXIT
+results=$scratch/results.csv
+
+echo "workload,units,blocks,inst_per_mega_inst,threads,cpus,cycles,startup_s,run_s,cycles_per_s,peak_rss_mb" | tee "$results"
+for geometry in $geometries; do
+	units=${geometry%x*}
+	blocks=${geometry#*x}
+	for mega in $megas; do
+		##Build a copy for the configuration, with enough tasks to keep every block busy for SAFE_MAX_TIME.
+		multiplier=$((units * blocks * maxTime / 80))
+		[[ $multiplier -lt 4 ]] && multiplier=4
+		build=$scratch/build-$units-$blocks-$mega
+		mkdir -p "$build/logs"
+		cp "$source"/*.cpp "$source"/*.c "$source"/*.h "$source"/Makefile "$source"/energyPerOp.txt "$build"
+		printf "==> Building %s units x %s blocks, INST_PER_MEGA_INST %s...\n" "$units" "$blocks" "$mega" >&2
+		if ! make -s -C "$build" CONF="-DN_UNITS_IN_CHIP=${units}UL -DN_BLOCKS_IN_UNIT=${blocks}UL -DINST_PER_MEGA_INST=$mega -DMAX_TIME=$maxTime -DTASK_MULTIPLIER=$multiplier" > "$build/build.log" 2>&1; then
+			cat "$build/build.log" >&2
+			exit 1
+		fi
+
+		##Run every workload on every CPU count.
+		for workload in $workloads; do
+			for cpus in $SAFE_CPUS; do
+				printf "==> Running %s on %s CPUs...\n" "$workload" "$cpus" >&2
+				line=$(cd "$build" && SAFE_LOGS_PATH="$build/logs" taskset -c 0-$((cpus - 1)) ./safe --synthetic "$workload" | grep '^SAFE_RESULT')
+				if [[ -z $line ]]; then
+					printf "Run of %s on %s CPUs failed.\n" "$workload" "$cpus" >&2
+					exit 1
+				fi
+				echo "$line" | sed -e 's/^SAFE_RESULT //' -e 's/[a-z_]*=//g' -e 's/ /,/g' | tee -a "$results"
+			done
+		done
+	done
+done
+
+##Compare with the baseline -- rows match on the configuration columns (1 to 6).
+if [[ -n $baseline ]]; then
+	awk -F, -v limit="$regression" '
+		FNR == 1 { next }
+		NR == FNR { base[$1","$2","$3","$4","$5","$6] = $10; next }
+		{
+			key = $1","$2","$3","$4","$5","$6
+			if (!(key in base)) next
+			change = ($10 - base[key]) * 100.0 / base[key]
+			if (change < -limit) {
+				printf("REGRESSION %s: %.0f cycles/s against %.0f (%.1f%%)\n", key, $10, base[key], change) > "/dev/stderr"
+				failed = 1
+			}
+		}
+		END { exit failed }' "$baseline" "$results" || exit 1
+fi
+exit 0
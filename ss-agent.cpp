@@ -38,6 +38,10 @@
 #include <ratio>
 #include <iostream>
 #include <climits>
+#include <cstdlib>
+#include <new>
+#include <sched.h>
+#include <sys/resource.h>
 #include "ss-agent.h"
 extern "C" {
 #include "ss-math.h"
@@ -45,29 +49,32 @@ extern "C" {
 }
 #include "ss-msr.h"
 #include "sa-api.h"
+#include "sa-fields.h"
+#include "ss-topology.h"
+#include "ss-outbox.h"
+#include "ss-timer.h"
+#include "ss-probe.h"
+#include "ss-barrier.h"
+#include "ss-trace.h"
+#include "ss-log.h"
+#include "ss-live.h"
 
 thread_local struct AgentMap agent;
 AgentMap* agentMap[N_UNITS_IN_CHIP*N_BLOCKS_IN_UNIT];
 std::atomic<u64> done; // incremented to agent count signals the simulation as finished.
+std::atomic<u64> retired; // engines that recorded their last probe, trace event and log record -- the reports wait for all.
 std::chrono::high_resolution_clock::time_point simulationStartTime; //simulation start time.
-std::atomic<s64> dram_ports[N_UNITS_IN_CHIP];
-
-#if EXECUTION_TIMES == 1 || EXECUTION_TIMES == 3 || EXECUTION_TIMES == 2
-  thread_local struct Times
-  {
-    double roles;
-    double rolesChip;
-    double rolesUnit;
-    double rolesBlock;
-    double simulation;
-    double barriers;
-  }times;
-
-
-  std::chrono::high_resolution_clock::time_point start;
-  std::chrono::high_resolution_clock::time_point start2;
-  std::chrono::high_resolution_clock::time_point stop;
-  std::chrono::high_resolution_clock::time_point stop2;
+std::chrono::high_resolution_clock::time_point programStartTime;    //process start time.
+static std::chrono::high_resolution_clock::time_point firstTickTime; //time every agent is ready to run.
+const char* workloadName = "";
+struct alignas(CACHE_LINE_SIZE) DramPorts
+{
+    std::atomic<s64> count;
+} dram_ports[N_UNITS_IN_CHIP]; // one cache line per unit -- only shared by the blocks of the unit.
+
+#if SYNC_QUANTUM_ADAPTIVE == 1
+std::atomic<u64> syncQuantum(SYNC_QUANTUM_MIN); // ticks of the next epochs (lookahead in SYNC_MODE 1) -- chosen by the chip agent.
+std::atomic<FLOAT_TYPE> boundaryTemperature[N_UNITS_IN_CHIP*N_BLOCKS_IN_UNIT]; // temperature of each block at its last epoch boundary (read by the chip agent without a barrier in SYNC_MODE 1).
 #endif
 
 
@@ -75,41 +82,32 @@ thread_local struct LeafNodeState
 {
     u8 stub;
     FLOAT_TYPE powerGoal;
-    std::deque <saMetadata> parentBuffer;
+    Outbox<1, outboxParent> parent;
 
     bool underControl;
 
+    //Telemetry mode set by the parent and pending request.
+    u64 telemetryMode;
+    bool telemetryRequested;
+
+    //Thermal emergency -- the block stays at half speed until it cools down.
+    bool emergency;
+    bool emergencyAnswered;
+    u64 emergencyCycle; // clock when raised.
+
+    //Temperature delta and power of the last report (swings are measured from them).
+    FLOAT_TYPE reportedTemp;
+    FLOAT_TYPE reportedPower;
+
     void push(saMetadata& msg)
     {
-
-        if(!parentBuffer.empty())
-        {
-            saMetadata* msg2send = &parentBuffer.front();
-            u64 attr1, attr2;
-            saGetMetadata(&msg, SA_ATR_METADATA_TYPE, &attr1);
-            saGetMetadata(msg2send, SA_ATR_METADATA_TYPE, &attr2);
-            if (attr1 == attr2)
-            {
-                parentBuffer.pop_front();
-            }
-        }
-        parentBuffer.push_back(msg);
+        parent.push(0, msg);
     }
 
+    //Flush method delivers the pending messages at the epoch boundary.
     void flush()
     {
-      /*Flushing the parent*/
-      //check if there is any message to send
-      if(!parentBuffer.empty())
-      {
-          saLocation parentSlot = saGetParentLocation();
-          saMetadata * msg2send;
-          msg2send = &parentBuffer.front();
-          if (saSendMetadata(parentSlot,(void*)msg2send)==0)
-          {
-              parentBuffer.pop_front();
-          }
-      }
+        parent.deliver();
     }
 } leafNodeState = {0};
 
@@ -128,62 +126,37 @@ thread_local struct BranchNodeState
     FLOAT_TYPE powerSkew;
     FLOAT_TYPE powerMap[N_BLOCKS_IN_UNIT];
 
+    //Running sums over the maps -- updated as blocks report.
+    MomentsAccumulator temperatureMoments;
+    MomentsAccumulator powerMoments;
+
+    //Children that reported since the last swing check, and whether the aggregates are stale.
+    u64 dirty;
+    bool stale;
+
     FLOAT_TYPE powerGoal;
     FLOAT_TYPE currentMultipliers[N_CORES_IN_BLOCK];
 
-    std::deque <saMetadata> parentBuffer;
-    std::deque <saMetadata> childBuffers[N_BLOCKS_IN_UNIT];
+    Outbox<1, outboxParent> parent;
+    Outbox<N_BLOCKS_IN_UNIT, outboxChild> children;
 
     bool underControl;
 
+    //Telemetry mode set by the parent, pending request and mode the children know.
+    u64 telemetryMode;
+    bool telemetryRequested;
+    u64 childrenTelemetryMode;
+
     void push(saMetadata& msg)
     {
-
-        if(!parentBuffer.empty())
-        {
-            saMetadata* msg2send = &parentBuffer.front();
-            u64 attr1, attr2;
-            saGetMetadata(&msg, SA_ATR_METADATA_TYPE, &attr1);
-            saGetMetadata(msg2send, SA_ATR_METADATA_TYPE, &attr2);
-            if (attr1 == attr2)
-            {
-                parentBuffer.pop_front();
-            }
-        }
-        parentBuffer.push_back(msg);
+        parent.push(0, msg);
     }
 
-    //Flush method try to send the information in the buffers
+    //Flush method delivers the pending messages at the epoch boundary.
     void flush()
     {
-       /*Flushing the children buffers*/
-       for(u64 child=0; child<N_BLOCKS_IN_UNIT; child++)
-       {
-          //if there is any message to send.
-          if (!childBuffers[child].empty())
-          {
-             saLocation childSlot = saGetChildLocation(child);
-             saMetadata * msg2send;
-             msg2send = &childBuffers[child].front();
-             if (saSendMetadata(childSlot,(void*)msg2send)==0)
-             {
-               childBuffers[child].pop_front();
-             }
-          }
-       }
-
-       /*Flushing the parent*/
-      //check if there is any message to send
-      if(!parentBuffer.empty())
-      {
-          saLocation parentSlot = saGetParentLocation();
-          saMetadata * msg2send;
-          msg2send = &parentBuffer.front();
-          if (saSendMetadata(parentSlot,(void*)msg2send)==0)
-          {
-               parentBuffer.pop_front();
-          }
-      }
+        children.deliver();
+        parent.deliver();
     }
 
 } branchNodeState = {0}; //space for unit roles + Chip role.
@@ -212,27 +185,70 @@ thread_local struct RootNodeState
 
     FLOAT_TYPE powerGoal;
     FLOAT_TYPE currentMultipliers[N_UNITS_IN_CHIP];
-    std::deque <saMetadata> childBuffers[N_UNITS_IN_CHIP];
+    u64 controlCycle; // clock of the next control policy step.
+    Outbox<N_UNITS_IN_CHIP, outboxChild> children;
+
+    //Units that reported since the last aggregation.
+    u64 dirty;
+
+    //Telemetry mode of each unit subtree and the mode the unit knows.
+    u64 telemetryMode[N_UNITS_IN_CHIP];
+    u64 childrenTelemetryMode[N_UNITS_IN_CHIP];
+
+    //Flush method delivers the pending messages at the epoch boundary.
     void flush()
     {
-      /*Flushing the children buffers*/
-       for(u64 child=0; child<N_BLOCKS_IN_UNIT; child++)
-       {
-           //if there is any message to send.
-           if (!childBuffers[child].empty())
-           {
-              saLocation childSlot = saGetChildLocation(child);
-              saMetadata * msg2send;
-              msg2send = &childBuffers[child].front();
-              if (saSendMetadata(childSlot,(void*)msg2send)==0)
-              {
-                   childBuffers[child].pop_front();
-              }
-           }
-       }
+        children.deliver();
     }
 } rootNodeState = {0}; //space for unit roles + Chip role.
 
+/* Asks a child for a report of the given type (NONE only sets its telemetry mode). */
+template <class NODE>
+auto inline requestTelemetry(NODE& node, u64 child, u64 type, u64 mode) -> void
+{
+    saInfCtrlMetadata msg = SA_INF_CTRL_METADATA_INITIALIZER;
+    sa::set<SA_ATR_REQ_METADATA_TYPE>(msg, type);
+    sa::set<SA_ATR_TELEMETRY_MODE>(msg, mode);
+    node.children.push(child, sa::generic(msg));
+}
+
+#if ROLE_TIMER_WHEEL == 1
+/* Next activation of each role of the agent (timers are the ROLE_STATES). */
+thread_local TimerWheel<ROLE_STATE_CHIP+1> roleTimers;
+#endif
+
+#if SYNC_MODE == 1
+/* Agents whose clocks this one stays within SYNC_LOOKAHEAD ticks of. */
+//Note: the thermal neighbors, the parents and the children of the roles held.
+thread_local struct
+{
+    ExchangeArea* peer[4 + 2 + N_BLOCKS_IN_UNIT + N_UNITS_IN_CHIP];
+    u64 count;
+} syncPeers;
+
+/* Adds a peer to the agent (once, and never the agent itself). */
+auto inline addSyncPeer(AgentMap* peer) -> void
+{
+    if (peer == NULL || peer == &agent)
+        return;
+    for (u64 i=0; i<syncPeers.count; i++)
+        if (syncPeers.peer[i] == peer->exchange)
+            return;
+    syncPeers.peer[syncPeers.count++] = peer->exchange;
+}
+#endif
+
+/* Allocates a zero initialized, cache line aligned region for agent state shared with other threads. */
+//Note: called by the owning thread so the pages are first touched (and placed) by it.
+template <class TYPE>
+auto inline allocateShared() -> TYPE*
+{
+    void* region = NULL;
+    if (posix_memalign(&region, CACHE_LINE_SIZE, sizeof(TYPE)) != 0)
+        fatal("posix_memalign");
+    return new (region) TYPE(); // value initialization zeroes the region.
+}
+
 auto inline initializeAgent() -> void
 {
 //XXX FIXME WARNING The casting may represent problems in different architectures.
@@ -262,18 +278,22 @@ assert(agent.bid <= USHRT_MAX && "agent.bid too big: cast to long will potential
         (((id+1)%width != 0) && (id+1 < count) ? id+1 : EAGENT_NOT_FOUND)
 
     //assign temperature.
-    agent.temperature = 50;
+    agent.exchange->temperature = 50;
 
     //initialize the underControl flag
     leafNodeState.underControl = false;
     branchNodeState.underControl = false;
 
     //Initialize some SA related data. and the multipliers of the roots for the controller.
-    for (u64 i=0; i<N_UNITS_IN_CHIP; i++)
+    for (u64 i=0; i<N_BLOCKS_IN_UNIT; i++)
     {
         branchNodeState.temperatureMap[i] = 50.0;
     }
-    for (u64 i=0; i<N_BLOCKS_IN_UNIT; i++)
+    for (u64 i=0; i<N_UNITS_IN_CHIP; i++)
+    {
+        rootNodeState.telemetryMode[i] = (TELEMETRY_MODE == 3) ? SA_ATR_TELEMETRY_MODE_PUSH : TELEMETRY_MODE;
+    }
+    for (u64 i=0; i<N_UNITS_IN_CHIP; i++)
     {
         rootNodeState.temperatureAvgMap[i] = 50.0;
         rootNodeState.currentMultipliers[i]=1;
@@ -282,6 +302,20 @@ assert(agent.bid <= USHRT_MAX && "agent.bid too big: cast to long will potential
     {
         branchNodeState.currentMultipliers[i]=1;
     }
+    momentsInit(&branchNodeState.temperatureMoments, branchNodeState.temperatureMap, N_BLOCKS_IN_UNIT);
+    momentsInit(&branchNodeState.powerMoments, branchNodeState.powerMap, N_BLOCKS_IN_UNIT);
+    branchNodeState.stale = true;
+    rootNodeState.dirty = ~0UL >> (64 - N_UNITS_IN_CHIP); // every unit (also valid for 64 of them).
+
+    #if ROLE_TIMER_WHEEL == 1
+    //First activation of the roles the agent holds.
+    roleTimers.init(readClockMSR());
+    roleTimers.schedule(ROLE_STATE_BLOCK, readClockMSR());
+    if (agent.bid == 0)
+        roleTimers.schedule(ROLE_STATE_UNIT, readClockMSR());
+    if (agent.id == 0)
+        roleTimers.schedule(ROLE_STATE_CHIP, readClockMSR());
+    #endif
 
     //Neighbor ids.
     u64 n_uid = agent.uid; u64 n_bid;
@@ -321,59 +355,81 @@ assert(agent.bid <= USHRT_MAX && "agent.bid too big: cast to long will potential
         agent.btmNeighbor = agentMap[n_uid*N_BLOCKS_IN_UNIT+n_bid];
         ///printf("\t%d\n", n_uid*N_BLOCKS_IN_UNIT+n_bid);
     }
+
+    #if SYNC_MODE == 1
+    //Peers: thermal neighbors, unit and chip parents, block and unit children.
+    addSyncPeer(agent.topNeighbor);
+    addSyncPeer(agent.btmNeighbor);
+    addSyncPeer(agent.lftNeighbor);
+    addSyncPeer(agent.rhtNeighbor);
+    addSyncPeer(agentMap[agent.uid*N_BLOCKS_IN_UNIT]);
+    if (agent.bid == 0)
+    {
+        addSyncPeer(agentMap[0]);
+        for (u64 i=0; i<N_BLOCKS_IN_UNIT; i++)
+            addSyncPeer(agentMap[agent.uid*N_BLOCKS_IN_UNIT+i]);
+    }
+    if (agent.id == 0)
+        for (u64 i=0; i<N_UNITS_IN_CHIP; i++)
+            addSyncPeer(agentMap[i*N_BLOCKS_IN_UNIT]);
+    #endif
 }
 
-auto inline pushWorkRoundRobin() -> void
+/* Fills the XE queues of the calling agent with its share of the task pool. */
+//Note: every agent fills its own queues so they are first touched (and placed)
+//      by its thread. The tasks are dealt as they always were: runs of 8 to the
+//      agents in turn, TASK_MULTIPLIER times over the pool, and the tasks of an
+//      agent to its XEs in turn.
+auto inline pushWork() -> void
 {
-    //push task into queue more than once if MULTIPLIER specified
-    for(u64 taskMultiplier = 0; taskMultiplier<TASK_MULTIPLIER; taskMultiplier++)
+    const u64 agents = N_BLOCKS_IN_UNIT*N_UNITS_IN_CHIP;
+    u64 share = 0; // tasks of the agent per pass over the pool.
+    for (u64 run = agent.id; run*8 < taskPool.size(); run += agents)
+        share += std::min<u64>(8, taskPool.size() - run*8);
+    for (u64 j = 0; j < N_CORES_IN_BLOCK; j++)
+        agent.xe[j].taskQueue.reserve((share*TASK_MULTIPLIER + N_CORES_IN_BLOCK - 1 - j)/N_CORES_IN_BLOCK);
+
+    u64 xe = 0; // XE the next task goes to.
+    for (u64 taskMultiplier = 0; taskMultiplier < TASK_MULTIPLIER; taskMultiplier++)
     {
-        u64 taskNumber = 0;
-        //If I still have instructions to schedule.
-        while (taskNumber < taskPool.size())
+        for (u64 run = agent.id; run*8 < taskPool.size(); run += agents)
         {
-            for(u64 i = 0 ; i < N_BLOCKS_IN_UNIT*N_UNITS_IN_CHIP; i++)
+            for (u64 taskNumber = run*8; taskNumber < std::min<u64>(run*8 + 8, taskPool.size()); taskNumber++)
             {
-                //Push 8 tasks to the same block for it to work on.
-                for(u64 j = 0 ; j < 8 && taskNumber<taskPool.size() ; j++)
-                {
-                    agentMap[i]->taskQueue.push_back(taskPool[taskNumber]); // add front to another queue (copies).
-                    taskNumber++;
-                }
+                agent.xe[xe].taskQueue.push_back(taskPool[taskNumber]);
+                xe = (xe + 1) % N_CORES_IN_BLOCK;
             }
         }
     }
-    taskPool.clear();
-    taskPool.shrink_to_fit();
 }
 
-auto inline scheduleWork() -> void
+/* Clock ticks between instruction counts that are multiples of a period. */
+auto inline ticksPerPeriod(u64 instructions) -> u64
 {
-    for(u64 i = 0 ; i < N_BLOCKS_IN_UNIT*N_UNITS_IN_CHIP; i++)
+    u64 a = instructions, b = INST_PER_MEGA_INST;
+    while (b != 0)
     {
-        u64 taskNumber = 0;
-        //Cycle each XE scheduling tasks.
-        while (taskNumber < agentMap[i]->taskQueue.size())
-        {
-            for(u64 j=0; j<N_CORES_IN_BLOCK; j++)
-            {
-                //add new task to be executed in the next cycle if any available.
-                if(taskNumber < agentMap[i]->taskQueue.size())
-                {
-                    //The new task is the task that is in front of the in the taskQueue of the agent.
-                    agentMap[i]->xe[j].taskQueue.push_back(agentMap[i]->taskQueue[taskNumber++]);
-                }
-                else
-                {
-                    agentMap[i]->taskQueue.clear();
-                    agentMap[i]->taskQueue.shrink_to_fit();
-                    break;
-                }
-            }
-        }
-        agentMap[i]->taskQueue.clear();
-        agentMap[i]->taskQueue.shrink_to_fit();
+        u64 r = a % b;
+        a = b;
+        b = r;
     }
+    return instructions/a;
+}
+
+/* Clock tick the simulated time reaches MAX_TIME at -- every agent stops there. */
+auto inline maxTimeTick() -> u64
+{
+    static const u64 tick = []
+    {
+        auto reached = [](u64 t) { return ((FLOAT_TYPE)t*INST_PER_MEGA_INST/((FLOAT_TYPE)MAX_XE_CLOCK_SPEED_MHZ*1000)) >= MAX_TIME; };
+        u64 t = (u64) (MAX_TIME*((FLOAT_TYPE)MAX_XE_CLOCK_SPEED_MHZ*1000)/INST_PER_MEGA_INST);
+        while (t > 0 && reached(t-1))
+            t--;
+        while (!reached(t))
+            t++;
+        return t;
+    }();
+    return tick;
 }
 
 auto inline ExecuteWork() -> void
@@ -381,16 +437,17 @@ auto inline ExecuteWork() -> void
     if(agent.done == true)
         return;
 
-    if(((FLOAT_TYPE)readClockMSR()*INST_PER_MEGA_INST/((FLOAT_TYPE)MAX_XE_CLOCK_SPEED_MHZ*1000)) >= MAX_TIME && agent.done == false)
+    if(readClockMSR() >= maxTimeTick() && agent.done == false)
     {
         // tell everyone we finished.
         done++;
         agent.done = true; // mark us as done so we don't increment again.
+        logEvent(LOG_SAMPLES_END); // logTick stops here.
         return;
     }
 
     bool executedWork = false;
-    FLOAT_TYPE energyDelta[N_CORES_IN_BLOCK] = {0.0};
+    ENERGY_TYPE energyDelta[N_CORES_IN_BLOCK] = {0};
     static thread_local s64 port[N_CORES_IN_BLOCK] = {-1, -1, -1, -1, -1, -1, -1, -1};
     //Cycle each XE scheduling tasks.
     for(u64 i=0; i<N_CORES_IN_BLOCK; i++)
@@ -430,15 +487,15 @@ auto inline ExecuteWork() -> void
             if(currentInstruction.type > 0 && port[i] <= 0)
             {
                 bool failed_acquire = false;
-                if(dram_ports[agent.uid].load(std::memory_order_relaxed) > 0)
+                if(dram_ports[agent.uid].count.load(std::memory_order_relaxed) > 0)
                 {
                     failed_acquire = true;
-                    port[i] = dram_ports[agent.uid].fetch_sub(1);
+                    port[i] = dram_ports[agent.uid].count.fetch_sub(1);
                 }
                 if(port[i] <= 0)
                 {
                     if(failed_acquire)
-                        dram_ports[agent.uid]++;
+                        dram_ports[agent.uid].count++;
 
                     if (state == XE_STATE_FULL)
                         energyDelta[i] = noopInstruction.fullStateEnergy;
@@ -462,7 +519,7 @@ auto inline ExecuteWork() -> void
                     if(currentInstruction.type <= 0)
                     {
                         port[i] = -1;
-                        dram_ports[agent.uid]++;
+                        dram_ports[agent.uid].count++;
                     }
                 }
                 energyDelta[i] = currentInstruction.fullStateEnergy;
@@ -481,7 +538,7 @@ auto inline ExecuteWork() -> void
                     if(currentInstruction.type <= 0)
                     {
                         port[i] = -1;
-                        dram_ports[agent.uid]++;
+                        dram_ports[agent.uid].count++;
                     }
                 }
                 energyDelta[i] = currentInstruction.halfStateEnergy;
@@ -499,7 +556,7 @@ auto inline ExecuteWork() -> void
     //    agent.done = true; // mark us as done so we don't increment again.
     //}
 
-    FLOAT_TYPE energy = 0.0;
+    ENERGY_TYPE energy = 0;
     for(u64 i=0; i<N_CORES_IN_BLOCK; i++)
         energy+=energyDelta[i];
 
@@ -507,7 +564,7 @@ auto inline ExecuteWork() -> void
     agent.energyWindow.push_front(energy);
     if (agent.energyWindow.size() >= ROLLING_ENERGY_WINDOW)
     {
-        if (agent.accumulatedEnergy == 0.0)
+        if (agent.accumulatedEnergy == 0)
         {
             for(u64 i=0; i<ROLLING_ENERGY_WINDOW; i++)
                 agent.accumulatedEnergy += agent.energyWindow[i];
@@ -520,6 +577,7 @@ auto inline ExecuteWork() -> void
         agent.energyWindow.pop_back();
     }
 
+    PROBE(PROBE_THERMAL);
     updateTemperatureMSR();
 }
 
@@ -556,6 +614,106 @@ auto inline adjustMultiplier(FLOAT_TYPE& powerTotal, FLOAT_TYPE& powerGoal, FLOA
     return true;
 }
 
+#if ROLE_TIMER_WHEEL == 1
+/* First clock tick the control policies act on (the XEs run at full speed before). */
+auto inline controlWarmupTick() -> u64
+{
+    return (u64) ceil(MAX_XE_CLOCK_SPEED_MHZ * 1e5 / INST_PER_MEGA_INST);
+}
+
+/* First clock tick after the current one that is a multiple of a period. */
+auto inline nextMultiple(u64 period) -> u64
+{
+    return (readClockMSR()/period + 1)*period;
+}
+
+/* Next clock tick a unit or block control clock fires at (its period is in instructions). */
+auto inline nextControlTick(u64 period) -> u64
+{
+    u64 step = ticksPerPeriod(period);
+    u64 from = std::max<u64>(readClockMSR()+1, controlWarmupTick());
+    return (from + step - 1)/step*step;
+}
+
+/* Arms the next chip role activation: aggregation, control step, telemetry pull or delivery epoch. */
+auto inline scheduleChipRole() -> void
+{
+    auto& node = rootNodeState;
+    //Reports drained this tick are aggregated at the next one.
+    if (node.dirty != 0)
+        roleTimers.schedule(ROLE_STATE_CHIP, readClockMSR()+1);
+    #if ENABLE_ADAPT_POLICY == 1
+    roleTimers.schedule(ROLE_STATE_CHIP, std::max<u64>(node.controlCycle, controlWarmupTick()));
+    #endif
+    for (u64 child = 0; child < N_UNITS_IN_CHIP; child++)
+    {
+        if (node.telemetryMode[child] != SA_ATR_TELEMETRY_MODE_PUSH)
+        {
+            roleTimers.schedule(ROLE_STATE_CHIP, nextMultiple(TELEMETRY_PULL_INTERVAL));
+            break;
+        }
+    }
+    if (node.children.dirty != 0)
+        roleTimers.schedule(ROLE_STATE_CHIP, nextMultiple(SA_MESSAGE_EPOCH));
+}
+
+/* Arms the next unit role activation: aggregation, control clock, telemetry pull or delivery epoch. */
+auto inline scheduleUnitRole() -> void
+{
+    auto& node = branchNodeState;
+    if (node.stale)
+        roleTimers.schedule(ROLE_STATE_UNIT, readClockMSR()+1);
+    #if ENABLE_ADAPT_POLICY == 1
+    if (!node.underControl)
+        roleTimers.schedule(ROLE_STATE_UNIT, nextControlTick(UNIT_CONTROL_CLOCK + agent.id*100));
+    #endif
+    if (node.telemetryMode != SA_ATR_TELEMETRY_MODE_PUSH)
+        roleTimers.schedule(ROLE_STATE_UNIT, nextMultiple(TELEMETRY_PULL_INTERVAL));
+    if ((node.children.dirty | node.parent.dirty) != 0)
+        roleTimers.schedule(ROLE_STATE_UNIT, nextMultiple(SA_MESSAGE_EPOCH));
+}
+
+/* Arms the next block role activation: control clock or delivery epoch. */
+//Note: swings and emergencies are caught every tick by blockSensorEvent().
+auto inline scheduleBlockRole() -> void
+{
+    auto& node = leafNodeState;
+    if (!node.emergency)
+    {
+        //Outside of the policy the control puts throttled XEs back to full speed.
+        bool throttled = false;
+        for (u64 i=0; i<N_CORES_IN_BLOCK; i++)
+            throttled |= agent.xe[i].state != XE_STATE_FULL;
+        #if ENABLE_ADAPT_POLICY == 1
+        roleTimers.schedule(ROLE_STATE_BLOCK, nextControlTick(BLOCK_CONTROL_CLOCK + agent.id*100));
+        throttled &= readClockMSR()+1 < controlWarmupTick();
+        #endif
+        if (throttled)
+            roleTimers.schedule(ROLE_STATE_BLOCK, readClockMSR()+1);
+    }
+    if (node.parent.dirty != 0)
+        roleTimers.schedule(ROLE_STATE_BLOCK, nextMultiple(SA_MESSAGE_EPOCH));
+}
+#endif
+
+#if TELEMETRY_MODE == 3
+/* Telemetry mode the chip wants from a unit subtree given the thermal headroom of its hottest blocks. */
+//Note: units close to the operating temperature push every swing, cool ones are
+//      only pulled and the ones in between are hybrid. Going back to a cooler
+//      mode takes TELEMETRY_HEADROOM_HYSTERESIS more degrees of headroom.
+auto inline chipTelemetryMode(u64 mode, FLOAT_TYPE headroom) -> u64
+{
+    if (headroom < TELEMETRY_HEADROOM_PUSH)
+        return SA_ATR_TELEMETRY_MODE_PUSH;
+    if (headroom < TELEMETRY_HEADROOM_PULL)
+        return (mode == SA_ATR_TELEMETRY_MODE_PUSH && headroom < TELEMETRY_HEADROOM_PUSH + TELEMETRY_HEADROOM_HYSTERESIS) ?
+               SA_ATR_TELEMETRY_MODE_PUSH : SA_ATR_TELEMETRY_MODE_HYBRID;
+    if (mode != SA_ATR_TELEMETRY_MODE_PULL && headroom < TELEMETRY_HEADROOM_PULL + TELEMETRY_HEADROOM_HYSTERESIS)
+        return mode;
+    return SA_ATR_TELEMETRY_MODE_PULL;
+}
+#endif
+
 unsigned int seed = 0;
 auto inline chipControl() -> void
 {
@@ -567,12 +725,10 @@ auto inline chipControl() -> void
     //We would like to check if our current total power is above the power budget, if so, modify the multiplier and update the power budget of an aleatory unit
     //If the current total power is above the powerGoal plus 10%
 
-    static thread_local u64 waitCycles = 1;
-    waitCycles--;
     static thread_local s64 dampener = 0;
-    if (!waitCycles)
+    if (readClockMSR() >= rootNodeState.controlCycle)
     {
-        waitCycles = CHIP_CONTROL_CLOCK;
+        rootNodeState.controlCycle = readClockMSR() + CHIP_CONTROL_CLOCK;
         //Pick up a unit randomly
         int randomUnit=rand_r(&seed)%N_UNITS_IN_CHIP;
         if(adjustMultiplier(rootNodeState.powerTotal, rootNodeState.powerGoal, rootNodeState.currentMultipliers[randomUnit], dampener))
@@ -582,9 +738,9 @@ auto inline chipControl() -> void
             u64 typeIns = SA_ATR_FUB_CTRL_POWER_GOAL_VALID;
             //Type of control Power Goal. Value node.powerGoal/N_BLOCKS_IN_UNIT
             FLOAT_TYPE powerPerBlock=rootNodeState.powerGoal*rootNodeState.currentMultipliers[randomUnit]/N_UNITS_IN_CHIP;
-            saSetMetadata(&msgPowerGoal, SA_ATR_FUB_CTRL, &typeIns);
-            saSetMetadata(&msgPowerGoal, SA_ATR_FUB_POWER_GOAL, &powerPerBlock);
-            rootNodeState.childBuffers[randomUnit].push_back(*reinterpret_cast<saMetadata*>(&msgPowerGoal));
+            sa::set<SA_ATR_FUB_CTRL>(msgPowerGoal, typeIns);
+            sa::set<SA_ATR_FUB_POWER_GOAL>(msgPowerGoal, powerPerBlock);
+            rootNodeState.children.push(randomUnit, sa::generic(msgPowerGoal));
         }
     }
     #endif
@@ -600,41 +756,62 @@ auto inline chipRole() -> void
 
     if (agent.bid == 0 && agent.uid == 0) // Congratulations you were picked as the controller in your chip.
     {
-        //Temperature related.
-        node.temperatureAvg  = computeAverage(node.temperatureAvgMap, N_UNITS_IN_CHIP);
-        FLOAT_TYPE avgOfVar = computeAverage(node.temperatureVarMap, N_UNITS_IN_CHIP);
-        node.temperatureVar  = avgOfVar + computeVariance(node.temperatureAvgMap,
-                                           node.temperatureAvg, N_UNITS_IN_CHIP);
-        node.temperatureSD   = sqrt(node.temperatureVar);
-        node.temperatureSkew = computeAverage(node.temperatureSkewMap, N_UNITS_IN_CHIP)
-                                         + computeSkew(node.temperatureAvgMap, node.temperatureAvg, N_UNITS_IN_CHIP)
-                                         + 3*computeCovariance(node.temperatureAvgMap, node.temperatureAvg,
-                                           node.temperatureVarMap, avgOfVar, N_UNITS_IN_CHIP);
-
-        //Power related -- note that that these statistics ignore lower level data points.
-        node.powerTotal = 0.0;
-        for (u64 i=0; i<N_UNITS_IN_CHIP; i++)
-            node.powerTotal += node.powerTotalMap[i];
-        node.powerAvg  = node.powerTotal/N_UNITS_IN_CHIP;
-        node.powerVar  = computeVariance(node.powerTotalMap,
-                         node.powerAvg, N_UNITS_IN_CHIP);
-        node.powerSD   = sqrt(node.powerVar);
-        node.powerSkew = computeSkew(node.powerTotalMap,
-                         node.powerAvg, N_UNITS_IN_CHIP);
+        //Aggregate only if a unit reported since last time.
+        if (node.dirty != 0)
+        {
+            //Temperature related -- pooled over the units (one pass).
+            Moments temperature = computePooledMoments(node.temperatureAvgMap, node.temperatureVarMap,
+                                                       node.temperatureSkewMap, N_UNITS_IN_CHIP);
+            node.temperatureAvg  = temperature.mean;
+            node.temperatureVar  = temperature.variance;
+            node.temperatureSD   = sqrt(node.temperatureVar);
+            node.temperatureSkew = temperature.skew;
+
+            //Power related -- note that that these statistics ignore lower level data points.
+            Moments power = computeMoments(node.powerTotalMap, N_UNITS_IN_CHIP);
+            node.powerAvg  = power.mean;
+            node.powerTotal = power.mean*N_UNITS_IN_CHIP;
+            node.powerVar  = power.variance;
+            node.powerSD   = sqrt(node.powerVar);
+            node.powerSkew = power.skew;
+
+            node.dirty = 0;
+            agent.statistics.aggregations[ROLE_STATE_CHIP]++;
+        }
+        else
+            agent.statistics.aggregationsSkipped[ROLE_STATE_CHIP]++;
 
         //CONTROL POLICY
         chipControl();
+
+        //Telemetry -- switch the unit subtrees to their mode and pull the ones that do not push everything.
+        for (u64 child = 0; child < N_UNITS_IN_CHIP; child++)
+        {
+            #if TELEMETRY_MODE == 3
+            //Headroom of the hottest blocks of the unit (temperatures are reported as deltas to TEMPERATURE_OPERATION).
+            node.telemetryMode[child] = chipTelemetryMode(node.telemetryMode[child], node.temperatureAvgMap[child] - 2*node.temperatureSDMap[child]);
+            #endif
+            if (node.telemetryMode[child] != node.childrenTelemetryMode[child])
+            {
+                requestTelemetry(node, child, SA_METADATA_TYPE_NONE, node.telemetryMode[child]);
+                node.childrenTelemetryMode[child] = node.telemetryMode[child];
+            }
+            else if (node.telemetryMode[child] != SA_ATR_TELEMETRY_MODE_PUSH && readClockMSR() % TELEMETRY_PULL_INTERVAL == 0)
+                requestTelemetry(node, child, SA_METADATA_TYPE_AGG_INFO, node.telemetryMode[child]);
+        }
         /*We check the mail */
 
-        //Iterate over child mailboxes.
-        for(u64 child=0; child<N_UNITS_IN_CHIP; child++)
+        //Iterate over child mailboxes -- the urgent lanes of all of them first, then the routine ones.
+        for(u64 lane=0; lane<2*N_UNITS_IN_CHIP; lane++)
         {
             //Grab child slot location.
+            u64 child = lane % N_UNITS_IN_CHIP;
+            bool urgent = lane < N_UNITS_IN_CHIP;
             saLocation childSlot = saGetChildLocation(child);
 
-            //Fetch message from slot.
+            //Drain the mailbox.
             saMetadata msg;
-            if(saRecvMetadata(childSlot,(void*)&msg) == 0)
+            while((urgent ? saRecvUrgentMetadata(childSlot,(void*)&msg) : saRecvMetadata(childSlot,(void*)&msg)) == 0)
             {
                 //Success.
                 if (*(u64*)&msg != 0)
@@ -642,32 +819,35 @@ auto inline chipRole() -> void
                     //Found message.
                     u64 attr;
 
-                    ///FIXME: add metadata APIs for checking this type of thing?
                     //Retrieve metadata type.
-                    saGetMetadata(&msg, SA_ATR_METADATA_TYPE, &attr);
+                    attr = sa::get<SA_ATR_METADATA_TYPE>(msg);
                     switch(attr)
                     {
                         case SA_METADATA_TYPE_AGG_INFO:
                         {
+                            auto& aggMsg = sa::as<SA_METADATA_TYPE_AGG_INFO>(msg);
+
                             //Record temperature data (implicit unpacking in the API).
                             {
                                 //record aggregated data.
-                                saGetMetadata(&msg, SA_ATR_AGG_TEMP_MEAN, &node.temperatureAvgMap[child]);
-                                saGetMetadata(&msg, SA_ATR_AGG_TEMP_SD, &node.temperatureSDMap[child]);
+                                node.temperatureAvgMap[child] = sa::get<SA_ATR_AGG_TEMP_MEAN>(aggMsg);
+                                node.temperatureSDMap[child] = sa::get<SA_ATR_AGG_TEMP_SD>(aggMsg);
                                 node.temperatureVarMap[child] = node.temperatureSDMap[child]*node.temperatureSDMap[child];
-                                saGetMetadata(&msg, SA_ATR_AGG_TEMP_SKEW, &node.temperatureSkewMap[child]);
+                                node.temperatureSkewMap[child] = sa::get<SA_ATR_AGG_TEMP_SKEW>(aggMsg);
                             }
 
                             //Record power data (implicit unpacking in the API).
                             {
                                 //record aggregated data.
-                                saGetMetadata(&msg, SA_ATR_AGG_POW_MEAN, &node.powerAvgMap[child]);
+                                node.powerAvgMap[child] = sa::get<SA_ATR_AGG_POW_MEAN>(aggMsg);
                                 node.powerTotalMap[child] = node.powerAvgMap[child]*N_BLOCKS_IN_UNIT;
-                                saGetMetadata(&msg, SA_ATR_AGG_POW_SD, & node.powerSDMap[child]);
+                                node.powerSDMap[child] = sa::get<SA_ATR_AGG_POW_SD>(aggMsg);
                                 node.powerVarMap[child] = node.powerSDMap[child]*node.powerSDMap[child];
-                                saGetMetadata(&msg, SA_ATR_AGG_POW_SKEW, &node.powerSkewMap[child]);
+                                node.powerSkewMap[child] = sa::get<SA_ATR_AGG_POW_SKEW>(aggMsg);
                             }
 
+                            node.dirty |= 1UL << child;
+
                             break;
                         }
                         default:
@@ -682,7 +862,7 @@ auto inline chipRole() -> void
             if (node.powerGoal != POWER_GOAL)
             {
                 node.powerGoal = POWER_GOAL;
-                fprintf(agent.logfile, "[RMD_CONTROL_EVENT] [CHIP_POWER_GOAL_CHANGE] %f at cycle %ld \n", node.powerGoal, readClockMSR()*INST_PER_MEGA_INST);
+                logEvent(LOG_CHIP_POWER_GOAL, node.powerGoal);
                 for (u64 child = 0 ; child < N_UNITS_IN_CHIP ; child++)
                 {
                     //Message to be sent
@@ -690,10 +870,10 @@ auto inline chipRole() -> void
                     u64 typeIns = SA_ATR_FUB_CTRL_POWER_GOAL_VALID;
                     //Type of control Power Goal. Value node.powerGoal/N_UNITS_IN_CHIP
                     FLOAT_TYPE powerPerUnit = node.powerGoal/N_UNITS_IN_CHIP;
-                    saSetMetadata(&ctrlMsg, SA_ATR_FUB_CTRL, &typeIns);
-                    saSetMetadata(&ctrlMsg, SA_ATR_FUB_POWER_GOAL, &powerPerUnit);
+                    sa::set<SA_ATR_FUB_CTRL>(ctrlMsg, typeIns);
+                    sa::set<SA_ATR_FUB_POWER_GOAL>(ctrlMsg, powerPerUnit);
 
-                    node.childBuffers[child].push_back(*reinterpret_cast<saMetadata*>(&ctrlMsg));
+                    node.children.push(child, sa::generic(ctrlMsg));
                 }
             }
 
@@ -727,7 +907,15 @@ auto inline chipRole() -> void
         }
     }
     //Flush messages
-    node.flush();
+    {
+        PROBE(PROBE_FLUSH);
+        node.flush();
+    }
+
+    #if ROLE_TIMER_WHEEL == 1
+    if (agent.bid == 0 && agent.uid == 0)
+        scheduleChipRole();
+    #endif
 }
 
 auto inline unitControl() -> void
@@ -752,9 +940,9 @@ auto inline unitControl() -> void
                 u64 typeIns = SA_ATR_FUB_CTRL_POWER_GOAL_VALID;
                 //Type of control Power Goal. Value node.powerGoal/N_BLOCKS_IN_UNIT
                 FLOAT_TYPE powerPerBlock= branchNodeState.powerGoal*branchNodeState.currentMultipliers[randomUnit]/N_BLOCKS_IN_UNIT;
-                saSetMetadata(&msgPowerGoal, SA_ATR_FUB_CTRL, &typeIns);
-                saSetMetadata(&msgPowerGoal, SA_ATR_FUB_POWER_GOAL, &powerPerBlock);
-                branchNodeState.childBuffers[randomUnit].push_back(*reinterpret_cast<saMetadata*>(&msgPowerGoal));
+                sa::set<SA_ATR_FUB_CTRL>(msgPowerGoal, typeIns);
+                sa::set<SA_ATR_FUB_POWER_GOAL>(msgPowerGoal, powerPerBlock);
+                branchNodeState.children.push(randomUnit, sa::generic(msgPowerGoal));
             }
         }
         #endif
@@ -778,24 +966,28 @@ auto inline unitRole() -> void
     {
         //Compute aggregate statistics.
 
-        //Temperature related.
-        node.temperatureAvg  = computeAverage(node.temperatureMap,
-                                              N_BLOCKS_IN_UNIT);
-        node.temperatureVar  = computeVariance(node.temperatureMap,
-                                               node.temperatureAvg, N_BLOCKS_IN_UNIT);
-        node.temperatureSD   = sqrt(node.temperatureVar);
-        node.temperatureSkew = computeSkew(node.temperatureMap,
-                                           node.temperatureAvg, N_BLOCKS_IN_UNIT);
-        //Power related.
-        node.powerTotal = 0.0;
-        for (u64 i=0; i<N_BLOCKS_IN_UNIT; i++)
-           node.powerTotal += node.powerMap[i];
-        node.powerAvg  = node.powerTotal/N_BLOCKS_IN_UNIT;
-        node.powerVar  = computeVariance(node.powerMap,
-                                         node.powerAvg, N_BLOCKS_IN_UNIT);
-        node.powerSD   = sqrt(node.powerVar);
-        node.powerSkew = computeSkew(node.powerMap,
-                                     node.powerAvg, N_BLOCKS_IN_UNIT);
+        //Aggregate only if a block reported since last time.
+        if (node.stale)
+        {
+            //Temperature related (kept up to date as the blocks report).
+            Moments temperature = momentsGet(&node.temperatureMoments);
+            node.temperatureAvg  = temperature.mean;
+            node.temperatureVar  = temperature.variance;
+            node.temperatureSD   = sqrt(node.temperatureVar);
+            node.temperatureSkew = temperature.skew;
+            //Power related.
+            Moments power = momentsGet(&node.powerMoments);
+            node.powerAvg  = power.mean;
+            node.powerTotal = power.mean*N_BLOCKS_IN_UNIT;
+            node.powerVar  = power.variance;
+            node.powerSD   = sqrt(node.powerVar);
+            node.powerSkew = power.skew;
+
+            node.stale = false;
+            agent.statistics.aggregations[ROLE_STATE_UNIT]++;
+        }
+        else
+            agent.statistics.aggregationsSkipped[ROLE_STATE_UNIT]++;
 
           //control policy
           unitControl();
@@ -804,9 +996,9 @@ auto inline unitRole() -> void
           //Grab parent slot location.
           saLocation parentSlot = saGetParentLocation();
 
-          //Fetch message from slot.
+          //Drain the mailbox.
           saMetadata msg;
-          if(saRecvMetadata(parentSlot,(void*)&msg) == 0)
+          while(saRecvMetadata(parentSlot,(void*)&msg) == 0)
           {
               sendData = true;
               //Success.
@@ -814,28 +1006,28 @@ auto inline unitRole() -> void
               {
                   //Found message.
                   u64 attr;
-                  ///FIXME: add metadata APIs for checking this type of thing?
                   //Retrieve metadata type.
-                  saGetMetadata(&msg, SA_ATR_METADATA_TYPE, &attr);
+                  attr = sa::get<SA_ATR_METADATA_TYPE>(msg);
                   switch(attr)
                   {
                       //Incoming control instruction.
                       case SA_METADATA_TYPE_BLK_CTRL:
                       {
+                          auto& ctrlMsg = sa::as<SA_METADATA_TYPE_BLK_CTRL>(msg);
+
                           //Grab the type of instruction.
-                          u64 typeIns;
-                          saGetMetadata(&msg, SA_ATR_FUB_CTRL, &typeIns);
+                          u64 typeIns = sa::get<SA_ATR_FUB_CTRL>(ctrlMsg);
                           switch (typeIns)
                           {
                                //Change the power goal
                                case SA_ATR_FUB_CTRL_POWER_GOAL_VALID:
                                    //Set power goal to the value in the message. Inform the change to the childrens.
                                    FLOAT_TYPE newPowerGoal;
-                                   saGetMetadata(&msg, SA_ATR_FUB_POWER_GOAL, &newPowerGoal);
+                                   newPowerGoal = sa::get<SA_ATR_FUB_POWER_GOAL>(ctrlMsg);
                                    if (node.powerGoal != newPowerGoal)
                                    {
                                        node.powerGoal = newPowerGoal*UNIT_POWER_GOAL_SCALE;
-                                       fprintf(agent.logfile, "[RMD_CONTROL_EVENT] [UNIT_POWER_GOAL_CHANGE] %f at cycle %ld \n", node.powerGoal, readClockMSR()*INST_PER_MEGA_INST);
+                                       logEvent(LOG_UNIT_POWER_GOAL, node.powerGoal);
                                        //Set a new power goal for the children.
                                        for (u64 i = 0 ; i < N_BLOCKS_IN_UNIT ; i++)
                                        {
@@ -844,10 +1036,10 @@ auto inline unitRole() -> void
                                             typeIns = SA_ATR_FUB_CTRL_POWER_GOAL_VALID;
                                             //Type of control Power Goal. Value node.powerGoal/N_BLOCKS_IN_UNIT
                                             FLOAT_TYPE powerPerBlock=node.powerGoal/N_BLOCKS_IN_UNIT;
-                                            saSetMetadata(&msgPowerGoal, SA_ATR_FUB_CTRL, &typeIns);
-                                            saSetMetadata(&msgPowerGoal, SA_ATR_FUB_POWER_GOAL, &powerPerBlock);
+                                            sa::set<SA_ATR_FUB_CTRL>(msgPowerGoal, typeIns);
+                                            sa::set<SA_ATR_FUB_POWER_GOAL>(msgPowerGoal, powerPerBlock);
 
-                                            node.childBuffers[i].push_back(*reinterpret_cast<saMetadata*>(&msgPowerGoal));
+                                            node.children.push(i, sa::generic(msgPowerGoal));
                                        }
                                    }
                                    break;
@@ -857,20 +1049,45 @@ auto inline unitRole() -> void
                           }
                           break;
                       }
+
+                      //Incoming telemetry request (or mode change for our subtree).
+                      case SA_METADATA_TYPE_INF_CTRL:
+                      {
+                          auto& infMsg = sa::as<SA_METADATA_TYPE_INF_CTRL>(msg);
+                          node.telemetryMode = sa::get<SA_ATR_TELEMETRY_MODE>(infMsg);
+                          if (sa::get<SA_ATR_REQ_METADATA_TYPE>(infMsg) == SA_METADATA_TYPE_AGG_INFO)
+                              node.telemetryRequested = true;
+                          break;
+                      }
                   }
               }
           }
 
+          //Telemetry -- hand our mode down to the blocks and pull them unless they push everything.
+          if (node.telemetryMode != node.childrenTelemetryMode)
+          {
+              for (u64 child = 0; child < N_BLOCKS_IN_UNIT; child++)
+                  requestTelemetry(node, child, SA_METADATA_TYPE_NONE, node.telemetryMode);
+              node.childrenTelemetryMode = node.telemetryMode;
+          }
+          else if (node.telemetryMode != SA_ATR_TELEMETRY_MODE_PUSH && readClockMSR() % TELEMETRY_PULL_INTERVAL == 0)
+          {
+              for (u64 child = 0; child < N_BLOCKS_IN_UNIT; child++)
+                  requestTelemetry(node, child, SA_METADATA_TYPE_BLK_INFO, node.telemetryMode);
+          }
+
 
-        //Iterate over child mailboxes.
-        for(u64 child=0; child<N_BLOCKS_IN_UNIT; child++)
+        //Iterate over child mailboxes -- the urgent lanes of all of them first, then the routine ones.
+        for(u64 lane=0; lane<2*N_BLOCKS_IN_UNIT; lane++)
         {
             //Grab child slot location.
+            u64 child = lane % N_BLOCKS_IN_UNIT;
+            bool urgent = lane < N_BLOCKS_IN_UNIT;
             saLocation childSlot = saGetChildLocation(child);
 
-            //Fetch message from slot.
+            //Drain the mailbox.
             saMetadata msg;
-            if(saRecvMetadata(childSlot,(void*)&msg) == 0)
+            while((urgent ? saRecvUrgentMetadata(childSlot,(void*)&msg) : saRecvMetadata(childSlot,(void*)&msg)) == 0)
             {
                 sendData = true;
                //Success.
@@ -879,18 +1096,19 @@ auto inline unitRole() -> void
                     //Found message.
                     u64 attr;
 
-                    ///FIXME: add metadata APIs for checking this type of thing?
                     //Retrieve metadata type.
-                    saGetMetadata(&msg, SA_ATR_METADATA_TYPE, &attr);
+                    attr = sa::get<SA_ATR_METADATA_TYPE>(msg);
                     switch(attr)
                     {
                         //Incoming block information packet.
                         case SA_METADATA_TYPE_BLK_INFO:
                         {
+                            auto& infoMsg = sa::as<SA_METADATA_TYPE_BLK_INFO>(msg);
+
                             //Decode and handle the temperature (implicit unpacking in the API).
                             {
                                 // Grab temperature directly (No need to unpack).
-                                saGetMetadata(&msg, SA_ATR_FUB_TEMP_SCORE, &node.temperatureMap[child]);
+                                momentsReplace(&node.temperatureMoments, node.temperatureMap, child, sa::get<SA_ATR_FUB_TEMP_SCORE>(infoMsg));
 
                                 //                                      //Compute real temperature from delta.
                                 //                                      FLOAT_TYPE temperature = TEMPERATURE_OPERATION - node.temperatureMap[child];
@@ -901,7 +1119,7 @@ auto inline unitRole() -> void
                                 //                                           saBlkCtrlMetadata ctrlMsg = SA_BLK_CTRL_METADATA_INITIALIZER;
                                 //                                           attr = SA_ATR_FUB_DVFS_SCORE_NONE;
                                 //                                           saSetMetadata(&ctrlMsg, SA_ATR_FUB_DVFS_SCORE, &attr);
-                                //                                           node.childBuffers[child].push_back(*reinterpret_cast<saMetadata*>(&ctrlMsg));
+                                //                                           node.children.push(child, sa::generic(ctrlMsg));
                                 //                                      }
                                 //                                      else if(temperature > 70.0)
                                 //                                      {
@@ -909,14 +1127,26 @@ auto inline unitRole() -> void
                                 //                                           saBlkCtrlMetadata ctrlMsg = SA_BLK_CTRL_METADATA_INITIALIZER;
                                 //                                           attr = SA_ATR_FUB_DVFS_SCORE_HALF;
                                 //                                           saSetMetadata(&ctrlMsg, SA_ATR_FUB_DVFS_SCORE, &attr);
-                                //                                           node.childBuffers[child].push_back(*reinterpret_cast<saMetadata*>(&ctrlMsg));
+                                //                                           node.children.push(child, sa::generic(ctrlMsg));
                                 //                                      }
                             }
 
                             //Decode and handle the power.
                             {
                                // Grab power.
-                               saGetMetadata(&msg, SA_ATR_FUB_POW_SCORE, &node.powerMap[child]);
+                               momentsReplace(&node.powerMoments, node.powerMap, child, sa::get<SA_ATR_FUB_POW_SCORE>(infoMsg));
+                            }
+                            node.dirty |= 1UL << child;
+                            node.stale = true;
+
+                            //Thermal emergency -- slow the block down right away.
+                            if (sa::get<SA_ATR_URGENCY>(infoMsg))
+                            {
+                                saBlkCtrlMetadata ctrlMsg = SA_BLK_CTRL_METADATA_INITIALIZER;
+                                sa::set<SA_ATR_FUB_CTRL>(ctrlMsg, SA_ATR_FUB_CTRL_DVFS_VALID);
+                                sa::set<SA_ATR_FUB_DVFS_SCORE>(ctrlMsg, SA_ATR_FUB_DVFS_SCORE_HALF);
+                                sa::set<SA_ATR_URGENCY>(ctrlMsg, 1);
+                                node.children.push(child, sa::generic(ctrlMsg));
                             }
                             sendData = true;
                             break;
@@ -929,14 +1159,27 @@ auto inline unitRole() -> void
             }
         }
 
-        for(u64 child=0; child<N_BLOCKS_IN_UNIT; child++)
+        FLOAT_TYPE swingScale = (node.telemetryMode == SA_ATR_TELEMETRY_MODE_HYBRID) ? TELEMETRY_HYBRID_SWING_SCALE : 1.0;
+        //Only the children that reported can have swung since the last check.
+        bool swing = false;
+        for(u64 bits = node.dirty; bits != 0; bits &= bits - 1)
         {
-            if (fabs(oldTemp[child]-node.temperatureMap[child]) > TEMPERATURE_SWING || fabs(oldPower[child]-node.powerMap[child]) > POWER_SWING)
+            u64 child = __builtin_ctzl(bits);
+            if (fabs(oldTemp[child]-node.temperatureMap[child]) > TEMPERATURE_SWING*swingScale || fabs(oldPower[child]-node.powerMap[child]) > POWER_SWING*swingScale)
             {
-                sendData = true;
+                swing = true;
                 break;
             }
         }
+        node.dirty = 0;
+
+        //Push reports on any news, pull only when asked and hybrid on large swings too.
+        if (node.telemetryMode == SA_ATR_TELEMETRY_MODE_PUSH)
+            sendData = sendData || swing;
+        else
+            sendData = node.telemetryRequested || (node.telemetryMode == SA_ATR_TELEMETRY_MODE_HYBRID && swing);
+        node.telemetryRequested = false;
+
         if (sendData == true)
         {
             for(u64 child=0; child<N_BLOCKS_IN_UNIT; child++)
@@ -973,22 +1216,30 @@ auto inline unitRole() -> void
 
             //Transfer our aggregate temperatures.
             {
-               saMetadata msg = SA_AGG_INFO_METADATA_INITIALIZER;
+               saAggInfoMetadata msg = SA_AGG_INFO_METADATA_INITIALIZER;
 
                //Push temperature and power to next level CE (packing is transparently done in the API).
-               saSetMetadata(&msg, SA_ATR_AGG_TEMP_MEAN, &node.temperatureAvg);
-               saSetMetadata(&msg, SA_ATR_AGG_TEMP_SD, &node.temperatureSD);
-               saSetMetadata(&msg, SA_ATR_AGG_TEMP_SKEW, &node.temperatureSkew);
-               saSetMetadata(&msg, SA_ATR_AGG_POW_MEAN, &node.powerAvg);
-               saSetMetadata(&msg, SA_ATR_AGG_POW_SD, &node.powerSD);
-               saSetMetadata(&msg, SA_ATR_AGG_POW_SKEW, &node.powerSkew);
-
-               node.push(msg);
+               sa::set<SA_ATR_AGG_TEMP_MEAN>(msg, node.temperatureAvg);
+               sa::set<SA_ATR_AGG_TEMP_SD>(msg, node.temperatureSD);
+               sa::set<SA_ATR_AGG_TEMP_SKEW>(msg, node.temperatureSkew);
+               sa::set<SA_ATR_AGG_POW_MEAN>(msg, node.powerAvg);
+               sa::set<SA_ATR_AGG_POW_SD>(msg, node.powerSD);
+               sa::set<SA_ATR_AGG_POW_SKEW>(msg, node.powerSkew);
+
+               node.push(sa::generic(msg));
             }
         }
     }
     //flush messages
-    node.flush();
+    {
+        PROBE(PROBE_FLUSH);
+        node.flush();
+    }
+
+    #if ROLE_TIMER_WHEEL == 1
+    if (agent.bid == 0)
+        scheduleUnitRole();
+    #endif
 }
 
 auto inline blockControl() -> void
@@ -1004,6 +1255,10 @@ auto inline blockControl() -> void
 //         }
 //
 
+    //Thermal emergency -- keep the DVFS state set by the parent.
+    if(leafNodeState.emergency)
+        return;
+
     if(readClockMSR()*INST_PER_MEGA_INST < MAX_XE_CLOCK_SPEED_MHZ * 1e5)
     {
         for(u64 i=0; i<N_CORES_IN_BLOCK; i++)
@@ -1038,7 +1293,7 @@ auto inline blockControl() -> void
                     if (agent.xe[i].state != XE_STATE_FULL)
                     {
                         agent.xe[i].state = XE_STATE_FULL;
-                        fprintf(agent.logfile, "[RMD_CONTROL_EVENT] [STATE_CHANGE] FULL at cycle %ld \n", readClockMSR()*INST_PER_MEGA_INST);
+                        logEvent(LOG_STATE_CHANGE, 1UL);
                         dampener = DAMPENER;
                         break;
                     }
@@ -1051,7 +1306,7 @@ auto inline blockControl() -> void
                     if (agent.xe[i].state != XE_STATE_HALF)
                     {
                         agent.xe[i].state = XE_STATE_HALF;
-                        fprintf(agent.logfile, "[RMD_CONTROL_EVENT] [STATE_CHANGE] HALF at cycle %ld \n", readClockMSR()*INST_PER_MEGA_INST);
+                        logEvent(LOG_STATE_CHANGE, 0UL);
                         dampener = DAMPENER;
                         break;
                     }
@@ -1061,6 +1316,14 @@ auto inline blockControl() -> void
     #endif
 }
 
+/* Whether the block moved far enough from its last report to report again (push and hybrid modes). */
+auto inline blockSwing(FLOAT_TYPE tempDelta, FLOAT_TYPE power) -> bool
+{
+    auto& node = leafNodeState;
+    FLOAT_TYPE swingScale = (node.telemetryMode == SA_ATR_TELEMETRY_MODE_HYBRID) ? TELEMETRY_HYBRID_SWING_SCALE : 1.0;
+    return fabs(node.reportedTemp-tempDelta) > TEMPERATURE_SWING*swingScale || fabs(node.reportedPower-power) > POWER_SWING*swingScale;
+}
+
 auto inline blockRole() -> void
 {
     if(agent.done == true)
@@ -1069,9 +1332,6 @@ auto inline blockRole() -> void
 
     auto& node = leafNodeState;
 
-    static thread_local FLOAT_TYPE oldTemp  = 0.0;
-    static thread_local FLOAT_TYPE oldPower = 0.0;
-
     FLOAT_TYPE tempDelta = readTemperatureMSR(); //read from MSR (should be 7 bits max).
     FLOAT_TYPE temperature = TEMPERATURE_JUNCTION - tempDelta;
 
@@ -1082,10 +1342,10 @@ auto inline blockRole() -> void
     //Grab parent slot location.
     saLocation parentSlot = saGetParentLocation();
 
-    //Fetch message from slot.
+    //Drain the mailbox.
 
     saMetadata msg;
-    if(saRecvMetadata(parentSlot,(void*)&msg) == 0)
+    while(saRecvMetadata(parentSlot,(void*)&msg) == 0)
     {
          //Success.
          if (*(u64*)&msg != 0)
@@ -1093,35 +1353,33 @@ auto inline blockRole() -> void
              //Found message.
              u64 attr;
 
-             ///FIXME: add metadata APIs for checking this type of thing?
              //Retrieve metadata type.
-             saGetMetadata(&msg, SA_ATR_METADATA_TYPE, &attr);
+             attr = sa::get<SA_ATR_METADATA_TYPE>(msg);
              switch(attr)
              {
                   //Incoming control instruction
                   case SA_METADATA_TYPE_BLK_CTRL:
                   {
+                      auto& ctrlMsg = sa::as<SA_METADATA_TYPE_BLK_CTRL>(msg);
+
                       //Grab the type of instruction.
-                      u64 typeIns;
-                      saGetMetadata(&msg, SA_ATR_FUB_CTRL, &typeIns);
+                      u64 typeIns = sa::get<SA_ATR_FUB_CTRL>(ctrlMsg);
                       switch (typeIns)
                       {
                         //Change the power goal
                         case SA_ATR_FUB_CTRL_POWER_GOAL_VALID:
                              //Set power goal to the value in the message.
-                             saGetMetadata(&msg, SA_ATR_FUB_POWER_GOAL, &node.powerGoal);
+                             node.powerGoal = sa::get<SA_ATR_FUB_POWER_GOAL>(ctrlMsg);
                              //node.powerGoal*=BLOCK_POWER_GOAL_SCALE;
-                             fprintf(agent.logfile, "[RMD_CONTROL_EVENT] [BLOCK_POWER_GOAL_CHANGE] %f at cycle %ld \n", node.powerGoal, readClockMSR()*INST_PER_MEGA_INST);
+                             logEvent(LOG_BLOCK_POWER_GOAL, node.powerGoal);
                              break;
                         case SA_ATR_FUB_CTRL_UNDER_CONTROL_VALID:
-                             unsigned int underControl;
-                             saGetMetadata(&msg, SA_ATR_FUB_UNDER_CONTROL,&underControl);
-                             node.underControl=underControl;
-                             fprintf(agent.logfile, "[RMD_CONTROL_EVENT] [BLOCK_UNDER_CONTROL_CHANGE] %d at cycle %ld \n", underControl, readClockMSR()*INST_PER_MEGA_INST);
+                             node.underControl = sa::get<SA_ATR_FUB_UNDER_CONTROL>(ctrlMsg);
+                             logEvent(LOG_BLOCK_UNDER_CONTROL, (u64) node.underControl);
                              break;
                         //TODO DVFS The Unit. (NOT BEEING USED)
                         case SA_ATR_FUB_CTRL_DVFS_VALID:
-                             saGetMetadata(&msg, SA_ATR_FUB_DVFS_SCORE, &attr);
+                             attr = sa::get<SA_ATR_FUB_DVFS_SCORE>(ctrlMsg);
                              if(attr == SA_ATR_FUB_DVFS_SCORE_NONE)
                              {
                                  for(u64 i=0; i<8; i++)
@@ -1135,8 +1393,21 @@ auto inline blockRole() -> void
                                  {
                                       agent.xe[i].state = XE_STATE_HALF;
                                  }
+
+                                 //Answer to our thermal emergency.
+                                 if (sa::get<SA_ATR_URGENCY>(ctrlMsg) && node.emergency && !node.emergencyAnswered)
+                                 {
+                                     u64 latency = readClockMSR() - node.emergencyCycle;
+                                     agent.statistics.emergencies++;
+                                     agent.statistics.emergencyLatencyTotal += latency;
+                                     if (latency > agent.statistics.emergencyLatencyMax)
+                                         agent.statistics.emergencyLatencyMax = latency;
+                                     node.emergencyAnswered = true;
+                                     logEvent(LOG_EMERGENCY_DVFS, latency*INST_PER_MEGA_INST);
+                                 }
                              }
-                             else if (attr == SA_ATR_FUB_DVFS_SCORE_FULL)
+                             //Routine control cannot raise the frequency during a thermal emergency.
+                             else if (attr == SA_ATR_FUB_DVFS_SCORE_FULL && (!node.emergency || sa::get<SA_ATR_URGENCY>(ctrlMsg)))
                              {
                                  for(u64 i=0; i<8; i++)
                                  {
@@ -1149,6 +1420,15 @@ auto inline blockRole() -> void
                       }
                       break;
                   }
+                  //Incoming telemetry request (or mode change).
+                  case SA_METADATA_TYPE_INF_CTRL:
+                  {
+                      auto& infMsg = sa::as<SA_METADATA_TYPE_INF_CTRL>(msg);
+                      node.telemetryMode = sa::get<SA_ATR_TELEMETRY_MODE>(infMsg);
+                      if (sa::get<SA_ATR_REQ_METADATA_TYPE>(infMsg) == SA_METADATA_TYPE_BLK_INFO)
+                          node.telemetryRequested = true;
+                      break;
+                  }
                   default:
                       printf("unt%ld.blk%ld: WARNING: block role received unknown metadata message %ld!\n", agent.uid, agent.bid, attr);
              }
@@ -1158,14 +1438,41 @@ auto inline blockRole() -> void
     //Grab the power usage of the block.
     FLOAT_TYPE power = readPowerMSR();
 
+    #if THERMAL_EMERGENCY == 1
+    //Thermal emergency -- tell the parent right away (urgent lane, no swing or epoch).
+    if (!node.emergency && temperature >= TEMPERATURE_EMERGENCY)
+    {
+        node.emergency = true;
+        node.emergencyAnswered = false;
+        node.emergencyCycle = readClockMSR();
+        logEvent(LOG_EMERGENCY, temperature);
+
+        saBlkInfoMetadata msg = SA_BLK_INFO_METADATA_INITIALIZER;
+        FLOAT_TYPE delta = (temperature < TEMPERATURE_OPERATION) ? TEMPERATURE_OPERATION-temperature : 0;
+        sa::set<SA_ATR_URGENCY>(msg, 1);
+        sa::set<SA_ATR_FUB_TEMP_SCORE>(msg, delta);
+        sa::set<SA_ATR_FUB_POW_SCORE>(msg, power);
+        node.push(sa::generic(msg));
+    }
+    else if (node.emergency && temperature < TEMPERATURE_EMERGENCY - TEMPERATURE_EMERGENCY_HYSTERESIS)
+    {
+        node.emergency = false;
+    }
+    #endif
+
     //Check if we should send data to our node agent.
-    if (fabs(oldTemp-tempDelta) > TEMPERATURE_SWING || fabs(oldPower-power) > POWER_SWING)
+    //Note: push reports on swings, pull only when asked and hybrid on large swings too.
+    bool swing = blockSwing(tempDelta, power);
+    bool report = (node.telemetryMode == SA_ATR_TELEMETRY_MODE_PUSH) ? swing :
+                  node.telemetryRequested || (node.telemetryMode == SA_ATR_TELEMETRY_MODE_HYBRID && swing);
+    node.telemetryRequested = false;
+    if (report)
     {
-        oldTemp  = tempDelta;
-        oldPower = power;
+        node.reportedTemp  = tempDelta;
+        node.reportedPower = power;
         //Transfer our temperature and power.
         {
-            saMetadata msg = SA_BLK_INFO_METADATA_INITIALIZER;
+            saBlkInfoMetadata msg = SA_BLK_INFO_METADATA_INITIALIZER;
 
             //Note: 'real' temperatures above the maximum operating temp are
             // rounded down for sharing purposes with other CEs. This shouldn't
@@ -1179,14 +1486,159 @@ auto inline blockRole() -> void
                 tempDelta = 0; //a delta of zero is the maximum temperature.
 
             //Push temperature and power to next level CE (packing is transparently done in the API).
-            saSetMetadata(&msg, SA_ATR_FUB_TEMP_SCORE, &tempDelta);
-            saSetMetadata(&msg, SA_ATR_FUB_POW_SCORE, &power);
-            node.push(msg);
+            sa::set<SA_ATR_FUB_TEMP_SCORE>(msg, tempDelta);
+            sa::set<SA_ATR_FUB_POW_SCORE>(msg, power);
+            node.push(sa::generic(msg));
         }
     }
 
     //flush messages
-    node.flush();
+    {
+        PROBE(PROBE_FLUSH);
+        node.flush();
+    }
+
+    #if ROLE_TIMER_WHEEL == 1
+    scheduleBlockRole();
+    #endif
+}
+
+#if ROLE_TIMER_WHEEL == 1
+/* Whether the block sensors call for the block role: an emergency to raise or clear, or a swing to report. */
+auto inline blockSensorEvent() -> bool
+{
+    auto& node = leafNodeState;
+    FLOAT_TYPE tempDelta = readTemperatureMSR();
+    FLOAT_TYPE temperature = TEMPERATURE_JUNCTION - tempDelta;
+    #if THERMAL_EMERGENCY == 1
+    if (node.emergency ? temperature < TEMPERATURE_EMERGENCY - TEMPERATURE_EMERGENCY_HYSTERESIS : temperature >= TEMPERATURE_EMERGENCY)
+        return true;
+    #endif
+    return node.telemetryMode != SA_ATR_TELEMETRY_MODE_PULL && blockSwing(tempDelta, readPowerMSR());
+}
+
+/* Roles of the agent to run this clock tick -- timers due, mail waiting or block sensor events. */
+//Note: the doorbell is cleared before the roles drain their mailboxes.
+auto inline roleActivations() -> u64
+{
+    if (agent.done == true)
+        return 0;
+    u64 active = roleTimers.advance(readClockMSR());
+    auto& doorbell = agent.mailbox->doorbell;
+    if (doorbell.load(std::memory_order_relaxed) != 0)
+        active |= doorbell.exchange(0, std::memory_order_acquire);
+    if (blockSensorEvent())
+        active |= 1UL << ROLE_STATE_BLOCK;
+    for (u64 bits = active; bits != 0; bits &= bits - 1)
+        agent.statistics.roleActivations[__builtin_ctzl(bits)]++;
+    return active;
+}
+#endif
+
+/* Runs the roles of the agent for this clock tick. */
+auto inline runRoles() -> void
+{
+    #if ROLE_TIMER_WHEEL == 1
+    ///Roles with something to do this cycle.
+    u64 active = roleActivations();
+    #else
+    u64 active = ~0UL;
+    #endif
+
+    //...................................................................../
+    // Do tasks for chip role -- if this agent has a chip role ............/
+    if (active & (1UL << ROLE_STATE_CHIP))
+    {
+        PROBE(PROBE_ROLE_CHIP);
+        chipRole();
+    }
+
+    //...................................................................../
+    // Do tasks for unit role -- if this agent has a unit role ............/
+    if (active & (1UL << ROLE_STATE_UNIT))
+    {
+        PROBE(PROBE_ROLE_UNIT);
+        unitRole();
+    }
+
+    //...................................................................../
+    // Do tasks for block role -- if this agent has a block role ........../
+    if (active & (1UL << ROLE_STATE_BLOCK))
+    {
+        PROBE(PROBE_ROLE_BLOCK);
+        blockRole();
+    }
+}
+
+/* Runs the work of the agent for this clock tick. */
+auto inline runWork() -> void
+{
+    PROBE(PROBE_EXECUTE);
+    ExecuteWork();
+}
+
+/* Runs only the work of the calling thread for the given clock ticks (safe-bench). */
+//Note: the DRAM ports of its unit are all free at the start.
+auto executeWorkTicks(u64 ticks) -> void
+{
+    dram_ports[agent.uid].count = DRAM_PORTS;
+    for (u64 tick=0; tick<ticks; tick++, updateClockMSR())
+        ExecuteWork();
+}
+
+#if LOGGING_LEVEL == 1
+/* Writes out the temperature and power of the block to the log file. */
+auto inline logTick() -> void
+{
+    if (agent.done == true)
+        return;
+    TRACE_SCOPE("log", 0);
+    logEvent(LOG_TEMPERATURE, agent.exchange->temperature);
+    logEvent(LOG_POWER, readPowerMSR());
+}
+#endif
+
+/* Publishes the progress, the block temperatures and powers and the root aggregates (ss-live.h). */
+//Note: the blocks are read while they run, as the stdout printout used to.
+auto inline publishLive(bool done) -> void
+{
+    LiveRegion* live = liveWriteBegin();
+    LiveState& state = live->state;
+    double* temperature = live->temperature();
+    double* power = live->power();
+    state.tasksLeft = 0;
+    state.temperatureAvg = 0;
+    state.temperatureMin = INFINITY;
+    state.temperatureMax = -INFINITY;
+    //Note: the energies are summed as ENERGY_TYPE and converted once (exact in fixed point).
+    ENERGY_TYPE chipEnergy = 0, unitEnergy = 0;
+    for (u64 i = 0 ; i < N_UNITS_IN_CHIP*N_BLOCKS_IN_UNIT ; i++)
+    {
+        for (u64 j = 0 ; j < N_CORES_IN_BLOCK ; j++)
+            state.tasksLeft += agentMap[i]->xe[j].taskQueue.size() - agentMap[i]->xe[j].taskCounter;
+        temperature[i] = agentMap[i]->exchange->temperature;
+        ENERGY_TYPE energy = agentMap[i]->accumulatedEnergy;
+        power[i] = ENERGY_TO_PJ(energy)*(MAX_XE_CLOCK_SPEED_MHZ*1E-6/ROLLING_ENERGY_WINDOW/INST_PER_MEGA_INST);
+        chipEnergy += energy;
+        if (i < N_BLOCKS_IN_UNIT)
+            unitEnergy += energy;
+        state.temperatureAvg += temperature[i];
+        state.temperatureMin = std::min(state.temperatureMin, temperature[i]);
+        state.temperatureMax = std::max(state.temperatureMax, temperature[i]);
+    }
+    state.temperatureAvg /= N_UNITS_IN_CHIP*N_BLOCKS_IN_UNIT;
+    state.chipPower = ENERGY_TO_PJ(chipEnergy)*(MAX_XE_CLOCK_SPEED_MHZ*1E-6/ROLLING_ENERGY_WINDOW/INST_PER_MEGA_INST);
+    state.unitPower = ENERGY_TO_PJ(unitEnergy)*(MAX_XE_CLOCK_SPEED_MHZ*1E-6/ROLLING_ENERGY_WINDOW/INST_PER_MEGA_INST);
+    state.cycle = readClockMSR()*INST_PER_MEGA_INST;
+    state.simulatedMs = (FLOAT_TYPE)readClockMSR()*INST_PER_MEGA_INST/((FLOAT_TYPE)MAX_XE_CLOCK_SPEED_MHZ*1000);
+    state.done = done;
+    state.chipTemperature = TEMPERATURE_OPERATION-rootNodeState.temperatureAvg;
+    state.chipPowerAggregate = rootNodeState.powerTotal;
+    state.chipPowerGoal = rootNodeState.powerGoal;
+    state.unitPowerAggregate = branchNodeState.powerTotal;
+    state.unitPowerGoal = branchNodeState.powerGoal;
+    state.blockPowerGoal = leafNodeState.powerGoal;
+    liveWriteEnd();
 }
 
 auto verifyAggregateData() -> void
@@ -1196,7 +1648,7 @@ auto verifyAggregateData() -> void
 
     FLOAT_TYPE temperatureMap[N_BLOCKS_IN_UNIT*N_UNITS_IN_CHIP];
     for (u64 tid=0; tid<N_BLOCKS_IN_UNIT*N_UNITS_IN_CHIP; tid++)
-        temperatureMap[tid] = agentMap[tid]->temperature;
+        temperatureMap[tid] = agentMap[tid]->exchange->temperature;
     FLOAT_TYPE avg  = computeAverage(temperatureMap, N_BLOCKS_IN_UNIT*N_UNITS_IN_CHIP);
     FLOAT_TYPE var  = computeVariance(temperatureMap, avg, N_BLOCKS_IN_UNIT*N_UNITS_IN_CHIP);
 
@@ -1221,62 +1673,19 @@ auto verifyAggregateData() -> void
 
 }
 
-/* Fancy regular barrier for C++11 */
-auto inline barrier(u64 count) -> void
-{
-    /* Timing Related.........................................................*/
-    {
-    #if EXECUTION_TIMES == 2 || EXECUTION_TIMES == 3
-       if (agent.id==0)
-       start=std::chrono::high_resolution_clock::now();
-    #endif
-    }
-    /*........................................................................*/
-
-    static u64 checkedInCount = 0;          // Count of threads having reached the barrier.
-    static u64 eventCount = 0;              // Event count of barriers reached.
-    static std::condition_variable condVar; // Conditional wait variable.
-    static std::mutex mutex;                // Mutual exclusion variable.
+/* Barriers of the engine -- let go once every agent is done. */
+static Barrier centralBarrier;
+static TreeBarrier<BARRIER_COUNT> treeBarrier;
 
-    /**************************************************************************/
-    std::unique_lock<std::mutex> lock(mutex); //unlocks when destructed.
-    checkedInCount++; //increment count of threads checked in.
-
-    // Check if count has been reached.
-    if (checkedInCount < count && done != N_BLOCKS_IN_UNIT*N_UNITS_IN_CHIP)
-    {
-        // Count hasn't been reached -- so we need to wait.
-
-        // establish a predicate to check to for to continue. Namely that the
-        // even count changes. We need different predicates each iteration to
-        // avoid race defects.
-        u64 predicate = eventCount;
-        do
-            condVar.wait(lock);
-        while(predicate == eventCount && done != N_BLOCKS_IN_UNIT*N_UNITS_IN_CHIP && done != N_BLOCKS_IN_UNIT*N_UNITS_IN_CHIP); // avoid spurious wakeup rechecking and locking.
-    }
-    else
-    {
-        // Count reached -- so we need to signal everyone.
-
-        eventCount++; // increment the event count.
-        checkedInCount = 0; //reset the count of checked in threads.
-        condVar.notify_all(); //notify everyone.
-    }
-    /**************************************************************************/
-
-    /* Timing Related.........................................................*/
-    {
-        #if EXECUTION_TIMES == 2 || EXECUTION_TIMES == 3
-        if (agent.id==0)
-        {
-            stop=std::chrono::high_resolution_clock::now();
+auto inline allDone() -> bool
+{
+    return done == N_BLOCKS_IN_UNIT*N_UNITS_IN_CHIP;
+}
 
-            times.barriers+=(std::chrono::duration_cast< std::chrono::duration< double > > (stop-start)).count();
-        }
-        #endif
-    }
-    /*........................................................................*/
+auto inline barrier(u64 count) -> void
+{
+    TRACE_SCOPE("barrier", count);
+    centralBarrier.wait(count, allDone);
 }
 
 /* Fancy Atomic based barrier */
@@ -1334,67 +1743,151 @@ auto inline barrier(u64 count) -> void
 ///    /*........................................................................*/
 ///}
 
-static u64 checkedInCount[BARRIER_COUNT] = {0};          // Count of threads having reached the barrier.
-static u64 eventCount[BARRIER_COUNT] = {0};              // Event count of barriers reached.
-static std::condition_variable condVar[BARRIER_COUNT];   // Conditional wait variable.
-static std::mutex mutex[BARRIER_COUNT];                  // Mutual exclusion variable.
-
-/* Fancy 2 level tree barrier for C++11 */
 auto inline tree_barrier() -> void
 {
-    /* Timing Related.........................................................*/
-    {
-    #if EXECUTION_TIMES == 2 || EXECUTION_TIMES == 3
-       if (agent.id==0)
-       start=std::chrono::high_resolution_clock::now();
+    TRACE_SCOPE("tree barrier", agent.id%BARRIER_COUNT);
+    treeBarrier.wait(agent.id, N_BLOCKS_IN_UNIT*N_UNITS_IN_CHIP, allDone);
+}
+
+#if SYNC_MODE == 1
+/* Publishes the clock of the agent and returns the first tick it may not run yet. */
+//Note: waits (yielding) until the slowest peer is less than the lookahead
+//      behind. The agent with the lowest published clock never waits, so the
+//      simulation always advances.
+auto inline syncHorizon() -> u64
+{
+    u64 clock = readClockMSR();
+    agent.exchange->watermark.store(clock, std::memory_order_release);
+    #if SYNC_QUANTUM_ADAPTIVE == 1
+    u64 lookahead = syncQuantum.load(std::memory_order_relaxed);
+    #else
+    u64 lookahead = SYNC_LOOKAHEAD;
+    #endif
+    #if PROBES == 1
+    u64 waitStart = 0;
     #endif
+    for (u64 yields = 0; ; yields++)
+    {
+        u64 slowest = maxTimeTick();
+        for (u64 i=0; i<syncPeers.count; i++)
+            slowest = std::min(slowest, syncPeers.peer[i]->watermark.load(std::memory_order_acquire));
+        if (slowest + lookahead > clock)
+        {
+            if (yields != 0)
+            {
+                agent.statistics.syncWaits++;
+                agent.statistics.syncYields += yields;
+                #if PROBES == 1
+                probeRecord(PROBE_BARRIER, waitStart);
+                #endif
+                TRACE_SPAN_END();
+            }
+            return slowest + lookahead;
+        }
+        #if PROBES == 1
+        if (yields == 0)
+            waitStart = probeNow();
+        #endif
+        if (yields == 0)
+            TRACE_SPAN_BEGIN("sync wait", slowest);
+        std::this_thread::yield();
     }
-    /*........................................................................*/
+}
+#endif
 
-    /**************************************************************************/
+/* Synchronization at the epoch boundaries -- in SYNC_MODE 1 agents only wait for their peers. */
+auto inline epochBarrier() -> void
+{
+    #if SYNC_MODE == 0
+    PROBE_ALWAYS(PROBE_BARRIER);
+    #if TREE_BARRIERS == 1
+    tree_barrier(); // Only barrier at sync interval.
+    #else
+    barrier(N_BLOCKS_IN_UNIT*N_UNITS_IN_CHIP); // Only barrier at sync interval.
+    #endif
+    #endif
+}
 
-    u64 bar_id = agent.id%BARRIER_COUNT;
+/* First tick past the epoch starting at the current tick. */
+auto inline epochEnd() -> u64
+{
+    #if SYNC_QUANTUM_ADAPTIVE == 1
+    u64 end = readClockMSR() + syncQuantum.load(std::memory_order_relaxed);
+    #else
+    u64 end = (readClockMSR()/BARRIER_INTERVALS + 1)*BARRIER_INTERVALS;
+    #endif
+    return std::min(end, maxTimeTick()+1);
+}
 
-    std::unique_lock<std::mutex> lock(mutex[bar_id]); //unlocks when destructed.
-    checkedInCount[bar_id]++; //increment count of threads checked in.
+#if SYNC_QUANTUM_ADAPTIVE == 1
+/* Range of the quanta chosen so far. */
+struct
+{
+    u64 epochs;
+    u64 shortest = SYNC_QUANTUM_MAX;
+    u64 longest  = 0;
+} quantumStats;
+
+/* Chooses the next sync quantum from the block temperatures at the epoch boundary (chip agent). */
+//Note: no block may drift more than SYNC_TEMPERATURE_ERROR within a quantum, so
+//      the neighbors it reads stay that close. The drift rate is the fastest change
+//      since the last boundary, or the conduction the steepest neighbor differences
+//      drive if larger. Quanta shrink at once but at most double per epoch.
+auto inline chooseSyncQuantum() -> void
+{
+    static FLOAT_TYPE lastTemperature[N_UNITS_IN_CHIP*N_BLOCKS_IN_UNIT];
+    static u64 lastTick = 0;
 
-    // Check if count has been reached.
-    if (checkedInCount[bar_id] < N_BLOCKS_IN_UNIT*N_UNITS_IN_CHIP/BARRIER_COUNT && done != N_BLOCKS_IN_UNIT*N_UNITS_IN_CHIP)
+    u64 tick = readClockMSR();
+    FLOAT_TYPE gradient = 0, rate = 0;
+    for (u64 i=0; i<N_UNITS_IN_CHIP*N_BLOCKS_IN_UNIT; i++)
     {
-        // Count hasn't been reached -- so we need to wait.
-
-        // establish a predicate to check to for to continue. Namely that the
-        // even count changes. We need different predicates each iteration to
-        // avoid race defects.
-        u64 predicate = eventCount[bar_id];
-        do
-            condVar[bar_id].wait(lock);
-        while(predicate == eventCount[bar_id] && done != N_BLOCKS_IN_UNIT*N_UNITS_IN_CHIP); // avoid spurious wakeup rechecking and locking.
+        FLOAT_TYPE temperature = boundaryTemperature[i].load(std::memory_order_relaxed);
+        FLOAT_TYPE difference = 0;
+        for (const AgentMap* neighbor : {agentMap[i]->topNeighbor, agentMap[i]->btmNeighbor, agentMap[i]->lftNeighbor, agentMap[i]->rhtNeighbor})
+            if (neighbor)
+                difference += fabs(temperature - boundaryTemperature[neighbor->id].load(std::memory_order_relaxed));
+        gradient = std::max(gradient, difference);
+        if (tick > lastTick)
+            rate = std::max(rate, fabs(temperature - lastTemperature[i])/(tick - lastTick));
+        lastTemperature[i] = temperature;
     }
-    else
-    {
-        // Count reached -- so we need to signal everyone.
-
-        barrier(BARRIER_COUNT);
-
-        eventCount[bar_id]++; // increment the event count.
-        checkedInCount[bar_id] = 0;   //reset the count of checked in threads.
-        condVar[bar_id].notify_all(); //notify everyone.
-    }
-    /**************************************************************************/
-
-    /* Timing Related.........................................................*/
-    {
-        #if EXECUTION_TIMES == 2 || EXECUTION_TIMES == 3
-        if (agent.id==0)
-        {
-            stop=std::chrono::high_resolution_clock::now();
+    lastTick = tick;
+    rate = std::max(rate, gradient*temperatureConductance());
+
+    u64 previous = syncQuantum.load(std::memory_order_relaxed);
+    FLOAT_TYPE bound = (rate > 0) ? SYNC_TEMPERATURE_ERROR/rate : SYNC_QUANTUM_MAX;
+    u64 quantum = (u64) std::min<FLOAT_TYPE>(bound, 2*previous);
+    quantum = std::max<u64>(SYNC_QUANTUM_MIN, std::min<u64>(SYNC_QUANTUM_MAX, quantum));
+    syncQuantum.store(quantum, std::memory_order_relaxed);
+
+    quantumStats.epochs++;
+    quantumStats.shortest = std::min(quantumStats.shortest, quantum);
+    quantumStats.longest  = std::max(quantumStats.longest, quantum);
+    #if LOGGING_LEVEL == 1
+    if (quantum != previous)
+        logEvent(LOG_SYNC_QUANTUM, quantum*INST_PER_MEGA_INST, gradient, rate*1e6/INST_PER_MEGA_INST);
+    #endif
+}
+#endif
 
-            times.barriers+=(std::chrono::duration_cast< std::chrono::duration< double > > (stop-start)).count();
-        }
-        #endif
-    }
-    /*........................................................................*/
+/* One line summary of the run for scripts (scalingBenchmark.sh). */
+//Note: startup is from main to the first tick (input, instruction table and
+//      agent initialization), run from there to the end. cpus are the host
+//      CPUs the process may run on (taskset), rss the peak resident memory.
+auto inline printSummary(u64 ticks) -> void
+{
+    auto now = std::chrono::high_resolution_clock::now();
+    double startup = std::chrono::duration_cast<std::chrono::duration<double>>(firstTickTime - programStartTime).count();
+    double run = std::chrono::duration_cast<std::chrono::duration<double>>(now - firstTickTime).count();
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    sched_getaffinity(0, sizeof(cpus), &cpus);
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    printf("SAFE_RESULT workload=%s units=%lu blocks=%lu inst_per_mega_inst=%d threads=%lu cpus=%d cycles=%lu startup_s=%.3f run_s=%.3f cycles_per_s=%.0f peak_rss_mb=%.1f\n",
+           workloadName, N_UNITS_IN_CHIP, N_BLOCKS_IN_UNIT, INST_PER_MEGA_INST, N_UNITS_IN_CHIP*N_BLOCKS_IN_UNIT, CPU_COUNT(&cpus),
+           ticks*INST_PER_MEGA_INST, startup, run, ticks*INST_PER_MEGA_INST/run, usage.ru_maxrss/1024.0);
 }
 
 /* Thread entry. Logical ID passed in. */
@@ -1405,24 +1898,30 @@ auto engine (u64 id) -> void
     /**************************************************************************/
 
     agent.id = id;                               // 1-dimensional numeric id.
+    #if PROBES == 1
+    probeRegister(id);
+    #endif
+    #if TRACE == 1
+    traceRegister(id);
+    #endif
     agentMap[id] = &agent;                       // add agent to the agentMap.
     agent.uid = id/N_BLOCKS_IN_UNIT;             // unit id.
     agent.bid = id - agent.uid*N_BLOCKS_IN_UNIT; // block id.
+    #if THREAD_PLACEMENT == 1
+    agent.domain = unitDomain(agent.uid);        // already pinned by the creator -- state below is first touched there.
+    #endif
+    agent.exchange = allocateShared<ExchangeArea>(); // state neighbors read and write.
+    agent.mailbox  = allocateShared<MailboxArea>();  // mailbox slots shared with the parents.
 
     #if LOGGING_LEVEL == 1
     //Out log for this engine (block).
-    char logfile[1024];
-    const char* SAFE_LOGS_PATH = getenv("SAFE_LOGS_PATH");
-    if (SAFE_LOGS_PATH == 0) SAFE_LOGS_PATH = "./logs";
-    sprintf (logfile, "%s/%s.log.brd00.chp00.unt%02lu.blk%02ld", SAFE_LOGS_PATH, OUT_FILE_PREFIX, agent.uid, agent.bid);
-    if((agent.logfile = fopen(logfile, "w")) == NULL)
-        fatal(logfile);
+    logRegister(agent.id);
 
     //print layout.
     if(agent.id == 0)
     {
-        fprintf(agent.logfile, "[RMD_SIMULATION_INFO] Simulated block layout: %ld by %ld.\n", chip_layout.unit_height_num_blocks, chip_layout.unit_width_num_blocks);
-        fprintf(agent.logfile, "[RMD_SIMULATION_INFO] Simulated unit layout: %ld by %ld.\n", chip_layout.chip_height_num_units, chip_layout.chip_width_num_units);
+        logEvent(LOG_BLOCK_LAYOUT, chip_layout.unit_height_num_blocks, chip_layout.unit_width_num_blocks);
+        logEvent(LOG_UNIT_LAYOUT, chip_layout.chip_height_num_units, chip_layout.chip_width_num_units);
     }
     #endif
 
@@ -1435,13 +1934,19 @@ auto engine (u64 id) -> void
     {
         done = 0; // set done variable.
         for(u64 i=0; i<N_UNITS_IN_CHIP; i++)
-            dram_ports[i] = DRAM_PORTS;
+            dram_ports[i].count = DRAM_PORTS;
         printf("==> Distributing work to nodes...\n");
-        pushWorkRoundRobin();
-        scheduleWork();
+    }
+    {
+        TRACE_SCOPE("pushWork", 0);
+        pushWork();
+    }
+    if(agent.id == 0)
         printf("==> Initializing node state...\n");
+    {
+        TRACE_SCOPE("initializeAgent", 0);
+        initializeAgent(); //initialize agent variables.
     }
-    initializeAgent(); //initialize agent variables.
 
     /**************************************************************************/
     barrier(N_BLOCKS_IN_UNIT*N_UNITS_IN_CHIP);
@@ -1455,8 +1960,14 @@ auto engine (u64 id) -> void
 
         if(agent.id == 0)
         {
+            taskPool.clear(); // every agent has its share.
+            taskPool.shrink_to_fit();
+            #if THREAD_PLACEMENT == 1
+            reportPlacement();
+            #endif
             printf("==> Running simulation with: %ld tasks...\n", tasksLeft);
             printf("---------------------------\n");
+            firstTickTime = std::chrono::high_resolution_clock::now();
         }
     }
 
@@ -1464,216 +1975,171 @@ auto engine (u64 id) -> void
     barrier(N_BLOCKS_IN_UNIT*N_UNITS_IN_CHIP);
     /**************************************************************************/
 
+    //Epochs of BARRIER_INTERVALS ticks (the sync quantum when adaptive): one synchronized tick at the boundary,
+    //then roles and work only. Logging splits the epoch in runs of plain ticks
+    //and all the agents stop at the same (precomputed) tick.
+    #if LOGGING_LEVEL == 1
+    const u64 logStep = ticksPerPeriod(LOGGING_INTERVAL);
+    #endif
+    #if LIVE == 0 && LIVE_PRINT == 0
+    u64 nextProgress = 0;
+    #endif
     while (true)
     {
-        /* Timing Related.....................................................*/
-        {
+        /* Epoch boundary tick................................................*/
+        TRACE_SPAN_BEGIN("epoch boundary", 0);
+        #if SYNC_MODE == 1
+        syncHorizon(); // the boundary tick stays within the lookahead too.
+        #endif
+        runRoles();
+        #if SYNC_QUANTUM_ADAPTIVE == 1
+        boundaryTemperature[agent.id].store(agent.exchange->temperature, std::memory_order_relaxed);
+        #endif
 
-            #if EXECUTION_TIMES == 2 || EXECUTION_TIMES == 3
-            if (agent.id==0)
-                start=std::chrono::high_resolution_clock::now();
-            #endif
+        /******************************************************************/
+        epochBarrier();
+        /******************************************************************/
 
-            #if EXECUTION_TIMES == 3
-            if (agent.id==0)
-                start2=std::chrono::high_resolution_clock::now();
-            #endif
+        #if SYNC_QUANTUM_ADAPTIVE == 1
+        if (agent.id == 0)
+        {
+            TRACE_SCOPE("chooseSyncQuantum", 0);
+            chooseSyncQuantum();
         }
-        /*....................................................................*/
+        #endif
+        #if LOGGING_LEVEL == 1
+        if (readClockMSR() % logStep == 0)
+            logTick();
+        #endif
 
-        //...................................................................../
-        // Do tasks for chip role -- if this agent has a chip role ............/
-        chipRole();
-        //...................................................................../
+        //Note: this needs to be done in lock step with pushing of work because
+        //      our queues are not thread safe.
+        ///Schedule work for this cycle.
+        runWork();
 
-        /* Timing Related.....................................................*/
-        {
-            #if EXECUTION_TIMES == 3
-            if (agent.id==0)
-            {
-                stop2=std::chrono::high_resolution_clock::now();
-                times.rolesChip+=(std::chrono::duration_cast< std::chrono::duration< double > > (stop2-start2)).count();
-            }
-            #endif
+        /******************************************************************/
+        epochBarrier();
+        /******************************************************************/
 
-            #if EXECUTION_TIMES == 3
-            if (agent.id==0)
-                start2=std::chrono::high_resolution_clock::now();
-            #endif
+        #if LIVE == 1 || LIVE_PRINT == 1
+        ///Publish the progress of the simulation at every epoch boundary.
+        if(agent.id == 0) //only the first guy.
+        {
+            TRACE_SCOPE("live publish", 0);
+            publishLive(false);
         }
-        /*....................................................................*/
-
-        //...................................................................../
-        // Do tasks for unit role -- if this agent has a unit role ............/
-        unitRole();
-        //...................................................................../
-
-        /* Timing Related.....................................................*/
+        #else
+        ///Print the progress of the simulation every BARRIER_INTERVALS.
+        if(agent.id == 0 && readClockMSR() >= nextProgress) //only the first guy.
         {
-            #if EXECUTION_TIMES == 3
-            if (agent.id==0)
-            {
-                stop2=std::chrono::high_resolution_clock::now();
-                times.rolesUnit+=(std::chrono::duration_cast< std::chrono::duration< double > > (stop2-start2)).count();
-            }
-            #endif
-
-            #if EXECUTION_TIMES == 3
-            if (agent.id==0)
-                start2=std::chrono::high_resolution_clock::now();
-            #endif
+            TRACE_SCOPE("progress printout", 0);
+            nextProgress = (readClockMSR()/BARRIER_INTERVALS + 1)*BARRIER_INTERVALS;
+            publishLive(false);
+            liveProgress();
         }
-        /*....................................................................*/
+        #endif
 
-        //...................................................................../
-        // Do tasks for block role -- if this agent has a block role ........../
-        blockRole();
-        //...................................................................../
+        updateClockMSR(); //Update clock.
+        TRACE_SPAN_END();
 
-        /* Timing Related.....................................................*/
+        /* Epoch body.........................................................*/
+        u64 end = epochEnd();
+        TRACE_SPAN_BEGIN("epoch", end - readClockMSR());
+        #if LOGGING_LEVEL == 1
+        u64 nextLog = (readClockMSR() + logStep - 1)/logStep*logStep;
+        #endif
+        #if PROBES == 1
+        u64 nextSample = (readClockMSR()/PROBE_SAMPLE + 1)*PROBE_SAMPLE;
+        #endif
+        while (readClockMSR() < end)
         {
-            #if EXECUTION_TIMES == 3
-            if (agent.id==0)
+            u64 stop = end;
+            #if SYNC_MODE == 1
+            u64 horizon = syncHorizon();
+            stop = std::min(stop, horizon);
+            #endif
+            #if LOGGING_LEVEL == 1
+            stop = std::min(stop, nextLog);
+            #endif
+            #if PROBES == 1
+            stop = std::min(stop, nextSample);
+            #endif
+            for (; readClockMSR() < stop; updateClockMSR())
             {
-                stop2=std::chrono::high_resolution_clock::now();
-                times.rolesBlock+=(std::chrono::duration_cast< std::chrono::duration< double > > (stop2-start2)).count();
+                runRoles();
+                runWork();
             }
+            if (readClockMSR() == end)
+                break;
+            #if SYNC_MODE == 1
+            if (readClockMSR() == horizon)
+                continue;
             #endif
 
-            #if EXECUTION_TIMES == 2 || EXECUTION_TIMES == 3
-            if (agent.id==0)
+            //Logged or timed tick.
+            #if LOGGING_LEVEL == 1
+            if (readClockMSR() == nextLog)
             {
-                stop=std::chrono::high_resolution_clock::now();
-                times.roles+=(std::chrono::duration_cast< std::chrono::duration< double > > (stop-start)).count();
+                logTick();
+                nextLog += logStep;
             }
             #endif
-        }
-        /*....................................................................*/
-
-        if (readClockMSR() % BARRIER_INTERVALS == 0)
-        {
-            /******************************************************************/
-            #if TREE_BARRIERS == 1
-            tree_barrier(); // Only barrier at sync interval.
-            #else
-            barrier(N_BLOCKS_IN_UNIT*N_UNITS_IN_CHIP); // Only barrier at sync interval.
-            #endif
-            /******************************************************************/
-        }
-
-        #if LOGGING_LEVEL == 1
-        ///Write out to log file.
-        if((readClockMSR()*INST_PER_MEGA_INST) % LOGGING_INTERVAL == 0 && agent.done == false)
-        {
-            fprintf(agent.logfile, "[RMD_TRACE_TEMPERATURE] Temperature of %fC at cycle %ld.\n", agent.temperature, readClockMSR()*INST_PER_MEGA_INST);
-            fprintf(agent.logfile, "[RMD_TRACE_POWER] Power of %fW at cycle %ld.\n", readPowerMSR(), readClockMSR()*INST_PER_MEGA_INST);
-        }
-        #endif
-
-        /* Timing Related.....................................................*/
-        {
-            #if EXECUTION_TIMES == 2 || EXECUTION_TIMES == 3
-            if (agent.id==0)
-                start=std::chrono::high_resolution_clock::now();
-            #endif
-        }
-        /*....................................................................*/
-
-        //Note: this needs to be done in lock step with pushing of work because
-        //      our queues are not thread safe.
-        ///Schedule work for this cycle.
-        ExecuteWork();
-
-        /* Timing Related.....................................................*/
-        {
-            #if EXECUTION_TIMES == 2 || EXECUTION_TIMES == 3
-            if (agent.id==0)
+            #if PROBES == 1
+            if (readClockMSR() == nextSample)
             {
-                stop=std::chrono::high_resolution_clock::now();
-                times.simulation+=(std::chrono::duration_cast< std::chrono::duration< double > > (stop-start)).count();
+                probeTable->sampling = true;
+                runRoles();
+                runWork();
+                probeTable->sampling = false;
+                probeTable->sampledTicks++;
+                nextSample += PROBE_SAMPLE;
+                updateClockMSR();
+                continue;
             }
             #endif
+            runRoles();
+            runWork();
+            updateClockMSR();
         }
-        /*....................................................................*/
+        TRACE_SPAN_END();
 
-        if (readClockMSR() % BARRIER_INTERVALS == 0)
+        //Check if simulation is done -- every agent finished at the same tick.
+        if (agent.done)
         {
-            /******************************************************************/
-            #if TREE_BARRIERS == 1
-            tree_barrier(); // Only barrier at sync interval.
-            #else
-            barrier(N_BLOCKS_IN_UNIT*N_UNITS_IN_CHIP); // Only barrier at sync interval.
+            #if SYNC_MODE == 1
+            agent.exchange->watermark.store(readClockMSR(), std::memory_order_release); // lets the peers still running reach the last tick.
             #endif
-            /******************************************************************/
-        }
-
-        /* Timing Related.....................................................*/
-        {
-            #if EXECUTION_TIMES == 2 || EXECUTION_TIMES == 3
-                if (agent.id==0)
-                    start=std::chrono::high_resolution_clock::now();
-            #endif
-        }
-        /*....................................................................*/
-
-        ///Push some work (in the form of 8 tasks) to an 'elected' block.
-        if(agent.id == 0) //only the first guy.
-        {
-            if (readClockMSR() % BARRIER_INTERVALS == 0)
             {
-                //system("clear");
-                u64 tasksLeft = 0;
-                double power = 0.0;
-                for(u64 i = 0 ; i < N_UNITS_IN_CHIP*N_BLOCKS_IN_UNIT ; i++)
-                {
-                    power += agentMap[i]->accumulatedEnergy;
-                    for(u64 j = 0 ; j < N_CORES_IN_BLOCK ; j++)
-                        tasksLeft += agentMap[i]->xe[j].taskQueue.size() - agentMap[i]->xe[j].taskCounter;
-                }
-                power=power*(MAX_XE_CLOCK_SPEED_MHZ*1E-6/ROLLING_ENERGY_WINDOW/INST_PER_MEGA_INST);
-                printf("tasks left to execute:   %ld (temperature: %f C)...\n", tasksLeft, TEMPERATURE_OPERATION-rootNodeState.temperatureAvg);
-                printf("current simulation time: %f ms...\n", (FLOAT_TYPE)readClockMSR()*INST_PER_MEGA_INST/((FLOAT_TYPE)MAX_XE_CLOCK_SPEED_MHZ*1000));
-                printf("cycle count:             %ld\n", readClockMSR()*INST_PER_MEGA_INST);
-                printf("total power (agg : real): %fW : %fW < %fW\n", rootNodeState.powerTotal, power, rootNodeState.powerGoal);
-                power = 0.0;
-                for(u64 i=0; i<N_BLOCKS_IN_UNIT; i++)
-                    power+=agentMap[i]->accumulatedEnergy;
-                power=power*(MAX_XE_CLOCK_SPEED_MHZ*1E-6/ROLLING_ENERGY_WINDOW/INST_PER_MEGA_INST);
-                printf("unit 0 power (agg : real): %fW : %fW < goal: %fW\n", branchNodeState.powerTotal, power, branchNodeState.powerGoal);
-                printf("blk 0 power (real): %fW < goal: %fW\n", readPowerMSR(), leafNodeState.powerGoal);
-                printf("---------------------------\n");
-                printf("  -----------------------------------------------------------------------------------------------------\n");
-                for(AgentMap* down = &agent; down != NULL; down = down->btmNeighbor)
-                {
-                    printf(" | ");
-                    for(AgentMap* right = down; right->rhtNeighbor; right = right->rhtNeighbor)
-                    {
-                        printf("%05.1f ",  right->temperature);
-                        if (right->uid != right->rhtNeighbor->uid)
-                            printf(" | ");
-                    }
-                    printf(" | \n");
-                    if(!down->btmNeighbor || down->uid != down->btmNeighbor->uid)
-                        printf("  -----------------------------------------------------------------------------------------------------\n");
-                }
-                fflush(stdout);
+                PROBE_ALWAYS(PROBE_BARRIER);
+                TRACE_SCOPE("wait for done", 0);
+                while (done != N_BLOCKS_IN_UNIT*N_UNITS_IN_CHIP)
+                    std::this_thread::yield();
+
+                /**************************************************************/
+                #if TREE_BARRIERS == 1
+                tree_barrier(); // Only barrier at sync interval.
+                #else
+                barrier(N_BLOCKS_IN_UNIT*N_UNITS_IN_CHIP); // Only barrier at sync interval.
+                #endif
+                /**************************************************************/
             }
-        }
-
-        updateClockMSR(); //Update clock.
 
-        //Check if simulation is done.
-        if(done == N_BLOCKS_IN_UNIT*N_UNITS_IN_CHIP)
-        {
-            /******************************************************************/
-            #if TREE_BARRIERS == 1
-            tree_barrier(); // Only barrier at sync interval.
-            #else
-            barrier(N_BLOCKS_IN_UNIT*N_UNITS_IN_CHIP); // Only barrier at sync interval.
+            //The scope above records (probe and trace end) after the barrier, so
+            //agent 0 reads the per-thread tables and drains the trace and log
+            //buffers only once every engine is past it.
+            #if PROBES == 1
+            probeUnregister();
+            #endif
+            #if LOGGING_LEVEL == 1
+            logClose();
             #endif
-            /******************************************************************/
+            retired.fetch_add(1, std::memory_order_release);
             if (agent.id == 0)
             {
+                while (retired.load(std::memory_order_acquire) != N_BLOCKS_IN_UNIT*N_UNITS_IN_CHIP)
+                    std::this_thread::yield();
+                publishLive(true);
+                liveStop();
                 printf("---------------------------\n");
                 printf("==> Verifying aggregated information...\n");
                 verifyAggregateData();
@@ -1688,24 +2154,102 @@ auto engine (u64 id) -> void
                 printf("  * Executed %ld tasks\n", tasksExecuted);
                 printf("  * Executed %ld instructions\n", instsExecuted*INST_PER_MEGA_INST);
                 printf("  * Executed %ld cycles\n", readClockMSR()*INST_PER_MEGA_INST);
+                u64 messagesSent = 0, messagesCoalesced = 0, messagesDropped = 0;
+                for (u64 i=0; i<N_BLOCKS_IN_UNIT*N_UNITS_IN_CHIP; i++)
+                {
+                    messagesSent      += agentMap[i]->statistics.messagesSent;
+                    messagesCoalesced += agentMap[i]->statistics.messagesCoalesced;
+                    messagesDropped   += agentMap[i]->statistics.messagesDropped;
+                }
+                printf("  * SA messages: %ld sent, %ld coalesced, %ld dropped\n", messagesSent, messagesCoalesced, messagesDropped);
+                printf("  * SA messages by type (telemetry mode %d):", TELEMETRY_MODE);
+                const char* typeNames[SA_METADATA_TYPE_LAST] = {"NONE", "EDT_INFO", "BLK_INFO", "AGG_INFO", "CAP_INFO", "ERR_INFO", "BLK_CTRL", "INF_CTRL"};
+                for (u64 type=SA_METADATA_TYPE_EDT_INFO; type<SA_METADATA_TYPE_LAST; type++)
+                {
+                    u64 count = 0;
+                    for (u64 i=0; i<N_BLOCKS_IN_UNIT*N_UNITS_IN_CHIP; i++)
+                        count += agentMap[i]->statistics.messagesByType[type];
+                    if (count != 0)
+                        printf(" %s %ld", typeNames[type], count);
+                }
+                printf("\n");
+                #if TELEMETRY_MODE == 3
+                u64 unitModes[SA_ATR_TELEMETRY_MODE_HYBRID+1] = {0};
+                for (u64 i=0; i<N_UNITS_IN_CHIP; i++)
+                    unitModes[rootNodeState.telemetryMode[i]]++;
+                printf("  * Unit telemetry modes at the end: push %ld, pull %ld, hybrid %ld\n", unitModes[SA_ATR_TELEMETRY_MODE_PUSH],
+                       unitModes[SA_ATR_TELEMETRY_MODE_PULL], unitModes[SA_ATR_TELEMETRY_MODE_HYBRID]);
+                #endif
+                #if THERMAL_EMERGENCY == 1
+                u64 messagesUrgent = 0, emergencies = 0, emergencyLatencyTotal = 0, emergencyLatencyMax = 0;
+                for (u64 i=0; i<N_BLOCKS_IN_UNIT*N_UNITS_IN_CHIP; i++)
+                {
+                    messagesUrgent        += agentMap[i]->statistics.messagesUrgent;
+                    emergencies           += agentMap[i]->statistics.emergencies;
+                    emergencyLatencyTotal += agentMap[i]->statistics.emergencyLatencyTotal;
+                    emergencyLatencyMax    = std::max(emergencyLatencyMax, agentMap[i]->statistics.emergencyLatencyMax);
+                }
+                printf("  * Urgent messages: %ld, thermal emergencies answered: %ld", messagesUrgent, emergencies);
+                if (emergencies != 0)
+                    printf(" (latency avg %ld, max %ld cycles)", emergencyLatencyTotal*INST_PER_MEGA_INST/emergencies, emergencyLatencyMax*INST_PER_MEGA_INST);
+                printf("\n");
+                #endif
+                u64 aggregations[ROLE_STATE_CHIP+1] = {0}, aggregationsSkipped[ROLE_STATE_CHIP+1] = {0};
+                for (u64 i=0; i<N_BLOCKS_IN_UNIT*N_UNITS_IN_CHIP; i++)
+                    for (u64 role=ROLE_STATE_UNIT; role<=ROLE_STATE_CHIP; role++)
+                    {
+                        aggregations[role]        += agentMap[i]->statistics.aggregations[role];
+                        aggregationsSkipped[role] += agentMap[i]->statistics.aggregationsSkipped[role];
+                    }
+                printf("  * Aggregations with new inputs: unit %ld of %ld (%.1f%% skipped), chip %ld of %ld (%.1f%% skipped)\n",
+                       aggregations[ROLE_STATE_UNIT], aggregations[ROLE_STATE_UNIT]+aggregationsSkipped[ROLE_STATE_UNIT],
+                       100.0*aggregationsSkipped[ROLE_STATE_UNIT]/std::max<u64>(1, aggregations[ROLE_STATE_UNIT]+aggregationsSkipped[ROLE_STATE_UNIT]),
+                       aggregations[ROLE_STATE_CHIP], aggregations[ROLE_STATE_CHIP]+aggregationsSkipped[ROLE_STATE_CHIP],
+                       100.0*aggregationsSkipped[ROLE_STATE_CHIP]/std::max<u64>(1, aggregations[ROLE_STATE_CHIP]+aggregationsSkipped[ROLE_STATE_CHIP]));
+                #if ROLE_TIMER_WHEEL == 1
+                u64 activations[ROLE_STATE_CHIP+1] = {0};
+                for (u64 i=0; i<N_BLOCKS_IN_UNIT*N_UNITS_IN_CHIP; i++)
+                    for (u64 role=ROLE_STATE_BLOCK; role<=ROLE_STATE_CHIP; role++)
+                        activations[role] += agentMap[i]->statistics.roleActivations[role];
+                u64 cycles = readClockMSR();
+                printf("  * Role activations: chip %ld of %ld cycles, unit %ld of %ld, block %ld of %ld\n",
+                       activations[ROLE_STATE_CHIP], cycles, activations[ROLE_STATE_UNIT], cycles*N_UNITS_IN_CHIP,
+                       activations[ROLE_STATE_BLOCK], cycles*N_UNITS_IN_CHIP*N_BLOCKS_IN_UNIT);
+                #endif
+                #if SYNC_QUANTUM_ADAPTIVE == 1
+                printf("  * Sync quantum: %ld epochs of %ld to %ld cycles\n", quantumStats.epochs,
+                       quantumStats.shortest*INST_PER_MEGA_INST, quantumStats.longest*INST_PER_MEGA_INST);
+                #endif
+                #if SYNC_MODE == 1
+                u64 syncWaits = 0, syncYields = 0;
+                for (u64 i=0; i<N_BLOCKS_IN_UNIT*N_UNITS_IN_CHIP; i++)
+                {
+                    syncWaits  += agentMap[i]->statistics.syncWaits;
+                    syncYields += agentMap[i]->statistics.syncYields;
+                }
+                printf("  * Local synchronization: %ld waits for peers, %ld yields\n", syncWaits, syncYields);
+                #endif
+                #if THREAD_PLACEMENT == 1
+                reportCrossDomainTraffic();
+                #endif
+                arenaReport();
 
-                #if EXECUTION_TIMES == 1 || EXECUTION_TIMES == 2 || EXECUTION_TIMES == 3
+                #if EXECUTION_TIMES >= 1
                 //Stop the timer for total execution time and print result
                 auto simulationEndTime = std::chrono::high_resolution_clock::now();
                 auto duration = std::chrono::duration_cast< std::chrono::duration < double > > (simulationEndTime-simulationStartTime);
                 std::cout << "  * Real Execution Time: " << duration.count() << " seconds \n";
                 #endif
                 printf("  * Simulated chip time: %lf ms\n", (FLOAT_TYPE)readClockMSR()*INST_PER_MEGA_INST/((FLOAT_TYPE)MAX_XE_CLOCK_SPEED_MHZ*1000));
-                printf("==> Printing simulation timing statistics...\n");
-                printf("  * Work Execution Time: %lf seconds\n", times.simulation);
-                printf("  * Barriers Time:       %lf seconds\n", times.barriers);
-                #if EXECUTION_TIMES == 2 || EXECUTION_TIMES == 3
-                printf("  * Roles Time total:    %lf seconds\n", times.roles);
-                #if EXECUTION_TIMES == 3
-                printf("    * Chip role Time:    %lf seconds\n", times.rolesChip);
-                printf("    * Unit role Time:    %lf seconds\n", times.rolesUnit);
-                printf("    * Block role Time:   %lf seconds\n", times.rolesBlock);
+                #if PROBES == 1
+                probeReport(readClockMSR());
+                #endif
+                printSummary(readClockMSR());
+                #if LOGGING_LEVEL == 1
+                logStop();
                 #endif
+                #if TRACE == 1
+                traceWrite();
                 #endif
 
                 printf("---------------------------\n");
@@ -1715,10 +2259,5 @@ auto engine (u64 id) -> void
             return;
         }
     }
-
-    #if LOGGING_LEVEL == 1
-    //close log.
-    fclose(agent.logfile);
-    #endif
 }
 
@@ -40,6 +40,7 @@ extern "C" {
 }
 #include "ss-instructions.h"
 #include "sa-api.h"
+#include "ss-ring.h"
 
 /* Possible DVFS states for XEs. */
 ///FIXME: DVFS should be at block level. Clock-gate should be at XE level.
@@ -58,19 +59,61 @@ enum ROLE_STATES
     ROLE_STATE_CHIP
 };
 
+/* Agent state exchanged with the thermal neighbors every cycle. */
+//Note: every field has a different writer (the owner or one of the four
+//      neighbors) so each one lives on its own cache line.
+struct ExchangeArea
+{
+    /* Current temperature of the agent in Celsius -- written by the owner. */
+    alignas(CACHE_LINE_SIZE) FLOAT_TYPE temperature;
+
+    /* Heat pushed in by each neighbor -- written by that neighbor. */
+    alignas(CACHE_LINE_SIZE) FLOAT_TYPE top_push;
+    alignas(CACHE_LINE_SIZE) FLOAT_TYPE btm_push;
+    alignas(CACHE_LINE_SIZE) FLOAT_TYPE lft_push;
+    alignas(CACHE_LINE_SIZE) FLOAT_TYPE rht_push;
+
+    /* First clock tick the agent has not run yet -- written by the owner (SYNC_MODE 1). */
+    alignas(CACHE_LINE_SIZE) std::atomic<u64> watermark;
+};
+
+/* Mailboxes of the agent -- see the layout comment in sa-api.cpp. */
+//Note: each role talks to a different parent so each gets its own rings.
+struct MailboxArea
+{
+    struct
+    {
+        SpscRing<u64, MAILBOX_DEPTH> up;   // child to parent.
+        SpscRing<u64, MAILBOX_DEPTH> down; // parent to child.
+        SpscRing<u64, MAILBOX_DEPTH> urgentUp;   // urgent lanes -- received first.
+        SpscRing<u64, MAILBOX_DEPTH> urgentDown;
+    } role[ROLE_STATE_CHIP+1];
+
+    /* Roles of the owner with mail waiting -- rung by the senders (ROLE_TIMER_WHEEL). */
+    alignas(CACHE_LINE_SIZE) std::atomic<u64> doorbell;
+};
+
 /* Map for misc. agent related data. */
+//Note: this is the private execution state of the agent. Everything other
+//      threads touch every cycle lives in the separately allocated regions.
 extern thread_local struct AgentMap
 {
     u64 id;
     u64 bid;
     u64 uid;
 
+    /* Host domain the agent is pinned to (THREAD_PLACEMENT). */
+    u64 domain;
+
     /* Current role of the given agent - (chip/unit/block role for the CE). */
     //Note: Changes overtime.
     u64 role;
 
-    /* Current temperature of the agent in Celsius. */
-    FLOAT_TYPE temperature;
+    /* Neighbor shared thermal exchange area (allocated by the owner). */
+    ExchangeArea* exchange;
+
+    /* Mailbox area -- used for communication with the parents (allocated by the owner). */
+    MailboxArea* mailbox;
 
     /* Current state of the agent (fanned into XEs). */
     struct xe
@@ -88,25 +131,19 @@ extern thread_local struct AgentMap
 
     /* Rolling window of energies for computing power. */
     //Note: the front contains the energy of the currently executing instruction.
-    std::deque<FLOAT_TYPE> energyWindow;
-    FLOAT_TYPE accumulatedEnergy = 0.0;
-
-    /* local memory of agent -- used to communication mailboxes. */
-    u64 memory[10000];
+    ArenaDeque<ENERGY_TYPE> energyWindow;
+    ENERGY_TYPE accumulatedEnergy = 0;
 
     /* Reference to neighbors -- if the node has them. */
-    //Note: currently used for caching the neighbors temperatures.
+    //Note: only their exchange areas are touched.
     AgentMap* topNeighbor;
     AgentMap* btmNeighbor;
     AgentMap* lftNeighbor;
     AgentMap* rhtNeighbor;
 
+    /* Heat already pulled from the neighbors' pushes (private). */
     struct temp
     {
-        FLOAT_TYPE top_push;
-        FLOAT_TYPE btm_push;
-        FLOAT_TYPE lft_push;
-        FLOAT_TYPE rht_push;
         FLOAT_TYPE top_pull;
         FLOAT_TYPE btm_pull;
         FLOAT_TYPE lft_pull;
@@ -115,9 +152,7 @@ extern thread_local struct AgentMap
 
     /* Software structures for this block. */
     //queues.
-    TaskQueueType taskQueue;             // for storing tasks.
-    
-    std::deque<saMetadata> messageQueue; // for storing unsent messages.
+    ArenaDeque<saMetadata> messageQueue; // for storing unsent messages.
     
     /*variable indicating block is done*/
     bool done = false;
@@ -127,17 +162,35 @@ extern thread_local struct AgentMap
     {
         u64 tasksExecuted;
         u64 instsExecuted;
+        u64 messagesSent;      // delivered to a mailbox.
+        u64 messagesCoalesced; // replaced by a newer message before delivery.
+        u64 messagesDropped;   // no room left in the outbox.
+        u64 messagesUrgent;    // sent on the urgent lane.
+        u64 messagesByType[SA_METADATA_TYPE_LAST]; // sent, per metadata type.
+        u64 emergencies;              // thermal emergencies answered by the parent.
+        u64 emergencyLatencyTotal;    // clock ticks from the emergency to the DVFS change.
+        u64 emergencyLatencyMax;
+        u64 aggregations[ROLE_STATE_CHIP+1];        // unit/chip role cycles that recomputed their aggregates.
+        u64 aggregationsSkipped[ROLE_STATE_CHIP+1]; // unit/chip role cycles without new inputs.
+        u64 roleActivations[ROLE_STATE_CHIP+1];     // cycles a role ran (ROLE_TIMER_WHEEL).
+        u64 syncWaits;                              // times the agent got ahead of its peers (SYNC_MODE 1).
+        u64 syncYields;                             // yields spent waiting for them.
+        u64 exchangeReads;                          // neighbor exchange areas read by the thermal model (THREAD_PLACEMENT).
+        u64 exchangeReadsCrossDomain;               // of those, on another host domain.
+        u64 exchangePushes;                         // heat pushed into a neighbor exchange area (THREAD_PLACEMENT).
+        u64 exchangePushesCrossDomain;
+        u64 messagesCrossDomain;                    // SA messages sent to an agent on another host domain (THREAD_PLACEMENT).
     } statistics;
-
-    #if LOGGING_LEVEL == 1
-    //File to log information to.
-    FILE* logfile;
-    #endif
 } agent;
 extern AgentMap* agentMap[N_UNITS_IN_CHIP*N_BLOCKS_IN_UNIT];
 
 extern std::chrono::high_resolution_clock::time_point simulationStartTime;
+extern std::chrono::high_resolution_clock::time_point programStartTime; // set first thing in main (startup time of the summary).
+extern const char* workloadName; // queue name or synthetic workload (summary).
 
 //Used in ss-main.c
 auto engine (u64 tid) -> void;
+
+//Used in ss-bench.cpp
+auto executeWorkTicks(u64 ticks) -> void;
 #endif
@@ -0,0 +1,210 @@
+/*
+ * Copyright (c) 2014, University of Delaware
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "ss-arena.h"
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <sys/mman.h>
+
+#define ARENA_MIN_CLASS   4  // smallest block is 16 bytes (holds the free list link).
+#define ARENA_CLASSES     48 // largest block is 128 TB.
+#define ARENA_CHUNK_SIZE  (64UL << 10) // carved by each thread for its small blocks (first touched by it).
+#define ARENA_HUGE_PAGE   (2UL << 20)
+#define ARENA_AGENT_CHUNKS 4 // chunks reserved per agent besides its energy window (message buffers, small queues).
+
+/* Arena shared by all threads. */
+//Note: empty until arenaReserve(). Requests it cannot serve go to the
+//      general purpose allocator.
+static struct Arena
+{
+    char* base;
+    u64   size;
+    std::atomic<u64> offset;   // bump pointer -- also the high-water mark.
+    std::atomic<u64> overflow; // bytes handed to the general purpose allocator since the arena was reserved.
+    const char* pages;         // description of the backing pages.
+} arena;
+
+/* Per-thread state -- plain data so it survives thread local destruction. */
+static thread_local void* freeLists[ARENA_CLASSES];
+static thread_local char* chunkCurrent;
+static thread_local char* chunkEnd;
+
+/* Bytes of the arena for the simulation state of a run. */
+//Note: each agent gets a full energy window (plus an eighth for the deque map
+//      and partly used blocks) and a few chunks for its other small blocks, and
+//      each queued task its ID in an XE queue, rounded up to the power of two
+//      size classes. XE queues of 2 MB or more are also aligned to 2 MB pages.
+static auto arenaSize(u64 queuedTasks) -> u64
+{
+    const u64 agents = N_UNITS_IN_CHIP*N_BLOCKS_IN_UNIT;
+    u64 windowBytes = (u64) ROLLING_ENERGY_WINDOW*sizeof(ENERGY_TYPE)*9/8;
+    u64 queueBytes = queuedTasks*TASK_MULTIPLIER*sizeof(ID_TYPE);
+    u64 size = agents*(ARENA_AGENT_CHUNKS*ARENA_CHUNK_SIZE + windowBytes) + 2*queueBytes;
+    if (2*queueBytes/(agents*N_CORES_IN_BLOCK) >= ARENA_HUGE_PAGE)
+        size += agents*N_CORES_IN_BLOCK*ARENA_HUGE_PAGE;
+    return (size + ARENA_HUGE_PAGE - 1) & ~(ARENA_HUGE_PAGE - 1);
+}
+
+auto arenaReserve(u64 queuedTasks) -> void
+{
+    u64 size = arenaSize(queuedTasks);
+    char* base = (char*) MAP_FAILED;
+    arena.pages = "4 KB pages";
+
+    #if ARENA_HUGE_PAGES == 1
+    //Explicit huge pages only succeed if the pool holds the whole arena.
+    base = (char*) mmap(NULL, size, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS|MAP_HUGETLB, -1, 0);
+    arena.pages = "2 MB pages (hugetlb)";
+    #endif
+    if (base == MAP_FAILED)
+    {
+        base = (char*) mmap(NULL, size + ARENA_HUGE_PAGE, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS|MAP_NORESERVE, -1, 0);
+        if (base == MAP_FAILED)
+        {
+            perror("arena mmap");
+            printf("WARNING: could not reserve a %lu MB arena, the simulation state comes from the general purpose allocator.\n", size >> 20);
+            return;
+        }
+        base = (char*) (((u64) base + ARENA_HUGE_PAGE - 1) & ~(ARENA_HUGE_PAGE - 1));
+        arena.pages = "4 KB pages";
+        #if ARENA_HUGE_PAGES == 1
+        //Transparent huge pages otherwise.
+        if (madvise(base, size, MADV_HUGEPAGE) == 0)
+            arena.pages = "2 MB pages (transparent)";
+        #endif
+    }
+    arena.offset = 0;
+    arena.overflow = 0;
+    arena.size = size;
+    arena.base = base;
+}
+
+/* Takes an aligned block from the shared bump pointer. Returns NULL once the arena is full. */
+static auto arenaBump(u64 bytes, u64 alignment) -> char*
+{
+    u64 offset = arena.offset.load(std::memory_order_relaxed);
+    u64 start;
+    do
+    {
+        start = (offset + alignment - 1) & ~(alignment - 1);
+        if (start + bytes > arena.size)
+            return NULL;
+    } while (!arena.offset.compare_exchange_weak(offset, start + bytes, std::memory_order_relaxed));
+    return arena.base + start;
+}
+
+/* Size class of a request -- blocks are powers of two. */
+static auto inline sizeClass(std::size_t bytes) -> u64
+{
+    u64 c = ARENA_MIN_CLASS;
+    while (((u64) 1 << c) < bytes)
+        c++;
+    return c;
+}
+
+/* Whether a block came from the arena. */
+static auto inline inArena(void* block) -> bool
+{
+    return (char*) block >= arena.base && (char*) block < arena.base + arena.size;
+}
+
+/* Block from the general purpose allocator -- before the arena is reserved or once it is full. */
+static auto fallbackAllocate(std::size_t bytes) -> void*
+{
+    if (arena.base != NULL)
+        arena.overflow.fetch_add(bytes, std::memory_order_relaxed);
+    return ::operator new(bytes);
+}
+
+auto arenaAllocate(std::size_t bytes) -> void*
+{
+    if (arena.base == NULL)
+        return fallbackAllocate(bytes);
+
+    u64 c = sizeClass(bytes);
+    if (freeLists[c] != NULL)
+    {
+        void* block = freeLists[c];
+        freeLists[c] = *(void**) block;
+        return block;
+    }
+
+    //Small blocks come from the chunk of the thread, large ones straight from the arena.
+    u64 size = (u64) 1 << c;
+    u64 alignment = size < CACHE_LINE_SIZE ? size : CACHE_LINE_SIZE;
+    if (size > ARENA_CHUNK_SIZE/4)
+    {
+        char* block = arenaBump(size, size < ARENA_HUGE_PAGE ? CACHE_LINE_SIZE : ARENA_HUGE_PAGE);
+        return block != NULL ? block : fallbackAllocate(bytes);
+    }
+
+    char* block = (char*) (((u64) chunkCurrent + alignment - 1) & ~(alignment - 1));
+    if (chunkCurrent == NULL || block + size > chunkEnd)
+    {
+        char* chunk = arenaBump(ARENA_CHUNK_SIZE, CACHE_LINE_SIZE);
+        if (chunk == NULL)
+            return fallbackAllocate(bytes);
+        chunkCurrent = chunk;
+        chunkEnd = chunkCurrent + ARENA_CHUNK_SIZE;
+        block = chunkCurrent;
+    }
+    chunkCurrent = block + size;
+    return block;
+}
+
+auto arenaDeallocate(void* block, std::size_t bytes) -> void
+{
+    if (block == NULL)
+        return;
+    if (!inArena(block))
+    {
+        ::operator delete(block);
+        return;
+    }
+    u64 c = sizeClass(bytes);
+    *(void**) block = freeLists[c];
+    freeLists[c] = block;
+}
+
+auto arenaReport() -> void
+{
+    #if ARENA_ALLOCATOR == 1
+    if (arena.base == NULL)
+        return;
+    printf("  * Arena high-water mark: %.2lf MB of %lu MB reserved (%s)",
+           (double) arena.offset.load() / (1 << 20), arena.size >> 20, arena.pages);
+    if (arena.overflow.load() != 0)
+        printf(", %.2lf MB past it from the general purpose allocator", (double) arena.overflow.load() / (1 << 20));
+    printf("\n");
+    #endif
+}
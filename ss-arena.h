@@ -0,0 +1,92 @@
+/*
+ * Copyright (c) 2014, University of Delaware
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef _SS_ARENA_GUARD_
+#define _SS_ARENA_GUARD_
+#include "ss-conf.h"
+#include <cstddef>
+#include <deque>
+#include <vector>
+#include <unordered_map>
+
+/* Per-run arena supplying every simulation lifetime structure. */
+//Note: the whole arena is reserved once (optionally on huge pages) and never
+//      returned. Freed blocks are kept in per-thread power of two free lists.
+//      Requests made before it is reserved, or that do not fit, are served by
+//      the general purpose allocator.
+auto arenaAllocate(std::size_t bytes) -> void*;
+auto arenaDeallocate(void* block, std::size_t bytes) -> void;
+
+/* Reserves the arena for the agents and a task pool of the given size (queued TASK_MULTIPLIER times) -- once the input is read. */
+auto arenaReserve(u64 queuedTasks) -> void;
+
+/* Prints the reserved size, the high-water mark and the page size used. */
+auto arenaReport() -> void;
+
+#if ARENA_ALLOCATOR == 1
+/* STL allocator on top of the arena -- stateless, all instances are equal. */
+template <class TYPE>
+struct ArenaAllocator
+{
+    typedef TYPE value_type;
+
+    ArenaAllocator() = default;
+    template <class OTHER>
+    ArenaAllocator(const ArenaAllocator<OTHER>&) {}
+
+    auto allocate(std::size_t n) -> TYPE*
+    {
+        return static_cast<TYPE*>(arenaAllocate(n*sizeof(TYPE)));
+    }
+
+    auto deallocate(TYPE* block, std::size_t n) -> void
+    {
+        arenaDeallocate(block, n*sizeof(TYPE));
+    }
+};
+
+template <class TYPE, class OTHER>
+auto inline operator==(const ArenaAllocator<TYPE>&, const ArenaAllocator<OTHER>&) -> bool { return true; }
+template <class TYPE, class OTHER>
+auto inline operator!=(const ArenaAllocator<TYPE>&, const ArenaAllocator<OTHER>&) -> bool { return false; }
+#else
+template <class TYPE>
+using ArenaAllocator = std::allocator<TYPE>;
+#endif
+
+/* Containers for simulation state. */
+template <class TYPE>
+using ArenaVector = std::vector<TYPE, ArenaAllocator<TYPE>>;
+template <class TYPE>
+using ArenaDeque = std::deque<TYPE, ArenaAllocator<TYPE>>;
+template <class KEY, class TYPE>
+using ArenaUnorderedMap = std::unordered_map<KEY, TYPE, std::hash<KEY>, std::equal_to<KEY>, ArenaAllocator<std::pair<const KEY, TYPE>>>;
+#endif
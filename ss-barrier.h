@@ -0,0 +1,131 @@
+/*
+ * Copyright (c) 2014, University of Delaware
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef _SS_BARRIER_GUARD_
+#define _SS_BARRIER_GUARD_
+#include "ss-conf.h"
+#include <condition_variable>
+#include <mutex>
+
+/* Fancy regular barrier for C++11 */
+//Note: waiting threads are also let go once released() holds (every agent done).
+class Barrier
+{
+    u64 checkedInCount = 0;          // Count of threads having reached the barrier.
+    u64 eventCount = 0;              // Event count of barriers reached.
+    std::condition_variable condVar; // Conditional wait variable.
+    std::mutex mutex;                // Mutual exclusion variable.
+
+    public:
+    template <class RELEASED>
+    auto wait(u64 count, RELEASED released) -> void
+    {
+        /**************************************************************************/
+        std::unique_lock<std::mutex> lock(mutex); //unlocks when destructed.
+        checkedInCount++; //increment count of threads checked in.
+
+        // Check if count has been reached.
+        if (checkedInCount < count && !released())
+        {
+            // Count hasn't been reached -- so we need to wait.
+
+            // establish a predicate to check to for to continue. Namely that the
+            // even count changes. We need different predicates each iteration to
+            // avoid race defects.
+            u64 predicate = eventCount;
+            do
+                condVar.wait(lock);
+            while(predicate == eventCount && !released()); // avoid spurious wakeup rechecking and locking.
+        }
+        else
+        {
+            // Count reached -- so we need to signal everyone.
+
+            eventCount++; // increment the event count.
+            checkedInCount = 0; //reset the count of checked in threads.
+            condVar.notify_all(); //notify everyone.
+        }
+        /**************************************************************************/
+    }
+};
+
+/* Fancy 2 level tree barrier for C++11 */
+//Note: threads meet in GROUPS barriers (by id) and the last of each group in a
+//      central one. count must be a multiple of GROUPS.
+template <u64 GROUPS>
+class TreeBarrier
+{
+    struct alignas(CACHE_LINE_SIZE) Group
+    {
+        u64 checkedInCount = 0;          // Count of threads having reached the barrier.
+        u64 eventCount = 0;              // Event count of barriers reached.
+        std::condition_variable condVar; // Conditional wait variable.
+        std::mutex mutex;                // Mutual exclusion variable.
+    } group[GROUPS];
+    Barrier root;
+
+    public:
+    template <class RELEASED>
+    auto wait(u64 id, u64 count, RELEASED released) -> void
+    {
+        /**************************************************************************/
+        Group& g = group[id%GROUPS];
+
+        std::unique_lock<std::mutex> lock(g.mutex); //unlocks when destructed.
+        g.checkedInCount++; //increment count of threads checked in.
+
+        // Check if count has been reached.
+        if (g.checkedInCount < count/GROUPS && !released())
+        {
+            // Count hasn't been reached -- so we need to wait.
+
+            // establish a predicate to check to for to continue. Namely that the
+            // even count changes. We need different predicates each iteration to
+            // avoid race defects.
+            u64 predicate = g.eventCount;
+            do
+                g.condVar.wait(lock);
+            while(predicate == g.eventCount && !released()); // avoid spurious wakeup rechecking and locking.
+        }
+        else
+        {
+            // Count reached -- so we need to signal everyone.
+
+            root.wait(GROUPS, released);
+
+            g.eventCount++; // increment the event count.
+            g.checkedInCount = 0;   //reset the count of checked in threads.
+            g.condVar.notify_all(); //notify everyone.
+        }
+        /**************************************************************************/
+    }
+};
+#endif
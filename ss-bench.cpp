@@ -0,0 +1,853 @@
+/*
+ * Copyright (c) 2014, University of Delaware
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* Micro-benchmarks for the simulator hot paths. Built with `make bench`. */
+//Note: not linked into the simulator's main. Uses the same headers and objects
+//      so the layouts and code measured here are the ones the engine uses.
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdarg>
+#include <new>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include "ss-agent.h"
+#include "ss-barrier.h"
+#include "ss-guidmap.h"
+#include "ss-pack.h"
+#include "ss-probe.h"
+#include "ss-series.h"
+#include "ss-temp.h"
+extern "C" {
+#include "ss-math.h"
+}
+#include "sa-api.h"
+#include "sa-fields.h"
+
+#define BENCH_ITERATIONS 20000000 // stores per thread per run.
+#define BENCH_WRITERS    4        // thermal neighbors of an agent.
+#define BENCH_EDTS       4000000  // EDTs created, looked up and destroyed per run.
+#define BENCH_THREADS    4        // threads sharing the EDT metadata table.
+#define BENCH_AGGREGATES 10000000 // aggregations of the children maps per run.
+#define BENCH_TICKS      200000   // clock ticks of one block per ExecuteWork run.
+#define BENCH_CALLS      20000000 // calls per run of the small functions (thermal model, metadata, packing, statistics, lookups).
+#define BENCH_WAITS      200000   // barrier waits per run, split across the threads.
+#define BENCH_MAX_WAITERS 1024    // largest thread count the barriers are measured at.
+#define BENCH_SAMPLES    2000     // chip rows written to and read from a series.
+
+/* Output format -- human readable by default, CSV rows with --csv. */
+static bool csv = false;
+
+/* Prints the title of a group of results (human readable output only). */
+static auto section(const char* format, ...) -> void
+{
+    if (csv)
+        return;
+    va_list args;
+    va_start(args, format);
+    vprintf(format, args);
+    va_end(args);
+}
+
+/* Reports one measurement: `ops` operations took `seconds` of wall time on `threads` threads. */
+//Note: CSV columns are benchmark,variant,threads,ns_per_op,ops_per_s,note. The
+//      note never holds a comma so every row splits the same way.
+static auto result(const char* benchmark, const char* variant, u64 threads, double seconds, u64 ops, const char* note = "") -> void
+{
+    double ns = seconds*1e9/ops;
+    double throughput = ops/seconds;
+    if (csv)
+        printf("%s,%s,%lu,%.3f,%.0f,%s\n", benchmark, variant, threads, ns, throughput, note);
+    else
+        printf("%-28s %4lu threads %10.2f ns/op %14.0f ops/s  %s\n", variant, threads, ns, throughput, note);
+}
+
+static auto seconds(std::chrono::high_resolution_clock::time_point start) -> double
+{
+    return std::chrono::duration_cast<std::chrono::duration<double>>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+/* Times `calls` calls of body(n) on the calling thread and reports them. */
+template <class BODY>
+static auto timeCalls(const char* benchmark, const char* variant, u64 calls, BODY body) -> void
+{
+    auto start = std::chrono::high_resolution_clock::now();
+    for (u64 n = 0; n < calls; n++)
+        body(n);
+    result(benchmark, variant, 1, seconds(start), calls);
+}
+
+/* Agent layout before the exchange areas, as the AgentMap of the original simulator. */
+//Note: the temperature and the pushes written by the neighbors sit among the
+//      private state the owner updates every cycle (XE counters, energy, pulls).
+struct LegacyAgentMap
+{
+    u64 id;
+    u64 bid;
+    u64 uid;
+    u64 role;
+
+    FLOAT_TYPE temperature; // read by the neighbors.
+
+    struct AgentMap::xe xe[N_CORES_IN_BLOCK];
+
+    std::deque<FLOAT_TYPE> energyWindow;
+    ENERGY_TYPE accumulatedEnergy;
+
+    u64 memory[10000]; // mailboxes.
+
+    LegacyAgentMap* topNeighbor;
+    LegacyAgentMap* btmNeighbor;
+    LegacyAgentMap* lftNeighbor;
+    LegacyAgentMap* rhtNeighbor;
+
+    struct
+    {
+        FLOAT_TYPE top_push; // written by the neighbors.
+        FLOAT_TYPE btm_push;
+        FLOAT_TYPE lft_push;
+        FLOAT_TYPE rht_push;
+        FLOAT_TYPE top_pull;
+        FLOAT_TYPE btm_pull;
+        FLOAT_TYPE lft_pull;
+        FLOAT_TYPE rht_pull;
+    } temp;
+};
+
+/* Fields of one agent touched every cycle -- by the owner, or by the neighbors for the exchanged ones. */
+struct HotFields
+{
+    volatile FLOAT_TYPE*  temperature;                   // exchanged -- written by the owner.
+    volatile FLOAT_TYPE*  push[BENCH_WRITERS];           // exchanged -- written by each neighbor.
+    volatile FLOAT_TYPE*  pull[BENCH_WRITERS];           // private.
+    volatile u64*         instCounter[N_CORES_IN_BLOCK]; // private.
+    volatile ENERGY_TYPE* accumulatedEnergy;             // private.
+};
+
+/* Opens a per-thread hardware counter. Returns -1 if the host does not support it. */
+static auto openCounter(u64 config) -> int
+{
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = config;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+/* Reads and closes a counter opened with openCounter. */
+static auto closeCounter(int fd) -> s64
+{
+    s64 value = -1;
+    if (fd < 0)
+        return -1;
+    ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+    if (read(fd, &value, sizeof(value)) != sizeof(value))
+        value = -1;
+    close(fd);
+    return value;
+}
+
+std::atomic<s64> cacheMisses;
+std::atomic<u64> ready;
+
+/* Adds the misses of a counter to the total of the run (-1 once one is unavailable). */
+static auto addMisses(int fd) -> void
+{
+    s64 misses = closeCounter(fd);
+    if (misses < 0 || cacheMisses.load() < 0)
+        cacheMisses = -1;
+    else
+        cacheMisses += misses;
+}
+
+/* Starts the counter of a thread once the owner and every neighbor are ready. */
+static auto startTogether() -> int
+{
+    int fd = openCounter(PERF_COUNT_HW_CACHE_MISSES);
+    ready++;
+    while (ready.load() != BENCH_WRITERS+1);
+    if (fd >= 0)
+        ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+    return fd;
+}
+
+/* Owner cycles: XE counters and energy, heat pulled from the pushes, new temperature. */
+static auto owner(const HotFields* fields) -> void
+{
+    int fd = startTogether();
+    for (u64 i = 0; i < BENCH_ITERATIONS; i++)
+    {
+        for (u64 c = 0; c < N_CORES_IN_BLOCK; c++)
+            *fields->instCounter[c] = *fields->instCounter[c] + 1;
+        *fields->accumulatedEnergy = *fields->accumulatedEnergy + 1;
+        for (u64 n = 0; n < BENCH_WRITERS; n++)
+            *fields->pull[n] = *fields->push[n];
+        *fields->temperature = *fields->temperature + 1.0;
+    }
+    addMisses(fd);
+}
+
+/* Neighbor cycles: reads the temperature and pushes heat into its field. */
+static auto neighbor(const HotFields* fields, u64 n) -> void
+{
+    int fd = startTogether();
+    for (u64 i = 0; i < BENCH_ITERATIONS; i++)
+        *fields->push[n] = *fields->push[n] + *fields->temperature*1e-9;
+    addMisses(fd);
+}
+
+/* Runs the owner and its neighbors on the given layout and reports the time per owner cycle. */
+static auto run(const char* name, const HotFields& fields) -> void
+{
+    std::vector<std::thread> threads;
+    cacheMisses = 0;
+    ready = 0;
+    auto start = std::chrono::high_resolution_clock::now();
+    threads.push_back(std::thread(owner, &fields));
+    for (u64 n = 0; n < BENCH_WRITERS; n++)
+        threads.push_back(std::thread(neighbor, &fields, n));
+    for (auto& t : threads)
+        t.join();
+    double elapsed = seconds(start);
+    char note[64] = "cache_misses=n/a";
+    if (cacheMisses.load() >= 0)
+        snprintf(note, sizeof(note), "cache_misses=%ld", (s64) cacheMisses.load());
+    result("exchange", name, BENCH_WRITERS+1, elapsed, BENCH_ITERATIONS, note);
+}
+
+/* Exchanged fields inside the agent (legacy) vs padded exchange area, under the owner and its neighbors. */
+static auto benchExchange() -> int
+{
+    section("==> Exchange area layout: owner + %d neighbors, %d cycles each.\n", BENCH_WRITERS, BENCH_ITERATIONS);
+    section("    sizeof legacy agent: %lu bytes, sizeof agent: %lu bytes + padded exchange area: %lu bytes.\n",
+            sizeof(LegacyAgentMap), sizeof(AgentMap), sizeof(ExchangeArea));
+
+    LegacyAgentMap* legacy = new LegacyAgentMap();
+    HotFields legacyFields =
+    {
+        &legacy->temperature,
+        {&legacy->temp.top_push, &legacy->temp.btm_push, &legacy->temp.lft_push, &legacy->temp.rht_push},
+        {&legacy->temp.top_pull, &legacy->temp.btm_pull, &legacy->temp.lft_pull, &legacy->temp.rht_pull},
+        {},
+        &legacy->accumulatedEnergy,
+    };
+    for (u64 c = 0; c < N_CORES_IN_BLOCK; c++)
+        legacyFields.instCounter[c] = &legacy->xe[c].instCounter;
+    run("legacy (in agent)", legacyFields);
+    delete legacy;
+
+    AgentMap* map = new AgentMap();
+    void* region = NULL;
+    if (posix_memalign(&region, CACHE_LINE_SIZE, sizeof(ExchangeArea)) != 0)
+        return 1;
+    ExchangeArea* exchange = new (region) ExchangeArea();
+    HotFields paddedFields =
+    {
+        &exchange->temperature,
+        {&exchange->top_push, &exchange->btm_push, &exchange->lft_push, &exchange->rht_push},
+        {&map->temp.top_pull, &map->temp.btm_pull, &map->temp.lft_pull, &map->temp.rht_pull},
+        {},
+        &map->accumulatedEnergy,
+    };
+    for (u64 c = 0; c < N_CORES_IN_BLOCK; c++)
+        paddedFields.instCounter[c] = &map->xe[c].instCounter;
+    run("exchange (padded)", paddedFields);
+    delete map;
+    free(exchange);
+    return 0;
+}
+
+/* EDT metadata maps -- the former std::map (behind a mutex once shared) vs the GUID table. */
+//Note: GUIDs are spread like heap addresses (64 byte apart); each thread owns a
+//      contiguous slice of them.
+typedef std::map<ocrGuid_t*, saEdtInfoMetadata> LegacyGuidMap;
+
+/* Reports the insert, lookup (if timed) and erase passes of one map. */
+static auto report(const char* name, u64 threads, double insert, double lookup, double erase, u64 checksum) -> void
+{
+    char variant[64], note[64];
+    snprintf(note, sizeof(note), "checksum=%lu", checksum);
+    snprintf(variant, sizeof(variant), "%s insert", name);
+    result("guidmap", variant, threads, insert, BENCH_EDTS, note);
+    if (lookup >= 0)
+    {
+        snprintf(variant, sizeof(variant), "%s lookup", name);
+        result("guidmap", variant, threads, lookup, BENCH_EDTS, note);
+    }
+    snprintf(variant, sizeof(variant), "%s erase", name);
+    result("guidmap", variant, threads, erase, BENCH_EDTS, note);
+}
+
+/* Runs body(first, last) on `threads` slices of the GUIDs and returns the wall time. */
+template <class BODY>
+static auto parallel(u64 threads, BODY body) -> double
+{
+    std::vector<std::thread> workers;
+    auto start = std::chrono::high_resolution_clock::now();
+    for (u64 t = 0; t < threads; t++)
+        workers.push_back(std::thread(body, BENCH_EDTS*t/threads, BENCH_EDTS*(t+1)/threads));
+    for (auto& w : workers)
+        w.join();
+    return seconds(start);
+}
+
+static auto benchGuidMap() -> int
+{
+    section("==> EDT metadata map: %d EDTs inserted, looked up and erased.\n", BENCH_EDTS);
+
+    std::vector<ocrGuid_t*> guids(BENCH_EDTS);
+    for (u64 i = 0; i < BENCH_EDTS; i++)
+        guids[i] = (ocrGuid_t*) (0x10000000UL + i*64);
+    saEdtInfoMetadata md = SA_EDT_INFO_METADATA_INITIALIZER;
+    std::atomic<u64> checksum;
+
+    for (u64 threads = 1; threads <= BENCH_THREADS; threads *= BENCH_THREADS)
+    {
+        LegacyGuidMap* legacy = new LegacyGuidMap();
+        std::mutex mutex;
+        checksum = 0;
+        double insert = parallel(threads, [&](u64 first, u64 last)
+        {
+            for (u64 i = first; i < last; i++)
+            {
+                std::lock_guard<std::mutex> guard(mutex);
+                (*legacy)[guids[i]] = md;
+            }
+        });
+        double lookup = parallel(threads, [&](u64 first, u64 last)
+        {
+            u64 sum = 0;
+            for (u64 i = first; i < last; i++)
+            {
+                std::lock_guard<std::mutex> guard(mutex);
+                LegacyGuidMap::iterator it = legacy->find(guids[i]);
+                if (it != legacy->end())
+                    sum += it->second.SA_ATR_METADATA_TYPE;
+            }
+            checksum += sum;
+        });
+        double erase = parallel(threads, [&](u64 first, u64 last)
+        {
+            for (u64 i = first; i < last; i++)
+            {
+                std::lock_guard<std::mutex> guard(mutex);
+                legacy->erase(guids[i]);
+            }
+        });
+        report("std::map + mutex", threads, insert, lookup, erase, checksum);
+        delete legacy;
+
+        GuidMap<saEdtInfoMetadata> table;
+        checksum = 0;
+        insert = parallel(threads, [&](u64 first, u64 last)
+        {
+            for (u64 i = first; i < last; i++)
+                table.insert((const void*) guids[i], md);
+        });
+        lookup = parallel(threads, [&](u64 first, u64 last)
+        {
+            u64 sum = 0;
+            saEdtInfoMetadata value;
+            for (u64 i = first; i < last; i++)
+                if (table.lookup((const void*) guids[i], value))
+                    sum += value.SA_ATR_METADATA_TYPE;
+            checksum += sum;
+        });
+        erase = parallel(threads, [&](u64 first, u64 last)
+        {
+            for (u64 i = first; i < last; i++)
+                table.erase((const void*) guids[i]);
+        });
+        report("GuidMap", threads, insert, lookup, erase, checksum);
+
+        checksum = 0;
+        std::vector<saEdtInfoMetadata> values(BENCH_EDTS, md);
+        insert = parallel(threads, [&](u64 first, u64 last)
+        {
+            table.insertBulk((const void* const*) &guids[first], &values[first], last - first);
+        });
+        erase = parallel(threads, [&](u64 first, u64 last)
+        {
+            checksum += table.eraseBulk((const void* const*) &guids[first], last - first);
+        });
+        report("GuidMap (bulk)", threads, insert, -1, erase, checksum);
+    }
+    return 0;
+}
+
+/* Aggregation of a unit's children maps -- separate passes vs fused vs incremental. */
+//Note: each aggregation follows one child report, as in unitRole.
+static auto benchMoments() -> int
+{
+    section("==> Unit aggregation: %d reports over %lu children.\n", BENCH_AGGREGATES, N_BLOCKS_IN_UNIT);
+
+    FLOAT_TYPE data[N_BLOCKS_IN_UNIT];
+    unsigned int seed = 1;
+    std::vector<FLOAT_TYPE> reports(1024);
+    for (auto& r : reports)
+        r = 40.0 + rand_r(&seed)%1000/100.0;
+    for (u64 i = 0; i < N_BLOCKS_IN_UNIT; i++)
+        data[i] = reports[i];
+
+    volatile FLOAT_TYPE sink;
+    timeCalls("moments", "separate passes", BENCH_AGGREGATES, [&](u64 n)
+    {
+        data[n % N_BLOCKS_IN_UNIT] = reports[n % reports.size()];
+        FLOAT_TYPE avg = computeAverage(data, N_BLOCKS_IN_UNIT);
+        sink = computeVariance(data, avg, N_BLOCKS_IN_UNIT) + computeSkew(data, avg, N_BLOCKS_IN_UNIT);
+    });
+
+    timeCalls("moments", "computeMoments", BENCH_AGGREGATES, [&](u64 n)
+    {
+        data[n % N_BLOCKS_IN_UNIT] = reports[n % reports.size()];
+        Moments m = computeMoments(data, N_BLOCKS_IN_UNIT);
+        sink = m.variance + m.skew;
+    });
+
+    MomentsAccumulator acc;
+    momentsInit(&acc, data, N_BLOCKS_IN_UNIT);
+    timeCalls("moments", "MomentsAccumulator", BENCH_AGGREGATES, [&](u64 n)
+    {
+        momentsReplace(&acc, data, n % N_BLOCKS_IN_UNIT, reports[n % reports.size()]);
+        Moments m = momentsGet(&acc);
+        sink = m.variance + m.skew;
+    });
+    (void) sink;
+    return 0;
+}
+
+/* Block layout and thermal constants as set up by main in the simulator. */
+static auto initializeModel() -> void
+{
+    static bool initialized = false;
+    if (initialized)
+        return;
+    chip_layout.block_height_mm = sqrt(S_CHIP_IN_MM) / sqrt(N_UNITS_IN_CHIP) / sqrt(N_BLOCKS_IN_UNIT);
+    chip_layout.block_width_mm  = chip_layout.block_height_mm;
+    temperatureModelInit();
+    initialized = true;
+}
+
+/* Synthetic XE states: the task every XE runs, its DVFS state and how many it has queued. */
+struct WorkVariant
+{
+    const char* name;
+    const char* task;
+    u16 state;
+    u64 tasks;
+};
+
+/* ExecuteWork on one block -- each variant runs on a fresh thread so the agent starts clean. */
+//Note: memory instructions hold one of the unit's DRAM ports, the eight XEs of
+//      the block compete for the DRAM_PORTS of the unit as in the engine.
+static auto benchWork() -> int
+{
+    section("==> ExecuteWork: %d ticks of one block (%lu XEs) on synthetic states.\n", BENCH_TICKS, N_CORES_IN_BLOCK);
+    initializeModel();
+
+    //Synthetic instructions -- type, half state energy, full state energy, latency, multiplier.
+    InstType alu = {0, ENERGY_FROM_PJ(20.0), ENERGY_FROM_PJ(40.0), 4, 2};
+    InstType load = {20, ENERGY_FROM_PJ(60.0), ENERGY_FROM_PJ(120.0), 20, 2};
+    ID_TYPE aluId = instructionSet.add("bench.alu", alu);
+    ID_TYPE loadId = instructionSet.add("bench.load", load);
+    noopInstruction.halfStateEnergy = ENERGY_FROM_PJ(5.0);
+    noopInstruction.fullStateEnergy = ENERGY_FROM_PJ(10.0);
+
+    TaskType compute, mixed;
+    for (u64 i = 0; i < 64; i++)
+    {
+        compute.instructions.push_back(aluId);
+        mixed.instructions.push_back(i%4 == 0 ? loadId : aluId);
+    }
+    taskSet.add("bench.compute", compute);
+    taskSet.add("bench.mixed", mixed);
+
+    WorkVariant variants[] =
+    {
+        {"compute full",  "bench.compute", XE_STATE_FULL, BENCH_TICKS},
+        {"compute half",  "bench.compute", XE_STATE_HALF, BENCH_TICKS},
+        {"memory bound full", "bench.mixed", XE_STATE_FULL, BENCH_TICKS},
+        {"idle",          "bench.compute", XE_STATE_FULL, 0},
+    };
+
+    for (auto& v : variants)
+    {
+        double elapsed = 0;
+        u64 instructions = 0;
+        std::thread t([&]
+        {
+            void* region = NULL;
+            if (posix_memalign(&region, CACHE_LINE_SIZE, sizeof(ExchangeArea)) != 0)
+                return;
+            #if PROBES == 1
+            probeRegister(0);
+            #endif
+            agent.exchange = new (region) ExchangeArea();
+            agent.exchange->temperature = 50;
+            agent.topNeighbor = agent.btmNeighbor = agent.lftNeighbor = agent.rhtNeighbor = NULL;
+            ID_TYPE task = taskSet.lookup_id(v.task);
+            for (u64 i = 0; i < N_CORES_IN_BLOCK; i++)
+            {
+                agent.xe[i].state = v.state;
+                agent.xe[i].taskQueue.assign(v.tasks, task);
+            }
+
+            auto start = std::chrono::high_resolution_clock::now();
+            executeWorkTicks(BENCH_TICKS);
+            elapsed = seconds(start);
+            instructions = agent.statistics.instsExecuted;
+            free(agent.exchange);
+            #if PROBES == 1
+            probeUnregister();
+            #endif
+        });
+        t.join();
+        char note[64];
+        snprintf(note, sizeof(note), "instructions=%lu", instructions);
+        result("work", v.name, 1, elapsed, BENCH_TICKS, note);
+    }
+    return 0;
+}
+
+/* Thermal model step of a block with all four neighbors. */
+static auto benchTemperature() -> int
+{
+    section("==> Thermal model: %d calls of computeTemperature.\n", BENCH_CALLS);
+    initializeModel();
+
+    FLOAT_TYPE energy[16];
+    for (u64 i = 0; i < 16; i++)
+        energy[i] = 100.0 + i*25.0;
+    FLOAT_TYPE temperature = 50.0;
+    timeCalls("temperature", "computeTemperature", BENCH_CALLS, [&](u64 n)
+    {
+        temperature = computeTemperature(energy[n%16], temperature, temperature+1.0, temperature-1.0, temperature+0.5, temperature-0.5);
+    });
+    section("    final temperature: %.3fC\n", temperature);
+    return 0;
+}
+
+static Barrier centralBarrier;
+static TreeBarrier<BARRIER_COUNT> treeBarrier;
+
+/* Central and tree barriers of the engine from 16 to BENCH_MAX_WAITERS threads. */
+//Note: every thread waits BENCH_WAITS/threads times, one operation is one
+//      episode of the barrier (all threads through).
+static auto benchBarrier() -> int
+{
+    section("==> Barriers: %d waits per run, tree barriers with %d groups.\n", BENCH_WAITS, BARRIER_COUNT);
+    auto never = [] { return false; };
+
+    for (u64 threads = 16; threads <= BENCH_MAX_WAITERS; threads *= 4)
+    {
+        u64 episodes = BENCH_WAITS/threads;
+        for (u64 tree = 0; tree <= 1; tree++)
+        {
+            std::vector<std::thread> workers;
+            auto start = std::chrono::high_resolution_clock::now();
+            for (u64 id = 0; id < threads; id++)
+                workers.push_back(std::thread([&, id]
+                {
+                    for (u64 n = 0; n < episodes; n++)
+                        if (tree)
+                            treeBarrier.wait(id, threads, never);
+                        else
+                            centralBarrier.wait(threads, never);
+                }));
+            for (auto& w : workers)
+                w.join();
+            result("barrier", tree ? "tree" : "central", threads, seconds(start), episodes);
+        }
+    }
+    return 0;
+}
+
+/* Generic and typed metadata accessors on a block info message. */
+static auto benchMetadata() -> int
+{
+    section("==> Metadata accessors: %d calls each.\n", BENCH_CALLS);
+
+    saBlkInfoMetadata md = SA_BLK_INFO_METADATA_INITIALIZER;
+    volatile FLOAT_TYPE sink = 0;
+    timeCalls("metadata", "saSetMetadata", BENCH_CALLS, [&](u64 n)
+    {
+        FLOAT_TYPE power = (n % 1600) / 100.0;
+        saSetMetadata(&md, SA_ATR_FUB_POW_SCORE, &power);
+    });
+    timeCalls("metadata", "saGetMetadata", BENCH_CALLS, [&](u64 n)
+    {
+        FLOAT_TYPE power;
+        saGetMetadata(&md, SA_ATR_FUB_POW_SCORE, &power);
+        sink = sink + power;
+    });
+    timeCalls("metadata", "sa::set", BENCH_CALLS, [&](u64 n)
+    {
+        sa::set<SA_ATR_FUB_POW_SCORE>(md, (n % 1600) / 100.0);
+        sink = md.SA_ATR_FUB_POW_SCORE;
+    });
+    timeCalls("metadata", "sa::get", BENCH_CALLS, [&](u64 n)
+    {
+        sink = sink + sa::get<SA_ATR_FUB_POW_SCORE>(md);
+    });
+    (void) sink;
+    return 0;
+}
+
+/* Encoders of the power and temperature reports. */
+static auto benchPack() -> int
+{
+    section("==> Report encoding: %d calls each.\n", BENCH_CALLS);
+
+    volatile u64 bits = 0;
+    volatile FLOAT_TYPE sink = 0;
+    timeCalls("pack", "packPowerData", BENCH_CALLS, [&](u64 n)
+    {
+        bits = bits + packPowerData((n % 1600) / 100.0, MAX_POWER_PER_BLOCK, 16);
+    });
+    timeCalls("pack", "unpackPowerData", BENCH_CALLS, [&](u64 n)
+    {
+        sink = sink + unpackPowerData(n & 0xffff, MAX_POWER_PER_BLOCK, 16);
+    });
+    timeCalls("pack", "packTemperatureData", BENCH_CALLS, [&](u64 n)
+    {
+        bits = bits + packTemperatureData((n % 2000) / 100.0 - 10.0);
+    });
+    timeCalls("pack", "unpackTemperatureData", BENCH_CALLS, [&](u64 n)
+    {
+        sink = sink + unpackTemperatureData(n & 0xff);
+    });
+    (void) bits;
+    (void) sink;
+    return 0;
+}
+
+/* Temperature and power series (LOG_SERIES) of the chip, written and read back. */
+static auto benchSeries() -> int
+{
+    const u64 agents = N_UNITS_IN_CHIP*N_BLOCKS_IN_UNIT;
+    section("==> Series: %d rows of %lu blocks.\n", BENCH_SAMPLES, agents);
+
+    //Slowly heating blocks with noisy powers, as logged every LOGGING_INTERVAL.
+    std::vector<double> temperature(agents, TEMPERATURE_AMBIENT), power(agents);
+    std::vector<double> rows(2*agents*BENCH_SAMPLES);
+    unsigned int seed = 1;
+    for (u64 row = 0; row < BENCH_SAMPLES; row++)
+        for (u64 i = 0; i < agents; i++)
+        {
+            temperature[i] += rand_r(&seed)%1000*1e-6;
+            rows[row*2*agents + i] = temperature[i];
+            rows[row*2*agents + agents + i] = rand_r(&seed)%1000*MAX_POWER_PER_BLOCK/1000;
+        }
+
+    char path[64];
+    snprintf(path, sizeof(path), "/tmp/safe-bench-series.%d", getpid());
+    SeriesWriter writer;
+    if (!writer.open(path, agents, N_BLOCKS_IN_UNIT))
+    {
+        perror(path);
+        return 1;
+    }
+    auto start = std::chrono::high_resolution_clock::now();
+    for (u64 row = 0; row < BENCH_SAMPLES; row++)
+        writer.append(row*LOGGING_INTERVAL, &rows[row*2*agents], &rows[row*2*agents + agents]);
+    writer.close();
+    char note[64];
+    snprintf(note, sizeof(note), "%.2f bytes per value", (double) writer.bytes/(2*agents*BENCH_SAMPLES));
+    result("series", "SeriesWriter::append", 1, seconds(start), BENCH_SAMPLES, note);
+
+    SeriesReader reader;
+    if (!reader.open(path))
+    {
+        printf("%s: not a series.\n", path);
+        return 1;
+    }
+    u64 cycle, errors = 0;
+    start = std::chrono::high_resolution_clock::now();
+    for (u64 row = 0; row < BENCH_SAMPLES; row++)
+    {
+        reader.read(row, cycle, temperature.data(), power.data());
+        errors += memcmp(temperature.data(), &rows[row*2*agents], agents*sizeof(double)) != 0;
+    }
+    result("series", "SeriesReader::read", 1, seconds(start), BENCH_SAMPLES, errors ? "MISMATCH" : "");
+    reader.close();
+    unlink(path);
+    return errors != 0;
+}
+
+/* Statistics of ss-math.c on the children map of a unit. */
+static auto benchMath() -> int
+{
+    section("==> Statistics: %d calls each over %lu values.\n", BENCH_CALLS, N_BLOCKS_IN_UNIT);
+
+    FLOAT_TYPE data[N_BLOCKS_IN_UNIT], other[N_BLOCKS_IN_UNIT];
+    unsigned int seed = 1;
+    for (u64 i = 0; i < N_BLOCKS_IN_UNIT; i++)
+    {
+        data[i] = 40.0 + rand_r(&seed)%1000/100.0;
+        other[i] = 2.0 + rand_r(&seed)%1000/100.0;
+    }
+    FLOAT_TYPE avg = computeAverage(data, N_BLOCKS_IN_UNIT);
+    FLOAT_TYPE avg2 = computeAverage(other, N_BLOCKS_IN_UNIT);
+
+    volatile FLOAT_TYPE sink = 0;
+    timeCalls("math", "computeAverage", BENCH_CALLS, [&](u64 n)
+    {
+        data[n % N_BLOCKS_IN_UNIT] += 1e-9;
+        sink = computeAverage(data, N_BLOCKS_IN_UNIT);
+    });
+    timeCalls("math", "computeVariance", BENCH_CALLS, [&](u64 n)
+    {
+        data[n % N_BLOCKS_IN_UNIT] += 1e-9;
+        sink = computeVariance(data, avg, N_BLOCKS_IN_UNIT);
+    });
+    timeCalls("math", "computeSkew", BENCH_CALLS, [&](u64 n)
+    {
+        data[n % N_BLOCKS_IN_UNIT] += 1e-9;
+        sink = computeSkew(data, avg, N_BLOCKS_IN_UNIT);
+    });
+    timeCalls("math", "computeCovariance", BENCH_CALLS, [&](u64 n)
+    {
+        data[n % N_BLOCKS_IN_UNIT] += 1e-9;
+        sink = computeCovariance(data, avg, other, avg2, N_BLOCKS_IN_UNIT);
+    });
+    timeCalls("math", "computeMoments", BENCH_CALLS, [&](u64 n)
+    {
+        data[n % N_BLOCKS_IN_UNIT] += 1e-9;
+        sink = computeMoments(data, N_BLOCKS_IN_UNIT).skew;
+    });
+    (void) sink;
+    return 0;
+}
+
+/* Instruction table lookups -- by ID as in ExecuteWork, by hash and by name as in the parser. */
+static auto benchLookup() -> int
+{
+    section("==> Instruction lookups: %d calls each.\n", BENCH_CALLS);
+
+    LookupContainer<InstType> table;
+    std::vector<std::string> names;
+    std::vector<std::size_t> hashes;
+    std::vector<ID_TYPE> ids;
+    for (u64 i = 0; i < 256; i++)
+    {
+        InstType inst = {(s64) i%2, 0, 0, 1, 1};
+        names.push_back("bench.inst." + std::to_string(i));
+        hashes.push_back(std::hash<std::string>{}(names.back()));
+        ids.push_back(table.add(names.back(), inst));
+    }
+
+    volatile s64 sink = 0;
+    timeCalls("lookup", "lookup(id)", BENCH_CALLS, [&](u64 n)
+    {
+        sink = sink + table.lookup(ids[(n*37) % ids.size()]).type;
+    });
+    timeCalls("lookup", "lookup_id(hash)", BENCH_CALLS, [&](u64 n)
+    {
+        sink = sink + table.lookup_id(hashes[(n*37) % hashes.size()]);
+    });
+    timeCalls("lookup", "lookup(name)", BENCH_CALLS/10, [&](u64 n)
+    {
+        sink = sink + table.lookup(names[(n*37) % names.size()]).type;
+    });
+    (void) sink;
+    return 0;
+}
+
+/* Benchmarks by the name selecting them on the command line. */
+static const struct
+{
+    const char* name;
+    auto (*run)() -> int;
+} benchmarks[] =
+{
+    {"exchange",    benchExchange},
+    {"guidmap",     benchGuidMap},
+    {"moments",     benchMoments},
+    {"work",        benchWork},
+    {"temperature", benchTemperature},
+    {"barrier",     benchBarrier},
+    {"metadata",    benchMetadata},
+    {"pack",        benchPack},
+    {"series",      benchSeries},
+    {"math",        benchMath},
+    {"lookup",      benchLookup},
+};
+
+/* Runs every benchmark, or the ones named on the command line. --csv prints CSV rows only. */
+auto main(int argc, char* argv[]) -> int
+{
+    std::vector<const char*> names;
+    for (int i = 1; i < argc; i++)
+    {
+        bool known = strcmp(argv[i], "--csv") == 0;
+        for (auto& b : benchmarks)
+            known |= strcmp(argv[i], b.name) == 0;
+        if (!known)
+        {
+            printf("usage: %s [--csv] [benchmark...]\n       benchmarks:", argv[0]);
+            for (auto& b : benchmarks)
+                printf(" %s", b.name);
+            printf("\n");
+            return 1;
+        }
+        if (strcmp(argv[i], "--csv") == 0)
+            csv = true;
+        else
+            names.push_back(argv[i]);
+    }
+
+    if (csv)
+        printf("benchmark,variant,threads,ns_per_op,ops_per_s,note\n");
+    int ret = 0;
+    for (auto& b : benchmarks)
+    {
+        bool selected = names.empty();
+        for (auto name : names)
+            selected |= strcmp(name, b.name) == 0;
+        if (selected)
+            ret |= b.run();
+    }
+    return ret;
+}
@@ -34,9 +34,17 @@
 #include "ss-types.h"
 
 //System parameters
+//Note: the ones under #ifndef can be set at build time instead, e.g.
+//      make CONF="-DMAX_TIME=20 -DN_UNITS_IN_CHIP=4UL" (see scalingBenchmark.sh).
+#ifndef MAX_TIME
 #define MAX_TIME 5000000               // Max time to let the simulation run in ms
+#endif
+#ifndef TASK_MULTIPLIER
 #define TASK_MULTIPLIER 490050      // number of times to reinsert tasks (for longer execution)
+#endif
+#ifndef INST_PER_MEGA_INST
 #define INST_PER_MEGA_INST 512      // combine instructions together.
+#endif
 #define DRAM_PORTS 2                // number of dram ports per unit
 #define BARRIER_INTERVALS (100000)  // Barrier interval in cycles.
 #define MAX_XE_CLOCK_SPEED_MHZ					4200		//Clock speed of XEs.
@@ -47,20 +55,70 @@
 #define POWER_SWING 0.00005          // When to send data to other agents in terms of change in picowatts per second
 #define TREE_BARRIERS 1             // use tree barriers instead of a single global barrier
 #define BARRIER_COUNT 16            // count of barriers when using tree barriers -- ignored otherwise
+#define SYNC_MODE 0                 // 0 = global barriers every BARRIER_INTERVALS, 1 = each agent only waits for its thermal neighbors, parent and children
+#define SYNC_LOOKAHEAD 1000         // clock ticks an agent may run ahead of its slowest peer in SYNC_MODE 1
+#define SYNC_QUANTUM_ADAPTIVE 0     // choose the epoch length (lookahead in SYNC_MODE 1) from the thermal gradients and rates instead of BARRIER_INTERVALS (SYNC_LOOKAHEAD)
+#define SYNC_QUANTUM_MIN 1000       // shortest adaptive quantum in clock ticks
+#define SYNC_QUANTUM_MAX BARRIER_INTERVALS // longest adaptive quantum in clock ticks (raise it to let quiet runs synchronize less often than the fixed epochs)
+#define SYNC_TEMPERATURE_ERROR 1.0  // largest temperature change (C) of a block within one adaptive quantum
 #define FLOAT_TYPE double           // floating point number precision to use
+#define ENERGY_FIXED_POINT 0        // keep energies as integer femtojoules (exact, order independent sums) instead of FLOAT_TYPE picojoules
 #define ID_TYPE u32                 // used to identify tasks. Gives the max number of ids. Can shrink memory usage.
+#define THREAD_PLACEMENT 0          // 0 = leave to the scheduler, 1 = pin whole units to a NUMA node (L3 group on single node hosts) read from sysfs
+#define ARENA_ALLOCATOR 0           // 1 = simulation state comes from a per-run arena reserved once the input is read (sized from the chip and the queued tasks), 0 = general purpose allocator
+#define ARENA_HUGE_PAGES 1          // back the arena with 2 MB pages (MAP_HUGETLB if the pool holds it, transparent huge pages otherwise)
+#define TELEMETRY_MODE 0            // how subtrees report: 0 = push on swings, 1 = pull every TELEMETRY_PULL_INTERVAL, 2 = hybrid (pulls plus large swings), 3 = chosen per unit from its thermal headroom
+#define TELEMETRY_PULL_INTERVAL 16  // clock ticks between telemetry pulls
+#define TELEMETRY_HYBRID_SWING_SCALE 4.0 // swings are scaled by this in hybrid mode
+#define TELEMETRY_HEADROOM_PUSH 10.0 // mode 3: units whose hottest blocks are fewer degrees than this below TEMPERATURE_OPERATION push
+#define TELEMETRY_HEADROOM_PULL 30.0 // mode 3: units with more headroom than this are only pulled, the ones in between are hybrid
+#define TELEMETRY_HEADROOM_HYSTERESIS 2.0 // mode 3: extra headroom needed to go back to a cooler mode
+#define SA_MESSAGE_EPOCH 4          // clock ticks between deliveries of the coalesced SA messages
+#define MAILBOX_DEPTH 8             // messages in flight per direction between a parent and a child (power of two)
+#define CACHE_LINE_SIZE 64          // host cache line size in bytes. State written by different threads is padded to it.
+#define GUID_MAP_SHARDS 64          // lock stripes of the EDT metadata table (power of two)
+#define MOMENTS_RESYNC 4096         // incremental statistics updates between rebuilds from the data (bounds rounding drift)
+#define ROLE_TIMER_WHEEL 0          // activate the roles from a per-agent timer wheel, mail doorbells and block sensor events instead of every cycle
+#define SYNTHETIC_TASKS 4           // distinct tasks of a --synthetic workload
+#define SYNTHETIC_TASK_LENGTH 65536 // instructions per synthetic task
+#define SYNTHETIC_QUEUE_LENGTH 2048 // tasks in the synthetic queue (each reinserted TASK_MULTIPLIER times)
 #define DEBUG 0                     // enable debugging (checking of bounds)
 #define LOGGING_LEVEL						1
 #define LOGGING_INTERVAL					100000
-#define EXECUTION_TIMES 					3		//Allow measuring the execution times of different part of the code. 1=total time|2 = roles, barriers and sim, 3=Each role, each model (more specific)
+#define LOG_ASYNC					0		//With LOGGING_LEVEL 1, engines append binary records to per-thread rings drained by a writer thread into LOG_FILE (safe-log2text writes the block logs from it) instead of formatting each block log themselves.
+#define LOG_RING_DEPTH					1024		//With LOG_ASYNC, records buffered per thread (power of two). A thread finding its ring full yields to the writer.
+#define LOG_SEGMENT_RECORDS				4096		//With LOG_ASYNC, records per segment of LOG_FILE.
+#define LOG_FILE					"safe-log.bin"	//With LOG_ASYNC, binary log written in SAFE_LOGS_PATH.
+#define LOG_SERIES					0		//With LOG_ASYNC, the writer stores the block temperatures and powers by sample as compressed columns in LOG_SERIES_FILE instead of LOG_FILE (safe-log2text merges them back).
+#define LOG_SERIES_ROWS					64		//With LOG_SERIES, samples per compressed block of LOG_SERIES_FILE.
+#define LOG_SERIES_FILE					"safe-series.bin"	//With LOG_SERIES, series file written in SAFE_LOGS_PATH.
+#define EXECUTION_TIMES 					3		//Allow measuring the execution times of different part of the code. 1=total time|2 = roles, barriers and sim (per-thread probes)|3=Each role, each model (more specific)
+#define PROBES							(EXECUTION_TIMES >= 2)		//Per-thread latency histograms of the phases, merged into a report at exit -- follows EXECUTION_TIMES.
+#define PROBE_SAMPLE					64		//With EXECUTION_TIMES 2 or 3, one in this many cycles is timed (barrier waits always are) and the phase totals are extrapolated from them.
+#define PROBE_COUNTERS					0		//With EXECUTION_TIMES 2 or 3, also count cycles, instructions, LLC and branch misses and context switches per phase with perf_event_open (the events the host lacks are left out).
+#define TRACE						0		//Record a timeline of the engine threads (init phases, epochs, barrier arrive/leave, sync waits, messages sent and received, deliveries, log writes, live state publications) and write it at exit as Chrome trace-event JSON.
+#define TRACE_EVENTS					65536		//With TRACE, events kept per thread (later ones are dropped and counted).
+#define TRACE_FILE					"safe-trace.json"	//With TRACE, trace file written in SAFE_LOGS_PATH.
+#define LIVE						0		//Publish the progress, block temperatures and powers at every epoch boundary in the shared memory object LIVE_NAME-<pid> (seqlock, the simulation never waits for the readers). Watch it with safe-top.
+#define LIVE_NAME					"/safe-live"	//With LIVE, prefix of the shared memory object, followed by the pid of the run (SAFE_LIVE_NAME in the environment replaces the whole name).
+#define LIVE_READ_RETRIES				100000		//Reads of the live state tried while the writer holds it before checking whether it is still alive.
+#define LIVE_PRINT					0		//Print the progress and the temperature grid to stdout from a separate thread, sampled every LIVE_PRINT_INTERVAL ms.
+#define LIVE_PRINT_INTERVAL				1000		//With LIVE_PRINT, milliseconds between printouts (only printed when the state changed).
 #define MAX_STR_SZ						64UL
+#ifndef N_UNITS_IN_CHIP
 #define N_UNITS_IN_CHIP						16UL
+#endif
+#ifndef N_BLOCKS_IN_UNIT
 #define N_BLOCKS_IN_UNIT					16UL
+#endif
 #define N_CORES_IN_BLOCK					8UL
 #define S_CHIP_IN_MM						500		//Chip size in mm^2.
 #define TEMPERATURE_JUNCTION					127		//maximum junction point temperature.
 #define TEMPERATURE_OPERATION					100		//maximum operating temperature threshold.
 #define TEMPERATURE_AMBIENT					50.0		//minimum temperature threshold.
+#define THERMAL_EMERGENCY					0		//Blocks above TEMPERATURE_EMERGENCY raise an urgent report and the parent slows them down (DVFS half) until they cool down.
+#define TEMPERATURE_EMERGENCY					95.0		//block temperature raising an urgent report with THERMAL_EMERGENCY (the parent answers with DVFS half).
+#define TEMPERATURE_EMERGENCY_HYSTERESIS			5.0		//degrees below TEMPERATURE_EMERGENCY to leave the emergency.
 #define QUEUE_FILE_SUFFIX					".queue"
 #define TASK_FILE_SUFFIX					".task"
 #define OUT_FILE_PREFIX						"temperatureRun"
@@ -80,6 +138,19 @@
 #define UNIT_CONTROL_CLOCK                                      500
 #define CHIP_CONTROL_CLOCK                                      500
 
+//Energy representation. Energies are stored as ENERGY_TYPE and only converted
+//back to picojoules at the model boundaries (power and temperature).
+#if ENERGY_FIXED_POINT == 1
+#define ENERGY_TYPE s64
+#define ENERGY_FIXED_POINT_SCALE 1000.0 // femtojoules per picojoule.
+#define ENERGY_FROM_PJ(pj) ((ENERGY_TYPE)((pj)*ENERGY_FIXED_POINT_SCALE + 0.5))
+#define ENERGY_TO_PJ(e)    ((FLOAT_TYPE)(e)/ENERGY_FIXED_POINT_SCALE)
+#else
+#define ENERGY_TYPE FLOAT_TYPE
+#define ENERGY_FROM_PJ(pj) ((ENERGY_TYPE)(pj))
+#define ENERGY_TO_PJ(e)    ((FLOAT_TYPE)(e))
+#endif
+
 typedef struct chip_layout_s
 {
     FLOAT_TYPE chip_height_mm;     /* Chip height in millimeters */
@@ -0,0 +1,332 @@
+/*
+ * Copyright (c) 2014, University of Delaware
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+
+#ifndef _SS_GUIDMAP_GUARD_
+#define _SS_GUIDMAP_GUARD_
+#include "ss-conf.h"
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <cstdlib>
+#include <cstdio>
+#include <assert.h>
+
+/* Sharded open-addressing table keyed by GUID (any non-NULL pointer). */
+//Note: each shard is a linear probing table behind its own spinlock, on its
+//      own cache line, so threads creating EDTs rarely meet. The high bits of
+//      the hash pick the shard and the low bits the slot. Erased slots become
+//      tombstones that are dropped when the shard is rebuilt.
+template <class VALUE, u64 SHARDS = GUID_MAP_SHARDS>
+struct GuidMap
+{
+    static_assert(SHARDS != 0 && (SHARDS & (SHARDS - 1)) == 0, "shard count must be a power of two");
+
+    static const u64 EMPTY = 0;
+    static const u64 TOMBSTONE = 1;
+    static const u64 MIN_CAPACITY = 16;
+
+    struct alignas(CACHE_LINE_SIZE) Shard
+    {
+        std::atomic_flag lock;
+        u64 capacity; // slots, power of two.
+        u64 used;     // live keys plus tombstones.
+        u64 live;
+        u64* keys;
+        VALUE* values;
+    } shard[SHARDS];
+
+    GuidMap()
+    {
+        for (u64 s = 0; s < SHARDS; s++)
+        {
+            shard[s].lock.clear();
+            shard[s].capacity = 0;
+            shard[s].used = 0;
+            shard[s].live = 0;
+            shard[s].keys = NULL;
+            shard[s].values = NULL;
+        }
+    }
+
+    ~GuidMap()
+    {
+        for (u64 s = 0; s < SHARDS; s++)
+        {
+            free(shard[s].keys);
+            free(shard[s].values);
+        }
+    }
+
+    GuidMap(const GuidMap&) = delete;
+    GuidMap& operator=(const GuidMap&) = delete;
+
+    /* Mixes the key bits (pointers are aligned and clustered). */
+    static auto inline hash(u64 key) -> u64
+    {
+        key ^= key >> 33;
+        key *= 0xff51afd7ed558ccdUL;
+        key ^= key >> 33;
+        key *= 0xc4ceb9fe1a85ec53UL;
+        key ^= key >> 33;
+        return key;
+    }
+
+    static auto inline shardOf(u64 h) -> u64
+    {
+        return SHARDS == 1 ? 0 : h >> (64 - __builtin_ctzl(SHARDS));
+    }
+
+    static auto inline lock(Shard& s) -> void
+    {
+        for (u64 spins = 0; s.lock.test_and_set(std::memory_order_acquire); spins++)
+            if (spins > 64)
+                std::this_thread::yield(); // the holder may be descheduled.
+    }
+
+    static auto inline unlock(Shard& s) -> void
+    {
+        s.lock.clear(std::memory_order_release);
+    }
+
+    /* Slot holding the key, or -1. Called with the shard locked. */
+    static auto find(const Shard& s, u64 key, u64 h) -> s64
+    {
+        if (s.capacity == 0)
+            return -1;
+        u64 mask = s.capacity - 1;
+        for (u64 i = h & mask;; i = (i + 1) & mask)
+        {
+            if (s.keys[i] == key)
+                return i;
+            if (s.keys[i] == EMPTY)
+                return -1;
+        }
+    }
+
+    /* Rebuilds a shard with room for extra more keys. Called with the shard locked. */
+    static auto grow(Shard& s, u64 extra) -> void
+    {
+        u64 capacity = s.capacity ? s.capacity : MIN_CAPACITY;
+        while ((s.live + extra) * 2 > capacity)
+            capacity *= 2;
+
+        u64* keys = (u64*) calloc(capacity, sizeof(u64));
+        VALUE* values = (VALUE*) malloc(capacity * sizeof(VALUE));
+        if (keys == NULL || values == NULL)
+        {
+            printf("WARNING: Out of memory for the GUID table!\n");
+            abort();
+        }
+        u64 mask = capacity - 1;
+        for (u64 j = 0; j < s.capacity; j++)
+        {
+            if (s.keys[j] <= TOMBSTONE)
+                continue;
+            u64 i = hash(s.keys[j]) & mask;
+            while (keys[i] != EMPTY)
+                i = (i + 1) & mask;
+            keys[i] = s.keys[j];
+            values[i] = s.values[j];
+        }
+        free(s.keys);
+        free(s.values);
+        s.keys = keys;
+        s.values = values;
+        s.capacity = capacity;
+        s.used = s.live;
+    }
+
+    /* Inserts or replaces. Called with the shard locked. */
+    static auto put(Shard& s, u64 key, u64 h, const VALUE& value) -> void
+    {
+        //Keep the load (tombstones included) under 3/4.
+        if ((s.used + 1) * 4 > s.capacity * 3)
+            grow(s, 1);
+
+        u64 mask = s.capacity - 1;
+        s64 grave = -1;
+        u64 i = h & mask;
+        for (;; i = (i + 1) & mask)
+        {
+            if (s.keys[i] == key)
+            {
+                s.values[i] = value;
+                return;
+            }
+            if (s.keys[i] == EMPTY)
+                break;
+            if (s.keys[i] == TOMBSTONE && grave < 0)
+                grave = i;
+        }
+        if (grave >= 0)
+            i = grave;
+        else
+            s.used++;
+        s.keys[i] = key;
+        s.values[i] = value;
+        s.live++;
+    }
+
+    /* Removes a key. Called with the shard locked. */
+    static auto remove(Shard& s, u64 key, u64 h) -> bool
+    {
+        s64 i = find(s, key, h);
+        if (i < 0)
+            return false;
+        s.keys[i] = TOMBSTONE;
+        s.live--;
+        return true;
+    }
+
+    /* Inserts or replaces the value of a key. */
+    auto insert(const void* guid, const VALUE& value) -> void
+    {
+        u64 key = (u64) guid, h = hash(key);
+        assert(key > TOMBSTONE); // reserved slot markers.
+        Shard& s = shard[shardOf(h)];
+        lock(s);
+        put(s, key, h, value);
+        unlock(s);
+    }
+
+    /* Copies the value of a key out. Returns false if absent. */
+    auto lookup(const void* guid, VALUE& value) -> bool
+    {
+        u64 key = (u64) guid, h = hash(key);
+        Shard& s = shard[shardOf(h)];
+        lock(s);
+        s64 i = find(s, key, h);
+        if (i >= 0)
+            value = s.values[i];
+        unlock(s);
+        return i >= 0;
+    }
+
+    /* Runs f on the value of a key under the shard lock. Returns false if absent. */
+    template <class FUNCTION>
+    auto update(const void* guid, FUNCTION f) -> bool
+    {
+        u64 key = (u64) guid, h = hash(key);
+        Shard& s = shard[shardOf(h)];
+        lock(s);
+        s64 i = find(s, key, h);
+        if (i >= 0)
+            f(s.values[i]);
+        unlock(s);
+        return i >= 0;
+    }
+
+    /* Removes a key. Returns false if absent. */
+    auto erase(const void* guid) -> bool
+    {
+        u64 key = (u64) guid, h = hash(key);
+        Shard& s = shard[shardOf(h)];
+        lock(s);
+        bool found = remove(s, key, h);
+        unlock(s);
+        return found;
+    }
+
+    /* Groups the keys by shard so bulk operations take each lock once. */
+    //Note: returns the key indices ordered by shard; first[s]..first[s+1] are shard s.
+    static auto order(const void* const* guids, u64 count, std::vector<u64>& hashes, std::vector<u64>& first) -> std::vector<u64>
+    {
+        hashes.resize(count);
+        first.assign(SHARDS + 1, 0);
+        for (u64 k = 0; k < count; k++)
+        {
+            hashes[k] = hash((u64) guids[k]);
+            first[shardOf(hashes[k]) + 1]++;
+        }
+        for (u64 s = 0; s < SHARDS; s++)
+            first[s + 1] += first[s];
+        std::vector<u64> next(first.begin(), first.end() - 1);
+        std::vector<u64> indices(count);
+        for (u64 k = 0; k < count; k++)
+            indices[next[shardOf(hashes[k])]++] = k;
+        return indices;
+    }
+
+    /* Inserts or replaces count keys. */
+    auto insertBulk(const void* const* guids, const VALUE* values, u64 count) -> void
+    {
+        std::vector<u64> hashes, first;
+        std::vector<u64> indices = order(guids, count, hashes, first);
+        for (u64 s = 0; s < SHARDS; s++)
+        {
+            if (first[s] == first[s + 1])
+                continue;
+            lock(shard[s]);
+            //Make room for the whole batch at once.
+            if ((shard[s].used + first[s + 1] - first[s]) * 4 > shard[s].capacity * 3)
+                grow(shard[s], first[s + 1] - first[s]);
+            for (u64 j = first[s]; j < first[s + 1]; j++)
+            {
+                assert((u64) guids[indices[j]] > TOMBSTONE); // reserved slot markers.
+                put(shard[s], (u64) guids[indices[j]], hashes[indices[j]], values[indices[j]]);
+            }
+            unlock(shard[s]);
+        }
+    }
+
+    /* Removes count keys. Returns how many were present. */
+    auto eraseBulk(const void* const* guids, u64 count) -> u64
+    {
+        std::vector<u64> hashes, first;
+        std::vector<u64> indices = order(guids, count, hashes, first);
+        u64 erased = 0;
+        for (u64 s = 0; s < SHARDS; s++)
+        {
+            if (first[s] == first[s + 1])
+                continue;
+            lock(shard[s]);
+            for (u64 j = first[s]; j < first[s + 1]; j++)
+                erased += remove(shard[s], (u64) guids[indices[j]], hashes[indices[j]]);
+            unlock(shard[s]);
+        }
+        return erased;
+    }
+
+    /* Live keys (a snapshot when other threads are inserting). */
+    auto size() -> u64
+    {
+        u64 total = 0;
+        for (u64 s = 0; s < SHARDS; s++)
+        {
+            lock(shard[s]);
+            total += shard[s].live;
+            unlock(shard[s]);
+        }
+        return total;
+    }
+};
+#endif
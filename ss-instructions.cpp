@@ -31,6 +31,7 @@
 
 #include "ss-instructions.h"
 #include <cstdlib>
+#include <algorithm>
 
 LookupContainer<InstType> instructionSet;
 LookupContainer<TaskType> taskSet;
@@ -50,84 +51,71 @@ auto initNoopReference() -> void
     noopInstruction = instructionSet.lookup("no_op");
 }
 
-auto parseTask(char* name) -> TaskType
+/* Builds a task from the instruction names returned by next(), INST_PER_MEGA_INST of them per mega instruction. */
+//Note: next(name) returns false once the task has no more instructions.
+template <class NEXT>
+static auto buildTask(const char* name, NEXT next) -> TaskType
 {
-    //Open task file.
-    char inputfile[1024];
-    const char* SAFE_INPUT_DIRPATH = getenv("SAFE_INPUT_DIRPATH");
-    //Set default input path if not specified
-    if (SAFE_INPUT_DIRPATH == 0) {SAFE_INPUT_DIRPATH = "./input"; printf("==> Setting default input folder ./input/ \n");}
-    sprintf (inputfile, "%s/%s%s", SAFE_INPUT_DIRPATH, name, TASK_FILE_SUFFIX);
-    FILE* stream = fopen(inputfile, "r");
-    if(stream == NULL)
-        fatal(inputfile);
-
-    //Read each line of the task file for the details of the task.
     TaskType task;
-    char* line = inputfile; //reuse.
 
     u64 consolidatedInstructions = 0;
     InstType megaInst = {0};
     std::string megaInstName = "";
     u64 numberInstructions = 0;
-    while (fgets(line, 1024, stream))
+    std::string instName;
+    while (next(instName))
     {
-        if(strlen(line) > 0 && line[0] != '\n')
+        //get the instructions' values from the instructionsMap. Check if it is valid instruction.
+        auto id = instructionSet.lookup_id(instName); //lookup id.
+        if ( id != 0 )
         {
-            std::string instName = strtok(line," \t");
+            //grab instruction reference.
+            auto inst = instructionSet.lookup(id);
 
-            //get the instructions' values from the instructionsMap. Check if it is valid instruction.
-            auto id = instructionSet.lookup_id(instName); //lookup id.
-            if ( id != 0 )
-            {
-                //grab instruction reference.
-                auto inst = instructionSet.lookup(id);
+            //Add information to mega instruction.
+            megaInstName += instName;
+            megaInst.type            += inst.type*inst.latency;
+            megaInst.fullStateEnergy += inst.fullStateEnergy;
+            megaInst.halfStateEnergy += inst.halfStateEnergy;
+            megaInst.latency         += inst.latency;
+            megaInst.multiplier      += inst.multiplier;
 
-                //Add information to mega instruction.
-                megaInstName += instName;
-                megaInst.type            += inst.type*inst.latency;
-                megaInst.fullStateEnergy += inst.fullStateEnergy;
-                megaInst.halfStateEnergy += inst.halfStateEnergy;
-                megaInst.latency         += inst.latency;
-                megaInst.multiplier      += inst.multiplier;
+            consolidatedInstructions++; //Mark that we've got an instruction.
+            
+            // Check if mega instruction limit reached.
+            if (consolidatedInstructions == INST_PER_MEGA_INST)
+            {
+                //Consolidate mega instruction.
+                megaInst.latency    /= consolidatedInstructions; // correct latency.
+                megaInst.multiplier /= consolidatedInstructions; // correct multiplier.
+                megaInst.type       /= consolidatedInstructions; // correct type (used to dram port access)
 
-                consolidatedInstructions++; //Mark that we've got an instruction.
+                // Add energy and cycles to task.
+                task.fullEnergy  += ENERGY_TO_PJ(megaInst.fullStateEnergy)*megaInst.latency; //accumulate total possible energy for the task.
+                task.totalCycles += megaInst.latency;
                 
-                // Check if mega instruction limit reached.
-                if (consolidatedInstructions == INST_PER_MEGA_INST)
-                {
-                    //Consolidate mega instruction.
-                    megaInst.latency    /= consolidatedInstructions; // correct latency.
-                    megaInst.multiplier /= consolidatedInstructions; // correct multiplier.
-                    megaInst.type       /= consolidatedInstructions; // correct type (used to dram port access)
-
-                    // Add energy and cycles to task.
-                    task.fullEnergy  += megaInst.fullStateEnergy*megaInst.latency; //accumulate total possible energy for the task.
-                    task.totalCycles += megaInst.latency;
-                    
-                    //Check if mega instruction is part of the instruction set yet if not add.
-                    auto id = instructionSet.lookup_id(megaInstName);
-                    if(id == 0)
-                        id = instructionSet.add(megaInstName, megaInst);
-                    
-                    //Add instruction to the ask.
-                    task.instructions.push_back(id);
-                    
-                    //Reset mega instruction.
-                    megaInstName = "";
-                    megaInst = {0};
-                    consolidatedInstructions = 0;
-                }
-                numberInstructions++;
-            }
-            else
-            {
-                printf("Unknown instruction: %s in Task: %s \n",instName.c_str(),name);
+                //Check if mega instruction is part of the instruction set yet if not add.
+                auto id = instructionSet.lookup_id(megaInstName);
+                if(id == 0)
+                    id = instructionSet.add(megaInstName, megaInst);
+                
+                //Add instruction to the ask.
+                task.instructions.push_back(id);
+                
+                //Reset mega instruction.
+                megaInstName = "";
+                megaInst = {0};
+                consolidatedInstructions = 0;
             }
+            numberInstructions++;
+        }
+        else
+        {
+            printf("Unknown instruction: %s in Task: %s \n",instName.c_str(),name);
         }
     }
     
-    //Check if mega instruction was being built when the file ended and add it to task if so.
+    //Check if mega instruction was being built when the instructions ended and add it to task if so.
     if(consolidatedInstructions != 0)
     {
         //Consolidate mega instruction.
@@ -135,7 +123,7 @@ auto parseTask(char* name) -> TaskType
         megaInst.multiplier /= consolidatedInstructions; // correct multiplier.
         
         // Add energy and cycles to task.
-        task.fullEnergy  += megaInst.fullStateEnergy*megaInst.latency; //accumulate total possible energy for the task.
+        task.fullEnergy  += ENERGY_TO_PJ(megaInst.fullStateEnergy)*megaInst.latency; //accumulate total possible energy for the task.
         task.totalCycles += megaInst.latency;
         
         //Check if mega instruction is part of the instruction set yet if not add.
@@ -151,16 +139,63 @@ auto parseTask(char* name) -> TaskType
     return task;
 }
 
+auto parseTask(char* name) -> TaskType
+{
+    //Open task file.
+    char inputfile[1024];
+    const char* SAFE_INPUT_DIRPATH = getenv("SAFE_INPUT_DIRPATH");
+    //Set default input path if not specified
+    if (SAFE_INPUT_DIRPATH == 0) {SAFE_INPUT_DIRPATH = "./input"; printf("==> Setting default input folder ./input/ \n");}
+    sprintf (inputfile, "%s/%s%s", SAFE_INPUT_DIRPATH, name, TASK_FILE_SUFFIX);
+    FILE* stream = fopen(inputfile, "r");
+    if(stream == NULL)
+        fatal(inputfile);
+
+    //Read each line of the task file for the details of the task.
+    char* line = inputfile; //reuse.
+    TaskType task = buildTask(name, [&](std::string& instName) -> bool
+    {
+        while (fgets(line, 1024, stream))
+        {
+            if(strlen(line) > 0 && line[0] != '\n')
+            {
+                instName = strtok(line," \t");
+                return true;
+            }
+        }
+        return false;
+    });
+    fclose(stream);
+    return task;
+}
+
+/* Prints what the task pool should take to run (TASK_MULTIPLIER times over the chip). */
+static auto printWorkloadEstimates() -> void
+{
+    u64 totalLoadedInstructions = 0;
+    u64 totalCycles             = 0;
+    FLOAT_TYPE totalEnergy      = 0.0;
+    for (auto id : taskPool)
+    {
+        totalLoadedInstructions += taskSet.lookup(id).instructions.size();
+        totalEnergy             += taskSet.lookup(id).fullEnergy;
+        totalCycles             += taskSet.lookup(id).totalCycles;
+    }
+
+    // Print useful stats...;
+    printf("---------------------------\n");
+    printf("* Estimated Total Instructions: %ld\n", totalLoadedInstructions*INST_PER_MEGA_INST*TASK_MULTIPLIER);
+    printf("* Estimated Total Cycles: %ld\n", totalCycles*TASK_MULTIPLIER*INST_PER_MEGA_INST/(N_CORES_IN_BLOCK*N_BLOCKS_IN_UNIT*N_UNITS_IN_CHIP));
+    printf("* Estimated Total Possible Energy (assuming full operation): %f pJ\n", totalEnergy*TASK_MULTIPLIER);
+    printf("* Estimated Avg energy per block (assuming full operation):  %f pJ\n", totalEnergy*TASK_MULTIPLIER/(N_BLOCKS_IN_UNIT*N_UNITS_IN_CHIP));
+    printf("* Estimated Avg Possible temperature differential: %f C\n", estimateTemperature(totalEnergy*TASK_MULTIPLIER/(N_BLOCKS_IN_UNIT*N_UNITS_IN_CHIP), totalCycles*TASK_MULTIPLIER/(N_CORES_IN_BLOCK*N_BLOCKS_IN_UNIT*N_UNITS_IN_CHIP)));
+}
+
 auto parseInputQueue()-> bool
 {
     //Read each line of the queue file for each task.
     char line[1024];
-
-    u64 totalLoadedInstructions=0;
-    u64 loadedInstructions = 0;
-    u64 totalCycles        = 0;
-    FLOAT_TYPE totalEnergy = 0.0;
-    bool loaded            = false;
+    bool loaded = false;
 
     while((!feof(stream)))
     {
@@ -177,30 +212,69 @@ auto parseInputQueue()-> bool
                     id = taskSet.add(name, parseTask(name));
                 }
 
-                // Grab statistics.
-                loadedInstructions += taskSet.lookup(id).instructions.size();
-                totalEnergy        += taskSet.lookup(id).fullEnergy;
-                totalCycles        += taskSet.lookup(id).totalCycles;
-
                 // Push task ID in task pool.
                 taskPool.push_back(id);
                 loaded=true;
             }
         }
     }
-    totalLoadedInstructions+=loadedInstructions;
     initNoopReference(); //static reference to noop
-   
-    // Print useful stats...;
-    printf("---------------------------\n");
-    printf("* Estimated Total Instructions: %ld\n", totalLoadedInstructions*INST_PER_MEGA_INST*TASK_MULTIPLIER);
-    printf("* Estimated Total Cycles: %ld\n", totalCycles*TASK_MULTIPLIER*INST_PER_MEGA_INST/(N_CORES_IN_BLOCK*N_BLOCKS_IN_UNIT*N_UNITS_IN_CHIP));
-    printf("* Estimated Total Possible Energy (assuming full operation): %f pJ\n", totalEnergy*TASK_MULTIPLIER);
-    printf("* Estimated Avg energy per block (assuming full operation):  %f pJ\n", totalEnergy*TASK_MULTIPLIER/(N_BLOCKS_IN_UNIT*N_UNITS_IN_CHIP));
-    printf("* Estimated Avg Possible temperature differential: %f C\n", estimateTemperature(totalEnergy*TASK_MULTIPLIER/(N_BLOCKS_IN_UNIT*N_UNITS_IN_CHIP), totalCycles*TASK_MULTIPLIER/(N_CORES_IN_BLOCK*N_BLOCKS_IN_UNIT*N_UNITS_IN_CHIP)));
+    printWorkloadEstimates();
     return loaded;
 }
 
+/* Instruction mixes of the synthetic workloads -- each instruction is drawn uniformly from its list. */
+//Note: the names are rows of the instruction table; dram and dram-bulk are the
+//      type 3 instructions holding a DRAM port of the unit.
+static const struct
+{
+    const char* name;
+    const char* instructions[8];
+} syntheticMixes[] =
+{
+    {"compute", {"arith-simple_int", "arith-simple_fp", "arith-adv_int", "fma_int", "fma_fp", "bitops", "div_int", "sincos_fp"}},
+    {"dram",    {"dram", "dram-bulk", "dram", "dram-bulk", "dram", "dram-bulk", "arith-simple_int", "bitops"}},
+    {"mixed",   {"arith-simple_int", "bitops", "cache", "div_int", "dram", "fma_fp", "lmem", "sincos_fp"}},
+};
+
+/* Fills the task pool with a generated workload (compute, dram or mixed) instead of a queue file. */
+//Note: the instructions come from a fixed seed LCG so every run and host gets
+//      the same tasks. The queue cycles through the SYNTHETIC_TASKS tasks.
+auto generateSyntheticQueue(const char* kind) -> bool
+{
+    for (auto& mix : syntheticMixes)
+    {
+        if (strcmp(mix.name, kind) != 0)
+            continue;
+
+        printf("==> Generating the synthetic '%s' workload...\n", kind);
+        u64 seed = 1;
+        ID_TYPE ids[SYNTHETIC_TASKS];
+        for (u64 t = 0; t < SYNTHETIC_TASKS; t++)
+        {
+            char name[MAX_STR_SZ];
+            snprintf(name, sizeof(name), "%s%lu", kind, t);
+            u64 count = 0;
+            ids[t] = taskSet.add(name, buildTask(name, [&](std::string& instName) -> bool
+            {
+                if (count++ == SYNTHETIC_TASK_LENGTH)
+                    return false;
+                seed = seed*6364136223846793005UL + 1442695040888963407UL;
+                instName = mix.instructions[(seed >> 33) % 8];
+                return true;
+            }));
+        }
+        for (u64 q = 0; q < SYNTHETIC_QUEUE_LENGTH; q++)
+            taskPool.push_back(ids[q % SYNTHETIC_TASKS]);
+
+        initNoopReference(); //static reference to noop
+        printWorkloadEstimates();
+        return true;
+    }
+    printf("WARNING: unknown synthetic workload '%s' (compute, dram or mixed).\n", kind);
+    return false;
+}
+
 auto openInstructionsFile(char * name) -> bool
 {
   //Open queue file.
@@ -275,14 +349,14 @@ auto readInstructionsTable() -> bool
                 // for FULL state.
                 inst.type = 0;
                 inst.multiplier=latency; //store full state latency as the multiplier for the instruction.
-                inst.fullStateEnergy=totalEnergy*(1+STATIC_ENERGY_FACTOR_FULL);
+                inst.fullStateEnergy=ENERGY_FROM_PJ(totalEnergy*(1+STATIC_ENERGY_FACTOR_FULL));
             }
             else if (type==1)
             {
                 // for actual NTV state.
                 inst.type = 0;
                 inst.latency=latency; // Store half state value as actual latency for the instruction.
-                inst.halfStateEnergy=totalEnergy*(1+STATIC_ENERGY_FACTOR_HALF);
+                inst.halfStateEnergy=ENERGY_FROM_PJ(totalEnergy*(1+STATIC_ENERGY_FACTOR_HALF));
             }
             else if (type==2)
             {
@@ -290,8 +364,8 @@ auto readInstructionsTable() -> bool
                 inst.type = 0;
                 inst.latency=latency; // Store the actual latency for the instruction.
                 inst.multiplier=1; // Store multiplier as 1 so the time is the same regardless of NTV state.
-                inst.fullStateEnergy=totalEnergy; // store the same energy for both full and half.
-                inst.halfStateEnergy=totalEnergy;
+                inst.fullStateEnergy=ENERGY_FROM_PJ(totalEnergy); // store the same energy for both full and half.
+                inst.halfStateEnergy=ENERGY_FROM_PJ(totalEnergy);
             }
             else if (type==3)
             {
@@ -299,15 +373,17 @@ auto readInstructionsTable() -> bool
                 inst.type = 1;
                 inst.latency=latency; // Store the actual latency for the instruction.
                 inst.multiplier=1; // Store multiplier as 1 so the time is the same regardless of NTV state.
-                inst.fullStateEnergy=totalEnergy; // store the same energy for both full and half.
-                inst.halfStateEnergy=totalEnergy;
+                inst.fullStateEnergy=ENERGY_FROM_PJ(totalEnergy); // store the same energy for both full and half.
+                inst.halfStateEnergy=ENERGY_FROM_PJ(totalEnergy);
             }
             
             if (inst.multiplier && inst.latency)
             {
-                inst.fullStateEnergy /= (inst.latency / inst.multiplier); // full state energy is divided over the number of 'full' state cycles.
-                inst.halfStateEnergy /= inst.latency;                     // half state energy is divided over the number of 'half' state cycles or total latency.
-                printf("  * Found instruction\t%16s\tenergy: %7.5f, %7.5f\n", op, inst.fullStateEnergy, inst.halfStateEnergy);
+                //Note: divided in picojoules and converted back once, so fixed-point energies are rounded instead of truncated.
+                s64 fullStateCycles = std::max<s64>(1, inst.latency / inst.multiplier); // a full state instruction takes at least one cycle.
+                inst.fullStateEnergy = ENERGY_FROM_PJ(ENERGY_TO_PJ(inst.fullStateEnergy) / fullStateCycles); // full state energy is divided over the number of 'full' state cycles.
+                inst.halfStateEnergy = ENERGY_FROM_PJ(ENERGY_TO_PJ(inst.halfStateEnergy) / inst.latency);   // half state energy is divided over the number of 'half' state cycles or total latency.
+                printf("  * Found instruction\t%16s\tenergy: %7.5f, %7.5f\n", op, ENERGY_TO_PJ(inst.fullStateEnergy), ENERGY_TO_PJ(inst.halfStateEnergy));
             }
          }
       }
@@ -322,9 +398,9 @@ auto verifyInstructionsTable() -> void
     {
         auto inst = instructionSet.lookup(id);
         if (inst.multiplier == 0 || inst.latency == 0 ||
-            inst.fullStateEnergy == 0.0 || inst.halfStateEnergy == 0.0)
+            inst.fullStateEnergy == 0 || inst.halfStateEnergy == 0)
             printf("\n  * Error verifying instruction id %d: multiplier %ld, latency %ld, full energy %f, half energy %f...\n",
-                   id, inst.multiplier, inst.latency, inst.fullStateEnergy, inst.halfStateEnergy);
+                   id, inst.multiplier, inst.latency, ENERGY_TO_PJ(inst.fullStateEnergy), ENERGY_TO_PJ(inst.halfStateEnergy));
     }
 }
 
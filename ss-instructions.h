@@ -33,6 +33,7 @@
 #define _SS_INSTRUCTIONS_GUARD_
 #include "ss-conf.h"
 #include "ss-temp.h"
+#include "ss-arena.h"
 #include <deque>
 #include <map>
 #include <unordered_map>
@@ -47,8 +48,8 @@
 typedef struct __attribute__ ((__packed__)) InstType
 {
     s64 type;
-    FLOAT_TYPE halfStateEnergy; //Energy to get from half state.
-    FLOAT_TYPE fullStateEnergy; //Energy numbers for task at full frequency.
+    ENERGY_TYPE halfStateEnergy; //Energy to get from half state.
+    ENERGY_TYPE fullStateEnergy; //Energy numbers for task at full frequency.
     s64 latency;     //latency of the instruction.
     s64 multiplier;  //decrease factor for the task in full state energy.
 } InstType;
@@ -56,13 +57,13 @@ typedef struct __attribute__ ((__packed__)) InstType
 /* Anatomy of a task in the simulator. */
 typedef struct TaskType
 {
-    std::vector<ID_TYPE> instructions; //set of instructions of the task.
+    ArenaVector<ID_TYPE> instructions; //set of instructions of the task.
     FLOAT_TYPE fullEnergy = 0.0;       //energy assuming task is run at full freq.
     u64 totalCycles = 0;               //total cycles of the task assuming full freq.
 } TaskType;
 
 /* Anatomy of a task queue in the simulator. */
-typedef std::vector<ID_TYPE> TaskQueueType;
+typedef ArenaVector<ID_TYPE> TaskQueueType;
 /* Map of task types -- so we don't re-parse. */
 
 /* Combined map and set for looking IDs from instructions/tasks from name or hash */
@@ -70,8 +71,8 @@ template <class TYPE>
 class LookupContainer
 {
     public:
-        std::unordered_map<std::size_t, ID_TYPE> map;
-        std::vector<TYPE> set;
+        ArenaUnorderedMap<std::size_t, ID_TYPE> map;
+        ArenaVector<TYPE> set;
     
     // During initialization, fill the first spot (0) as empty in the container.
     LookupContainer()
@@ -171,6 +172,7 @@ extern FILE* instructionTableFile;
 extern u64 totalLoadedInstructions;
 extern TaskQueueType taskPool;
 auto parseInputQueue()-> bool;
+auto generateSyntheticQueue(const char* kind) -> bool;
 auto parseTask(char* name) -> TaskType;
 auto openInstructionsFile(char * name) -> bool;
 auto closeInstructionsFile() -> void;
@@ -0,0 +1,244 @@
+/*
+ * Copyright (c) 2014, University of Delaware
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "ss-live.h"
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <csignal>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+auto liveName(u64 pid) -> std::string
+{
+    const char* SAFE_LIVE_NAME = getenv("SAFE_LIVE_NAME");
+    return SAFE_LIVE_NAME ? SAFE_LIVE_NAME : LIVE_NAME "-" + std::to_string(pid);
+}
+
+auto liveAttach(const char* name) -> LiveRegion*
+{
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0)
+        return NULL;
+    struct stat status;
+    void* memory = MAP_FAILED;
+    if (fstat(fd, &status) == 0 && (u64) status.st_size >= sizeof(LiveRegion))
+        memory = mmap(NULL, status.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (memory == MAP_FAILED)
+        return NULL;
+    LiveRegion* region = (LiveRegion*) memory;
+    if (memcmp(region->header.magic, LIVE_MAGIC, sizeof(region->header.magic)) != 0 ||
+        region->header.size != (u64) status.st_size || LiveRegion::size(region->header.agents) != region->header.size)
+    {
+        munmap(memory, status.st_size);
+        return NULL;
+    }
+    return region;
+}
+
+//Note: the copy may race with the writer; it is only kept if the sequence
+//      did not move (and was even) around it. A sequence that stays odd is
+//      a writer killed in the middle of a write once its pid is gone.
+auto liveRead(LiveRegion* region, LiveState& state, double* temperature, double* power) -> LiveReadStatus
+{
+    const u64 agents = region->header.agents;
+    for (u64 retry = 0; retry < LIVE_READ_RETRIES; retry++)
+    {
+        u64 before = region->sequence.load(std::memory_order_acquire);
+        if (before & 1)
+        {
+            std::this_thread::yield();
+            continue;
+        }
+        memcpy(&state, &region->state, sizeof(LiveState));
+        memcpy(temperature, region->temperature(), agents*sizeof(double));
+        memcpy(power, region->power(), agents*sizeof(double));
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (region->sequence.load(std::memory_order_relaxed) == before)
+            return LIVE_READ_OK;
+    }
+    if (kill(region->header.pid, 0) != 0 && errno == ESRCH)
+        return LIVE_READ_STALE;
+    return LIVE_READ_BUSY;
+}
+
+auto livePrint(FILE* file, const LiveState& state, const double* temperature, const double* power, u64 agents, u64 blocksInUnit) -> void
+{
+    fprintf(file, "tasks left to execute:   %ld (temperature: %f C)...\n", state.tasksLeft, state.chipTemperature);
+    fprintf(file, "current simulation time: %f ms...\n", state.simulatedMs);
+    fprintf(file, "cycle count:             %ld\n", state.cycle);
+    fprintf(file, "total power (agg : real): %fW : %fW < %fW\n", state.chipPowerAggregate, state.chipPower, state.chipPowerGoal);
+    fprintf(file, "unit 0 power (agg : real): %fW : %fW < goal: %fW\n", state.unitPowerAggregate, state.unitPower, state.unitPowerGoal);
+    fprintf(file, "blk 0 power (real): %fW < goal: %fW\n", power[0], state.blockPowerGoal);
+    fprintf(file, "blk temperature (min : avg : max): %f C : %f C : %f C\n", state.temperatureMin, state.temperatureAvg, state.temperatureMax);
+    fprintf(file, "---------------------------\n");
+
+    //Blocks as laid out on the chip, unit borders between them.
+    u64 blockWidth = sqrt(blocksInUnit), unitWidth = sqrt(agents/blocksInUnit), side = blockWidth*unitWidth;
+    std::string border = "  " + std::string(side*6 + (unitWidth + 1)*3 - 2, '-') + "\n";
+    fputs(border.c_str(), file);
+    for (u64 row = 0; row < side; row++)
+    {
+        fprintf(file, " | ");
+        for (u64 col = 0; col < side; col++)
+        {
+            u64 unit = row/blockWidth*unitWidth + col/blockWidth;
+            u64 block = row%blockWidth*blockWidth + col%blockWidth;
+            fprintf(file, "%05.1f ", temperature[unit*blocksInUnit + block]);
+            if (col%blockWidth == blockWidth - 1 && col != side - 1)
+                fprintf(file, " | ");
+        }
+        fprintf(file, " | \n");
+        if (row%blockWidth == blockWidth - 1)
+            fputs(border.c_str(), file);
+    }
+    fflush(file);
+}
+
+/* Region of this run and its LIVE_PRINT thread. */
+static struct
+{
+    LiveRegion* region;
+    std::string name;   // of the shared memory object, empty if private.
+    std::thread printer;
+    std::mutex lock;
+    std::condition_variable wake;
+    bool stopping;
+} live;
+
+#if LIVE_PRINT == 1
+/* Prints the state every LIVE_PRINT_INTERVAL ms once it changed. */
+static auto livePrinter() -> void
+{
+    const u64 agents = live.region->header.agents;
+    std::vector<double> temperature(agents), power(agents);
+    LiveState state;
+    u64 printed = -1UL;
+    std::unique_lock<std::mutex> lock(live.lock);
+    while (!live.wake.wait_for(lock, std::chrono::milliseconds(LIVE_PRINT_INTERVAL), [] { return live.stopping; }))
+    {
+        u64 sequence = live.region->sequence.load(std::memory_order_acquire);
+        if (sequence == printed || sequence == 0)
+            continue; // nothing new.
+        if (liveRead(live.region, state, temperature.data(), power.data()) != LIVE_READ_OK)
+            continue; // agent 0 is in the middle of a write, next time.
+        printed = sequence;
+        livePrint(stdout, state, temperature.data(), power.data(), agents, live.region->header.blocksInUnit);
+    }
+}
+#endif
+
+auto liveStart() -> void
+{
+    const u64 agents = N_UNITS_IN_CHIP*N_BLOCKS_IN_UNIT;
+    const u64 size = LiveRegion::size(agents);
+    void* memory = MAP_FAILED;
+    #if LIVE == 1
+    //Note: never reuses an object -- another run (or the leftover of a killed
+    //      one) may still own it.
+    const std::string name = liveName(getpid());
+    int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, S_IRUSR | S_IWUSR);
+    if (fd < 0)
+        printf("WARNING: cannot create the shared memory object %s (%s), the live state is not published.\n", name.c_str(), strerror(errno));
+    else
+    {
+        if (ftruncate(fd, size) == 0)
+            memory = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if (memory == MAP_FAILED)
+        {
+            printf("WARNING: cannot map the shared memory object %s (%s), the live state is not published.\n", name.c_str(), strerror(errno));
+            shm_unlink(name.c_str());
+        }
+        else
+            live.name = name;
+    }
+    #endif
+    if (memory == MAP_FAILED)
+        memory = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED)
+    {
+        perror("mmap");
+        exit(1);
+    }
+
+    live.region = (LiveRegion*) memory; // zeroed.
+    live.region->header.agents = agents;
+    live.region->header.blocksInUnit = N_BLOCKS_IN_UNIT;
+    live.region->header.pid = getpid();
+    live.region->header.size = size;
+    std::atomic_thread_fence(std::memory_order_release);
+    memcpy(live.region->header.magic, LIVE_MAGIC, sizeof(live.region->header.magic));
+    #if LIVE_PRINT == 1
+    live.printer = std::thread(&livePrinter);
+    #endif
+}
+
+auto liveWriteBegin() -> LiveRegion*
+{
+    live.region->sequence.store(live.region->sequence.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    return live.region;
+}
+
+auto liveWriteEnd() -> void
+{
+    live.region->sequence.store(live.region->sequence.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+auto liveProgress() -> void
+{
+    LiveRegion* region = live.region;
+    livePrint(stdout, region->state, region->temperature(), region->power(), region->header.agents, region->header.blocksInUnit);
+}
+
+auto liveStop() -> void
+{
+    {
+        std::lock_guard<std::mutex> lock(live.lock);
+        live.stopping = true;
+    }
+    live.wake.notify_all();
+    if (live.printer.joinable())
+        live.printer.join();
+    if (!live.name.empty())
+        shm_unlink(live.name.c_str());
+}
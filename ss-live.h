@@ -0,0 +1,120 @@
+/*
+ * Copyright (c) 2014, University of Delaware
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef _SS_LIVE_GUARD_
+#define _SS_LIVE_GUARD_
+#include "ss-conf.h"
+#include <atomic>
+#include <cstdio>
+#include <string>
+
+/* Live state of a run (LIVE): agent 0 publishes it at every progress point of
+ * the simulation and readers (the LIVE_PRINT thread, safe-top) copy it out
+ * under a seqlock, so neither side ever waits for the other. With LIVE the
+ * region is the POSIX shared memory object LIVE_NAME-<pid> of the run, owner
+ * read/write only (SAFE_LIVE_NAME in the environment overrides the name),
+ * otherwise it is private to the process.
+ *
+ *   LiveHeader, sequence, LiveState, temperature[agents], power[agents] */
+#define LIVE_MAGIC "SAFELIV1"
+
+struct LiveHeader
+{
+    char magic[8];    // written last, once the region is initialized.
+    u64 agents;
+    u64 blocksInUnit;
+    u64 pid;          // of the run.
+    u64 size;         // of the region in bytes.
+};
+
+/* Published state -- copied out by the readers. */
+struct LiveState
+{
+    u64 cycle;
+    double simulatedMs;
+    u64 tasksLeft;
+    u64 done;                  // the run is over.
+    double temperatureMin;     // of the blocks.
+    double temperatureAvg;
+    double temperatureMax;
+    double chipTemperature;    // as aggregated by the chip role.
+    double chipPowerAggregate; // as aggregated by the chip role...
+    double chipPower;          // ...and the sum of the blocks.
+    double chipPowerGoal;
+    double unitPowerAggregate; // unit 0.
+    double unitPower;
+    double unitPowerGoal;
+    double blockPowerGoal;     // block 0.
+};
+
+struct LiveRegion
+{
+    LiveHeader header;
+    alignas(CACHE_LINE_SIZE) std::atomic<u64> sequence; // odd while agent 0 writes.
+    LiveState state;
+
+    auto temperature() -> double* { return (double*) (this + 1); }
+    auto power() -> double* { return temperature() + header.agents; }
+    static auto size(u64 agents) -> u64 { return sizeof(LiveRegion) + 2*agents*sizeof(double); }
+};
+
+/* Name of the shared memory object of the run pid. */
+auto liveName(u64 pid) -> std::string;
+
+/* Attaches read-only to the region of a running simulation -- NULL if there is none. */
+auto liveAttach(const char* name) -> LiveRegion*;
+
+enum LiveReadStatus
+{
+    LIVE_READ_OK,    // consistent copy.
+    LIVE_READ_BUSY,  // the writer held the region for LIVE_READ_RETRIES tries, nothing copied.
+    LIVE_READ_STALE  // the writer died in the middle of a write, nothing copied.
+};
+
+/* Copies a consistent state (and the block values) out of the region. */
+auto liveRead(LiveRegion* region, LiveState& state, double* temperature, double* power) -> LiveReadStatus;
+
+/* Prints a state: progress, powers and the temperature grid. */
+auto livePrint(FILE* file, const LiveState& state, const double* temperature, const double* power, u64 agents, u64 blocksInUnit) -> void;
+
+/* Creates the region and starts the LIVE_PRINT thread -- before the engines. */
+auto liveStart() -> void;
+
+/* Region the state is written to, between liveWriteBegin and liveWriteEnd (agent 0 only). */
+auto liveWriteBegin() -> LiveRegion*;
+auto liveWriteEnd() -> void;
+
+/* Prints the last state to stdout from the writer -- the progress printout without LIVE_PRINT (agent 0 only). */
+auto liveProgress() -> void;
+
+/* Stops the LIVE_PRINT thread and removes the region -- after the last state. */
+auto liveStop() -> void;
+#endif
@@ -0,0 +1,288 @@
+/*
+ * Copyright (c) 2014, University of Delaware
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "ss-log.h"
+#include "ss-instructions.h"
+#include "ss-msr.h"
+#include "ss-ring.h"
+#include "ss-series.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <new>
+#include <thread>
+
+#if LOGGING_LEVEL == 1
+static auto logsPath() -> const char*
+{
+    const char* SAFE_LOGS_PATH = getenv("SAFE_LOGS_PATH");
+    return SAFE_LOGS_PATH ? SAFE_LOGS_PATH : "./logs";
+}
+
+#if LOG_ASYNC == 1
+/* Records of one engine thread on their way to the writer. */
+struct alignas(CACHE_LINE_SIZE) LogRing
+{
+    SpscRing<LogRecord, LOG_RING_DEPTH> ring;
+    u64 stalls; // times the thread found the ring full (producer side).
+};
+
+static thread_local LogRing* logRing;
+static thread_local u32 logAgent;
+
+/* Rings of every engine thread -- indexed by agent id, published as they register. */
+static std::atomic<LogRing*> logRings[N_UNITS_IN_CHIP*N_BLOCKS_IN_UNIT];
+
+/* Writer state -- only touched by the writer thread between logStart and logStop. */
+static struct
+{
+    FILE* file;
+    std::thread thread;
+    std::atomic<bool> stopping;
+    LogSegmentHeader header;
+    LogRecord record[LOG_SEGMENT_RECORDS];
+    u64 records;  // written in total.
+    u64 segments;
+    #if LOG_SERIES == 1
+    SeriesWriter series;
+    std::map<u64, std::vector<double>> samples; // rows being gathered, by cycle (NaN until logged).
+    std::map<u64, u64> sampled;                 // values of each.
+    u64 logged[N_UNITS_IN_CHIP*N_BLOCKS_IN_UNIT];  // cycles before this one each block logged both values of.
+    bool ended[N_UNITS_IN_CHIP*N_BLOCKS_IN_UNIT];  // the block logs no more samples.
+    #endif
+} logWriter;
+
+static auto logWriteSegment() -> void
+{
+    if (logWriter.header.records == 0)
+        return;
+    fwrite(&logWriter.header, sizeof(LogSegmentHeader), 1, logWriter.file);
+    fwrite(logWriter.record, sizeof(LogRecord), logWriter.header.records, logWriter.file);
+    logWriter.records += logWriter.header.records;
+    logWriter.segments++;
+    logWriter.header = {LOG_SEGMENT_MAGIC, 0, ULONG_MAX, 0};
+}
+
+static auto logAppend(const LogRecord& record) -> void
+{
+    LogSegmentHeader& header = logWriter.header;
+    logWriter.record[header.records] = record;
+    header.firstCycle = std::min(header.firstCycle, record.cycle);
+    header.lastCycle  = std::max(header.lastCycle, record.cycle);
+    if (++header.records == LOG_SEGMENT_RECORDS)
+        logWriteSegment();
+}
+
+#if LOG_SERIES == 1
+/* Cycles before this one every block still logging has logged both values of -- ULONG_MAX once all ended. */
+static auto logSampledFrontier() -> u64
+{
+    u64 frontier = ULONG_MAX;
+    for (u64 id=0; id<N_UNITS_IN_CHIP*N_BLOCKS_IN_UNIT; id++)
+        if (!logWriter.ended[id])
+            frontier = std::min(frontier, logWriter.logged[id]);
+    return frontier;
+}
+
+/* Writes the gathered rows -- up to the first incomplete one the blocks still logging may fill, or all of them. */
+//Note: every block samples the same cycles in order, so rows complete in order.
+//      A row no block can add to any more is written with NaN for the missing
+//      values, so a block that stops early does not hold back the later rows.
+static auto logWriteSamples(bool all) -> void
+{
+    const u64 agents = N_UNITS_IN_CHIP*N_BLOCKS_IN_UNIT;
+    auto& samples = logWriter.samples;
+    while (!samples.empty() && (all || logWriter.sampled[samples.begin()->first] == 2*agents ||
+                                samples.begin()->first < logSampledFrontier()))
+    {
+        const double* value = samples.begin()->second.data();
+        logWriter.series.append(samples.begin()->first, value, value + agents);
+        logWriter.sampled.erase(samples.begin()->first);
+        samples.erase(samples.begin());
+    }
+}
+
+/* Adds a temperature or power record to the row of its cycle. */
+static auto logSample(const LogRecord& record) -> void
+{
+    const u64 agents = N_UNITS_IN_CHIP*N_BLOCKS_IN_UNIT;
+    std::vector<double>& row = logWriter.samples[record.cycle];
+    if (row.empty())
+        row.assign(2*agents, NAN);
+    row[(record.event == LOG_POWER ? agents : 0) + record.agent] = record.value[0].f;
+    if (record.event == LOG_POWER)
+        logWriter.logged[record.agent] = record.cycle + 1; // logged after the temperature.
+    if (++logWriter.sampled[record.cycle] == 2*agents)
+        logWriteSamples(false);
+}
+#endif
+
+/* Drains the rings into segments until logStop. */
+//Note: stopping is read before a pass, so the pass that sees it drains
+//      everything logged before it was set.
+static auto logDrain() -> void
+{
+    for (;;)
+    {
+        bool stopping = logWriter.stopping.load(std::memory_order_acquire);
+        u64 drained = 0;
+        for (u64 id=0; id<N_UNITS_IN_CHIP*N_BLOCKS_IN_UNIT; id++)
+        {
+            LogRing* ring = logRings[id].load(std::memory_order_acquire);
+            if (ring == NULL)
+                continue;
+            LogRecord record;
+            while (ring->ring.pop(record))
+            {
+                drained++;
+                #if LOG_SERIES == 1
+                if (record.event == LOG_TEMPERATURE || record.event == LOG_POWER)
+                {
+                    logSample(record);
+                    continue;
+                }
+                if (record.event == LOG_SAMPLES_END)
+                {
+                    logWriter.ended[record.agent] = true;
+                    logWriteSamples(false);
+                    continue;
+                }
+                #endif
+                logAppend(record);
+            }
+        }
+        if (drained == 0)
+        {
+            if (stopping)
+                break;
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+    logWriteSegment();
+    #if LOG_SERIES == 1
+    logWriteSamples(true);
+    #endif
+}
+
+auto logStart() -> void
+{
+    char name[1024];
+    snprintf(name, sizeof(name), "%s/%s", logsPath(), LOG_FILE);
+    if ((logWriter.file = fopen(name, "w")) == NULL)
+        fatal(name);
+    LogFileHeader header = {{}, sizeof(LogRecord), N_UNITS_IN_CHIP*N_BLOCKS_IN_UNIT, N_BLOCKS_IN_UNIT};
+    memcpy(header.magic, LOG_FILE_MAGIC, sizeof(header.magic));
+    fwrite(&header, sizeof(LogFileHeader), 1, logWriter.file);
+    logWriter.header = {LOG_SEGMENT_MAGIC, 0, ULONG_MAX, 0};
+    #if LOG_SERIES == 1
+    snprintf(name, sizeof(name), "%s/%s", logsPath(), LOG_SERIES_FILE);
+    if (!logWriter.series.open(name, N_UNITS_IN_CHIP*N_BLOCKS_IN_UNIT, N_BLOCKS_IN_UNIT))
+        fatal(name);
+    #endif
+    logWriter.thread = std::thread(&logDrain);
+}
+
+auto logRegister(u64 id) -> void
+{
+    void* region = NULL;
+    if (posix_memalign(&region, CACHE_LINE_SIZE, sizeof(LogRing)) != 0)
+        fatal("posix_memalign");
+    logRing  = new (region) LogRing(); // first touched by the engine thread.
+    logAgent = id;
+    logRings[id].store(logRing, std::memory_order_release);
+}
+
+auto logEvent(u64 event, LogValue a, LogValue b, LogValue c) -> void
+{
+    LogRecord record = {readClockMSR()*INST_PER_MEGA_INST, logAgent, (u32) event, {a, b, c}};
+    while (!logRing->ring.push(record))
+    {
+        logRing->stalls++;
+        std::this_thread::yield();
+    }
+}
+
+auto logClose() -> void {}
+
+auto logStop() -> void
+{
+    logWriter.stopping.store(true, std::memory_order_release);
+    logWriter.thread.join();
+    fclose(logWriter.file);
+    #if LOG_SERIES == 1
+    logWriter.series.close();
+    #endif
+
+    u64 stalls = 0;
+    for (u64 id=0; id<N_UNITS_IN_CHIP*N_BLOCKS_IN_UNIT; id++)
+        if (logRings[id])
+            stalls += logRings[id].load()->stalls;
+    printf("==> Log: %ld records in %ld segments written to %s/%s (safe-log2text converts it to the block logs).\n",
+           logWriter.records, logWriter.segments, logsPath(), LOG_FILE);
+    #if LOG_SERIES == 1
+    printf("==> Log: %ld samples in %ld blocks (%ld bytes) written to %s/%s.\n",
+           logWriter.series.rows, logWriter.series.index.size(), logWriter.series.bytes, logsPath(), LOG_SERIES_FILE);
+    #endif
+    if (stalls)
+        printf("WARNING: threads waited %ld times for the log writer, LOG_RING_DEPTH may be too small.\n", stalls);
+}
+#else
+static thread_local FILE* logFile;
+
+auto logStart() -> void {}
+
+auto logRegister(u64 id) -> void
+{
+    char name[1024];
+    logFileName(name, sizeof(name), logsPath(), id, N_BLOCKS_IN_UNIT);
+    if ((logFile = fopen(name, "w")) == NULL)
+        fatal(name);
+}
+
+auto logEvent(u64 event, LogValue a, LogValue b, LogValue c) -> void
+{
+    LogRecord record = {readClockMSR()*INST_PER_MEGA_INST, 0, (u32) event, {a, b, c}};
+    logFormat(logFile, record);
+}
+
+auto logClose() -> void
+{
+    fclose(logFile);
+}
+
+auto logStop() -> void {}
+#endif
+#endif
@@ -0,0 +1,176 @@
+/*
+ * Copyright (c) 2014, University of Delaware
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef _SS_LOG_GUARD_
+#define _SS_LOG_GUARD_
+#include "ss-conf.h"
+#include <cstdio>
+
+/* Events of the block logs. */
+//Note: the values are part of the LOG_FILE format -- only append new ones.
+enum LogEvent
+{
+    LOG_BLOCK_LAYOUT,            // blocks per unit (height, width).
+    LOG_UNIT_LAYOUT,             // units per chip (height, width).
+    LOG_TEMPERATURE,             // block temperature (C).
+    LOG_POWER,                   // block power (W).
+    LOG_CHIP_POWER_GOAL,         // new chip power goal (W).
+    LOG_UNIT_POWER_GOAL,         // new unit power goal (W).
+    LOG_BLOCK_POWER_GOAL,        // new block power goal (W).
+    LOG_BLOCK_UNDER_CONTROL,     // new under control flag.
+    LOG_STATE_CHANGE,            // XE state (1 full, 0 half).
+    LOG_EMERGENCY,               // emergency raised at the temperature (C).
+    LOG_EMERGENCY_DVFS,          // emergency answered after the cycles.
+    LOG_SYNC_QUANTUM,            // new sync quantum in cycles (gradient C, drift C per Mcycle).
+    LOG_SAMPLES_END,             // the block logs no more temperatures and powers (not in the text logs).
+    LOG_EVENTS
+};
+
+/* Argument of a log record. */
+struct LogValue
+{
+    union
+    {
+        double f;
+        u64 u;
+    };
+    LogValue() : u(0) {}
+    LogValue(double value) : f(value) {}
+    LogValue(u64 value) : u(value) {}
+};
+
+/* One fixed size log record. */
+struct LogRecord
+{
+    u64 cycle;      // simulated cycle of the event.
+    u32 agent;
+    u32 event;      // LogEvent.
+    LogValue value[3];
+};
+static_assert(sizeof(LogRecord) == 40, "LogRecord is part of the LOG_FILE format");
+
+/* LOG_FILE starts with a header and is followed by segments of records, each
+ * with its own header. Records of a segment are in the order the writer drained
+ * them: per agent in program order, agents interleaved. */
+#define LOG_FILE_MAGIC    "SAFELOG1"
+#define LOG_SEGMENT_MAGIC 0x544e454d47455300UL // "\0SEGMENT"
+
+struct LogFileHeader
+{
+    char magic[8];
+    u64 recordSize;
+    u64 agents;       // N_UNITS_IN_CHIP*N_BLOCKS_IN_UNIT.
+    u64 blocksInUnit; // N_BLOCKS_IN_UNIT.
+};
+
+struct LogSegmentHeader
+{
+    u64 magic;
+    u64 records;
+    u64 firstCycle;   // smallest cycle of the records.
+    u64 lastCycle;    // largest.
+};
+
+/* Text log file of a block -- the name the analysis scripts expect. */
+auto inline logFileName(char* name, u64 size, const char* path, u64 id, u64 blocksInUnit) -> void
+{
+    snprintf(name, size, "%s/%s.log.brd00.chp00.unt%02lu.blk%02lu", path, OUT_FILE_PREFIX, id/blocksInUnit, id%blocksInUnit);
+}
+
+/* Writes the text line of a record (shared by the engine and safe-log2text). */
+auto inline logFormat(FILE* file, const LogRecord& record) -> void
+{
+    const LogValue* value = record.value;
+    switch (record.event)
+    {
+        case LOG_BLOCK_LAYOUT:
+            fprintf(file, "[RMD_SIMULATION_INFO] Simulated block layout: %ld by %ld.\n", value[0].u, value[1].u);
+            break;
+        case LOG_UNIT_LAYOUT:
+            fprintf(file, "[RMD_SIMULATION_INFO] Simulated unit layout: %ld by %ld.\n", value[0].u, value[1].u);
+            break;
+        case LOG_TEMPERATURE:
+            fprintf(file, "[RMD_TRACE_TEMPERATURE] Temperature of %fC at cycle %ld.\n", value[0].f, record.cycle);
+            break;
+        case LOG_POWER:
+            fprintf(file, "[RMD_TRACE_POWER] Power of %fW at cycle %ld.\n", value[0].f, record.cycle);
+            break;
+        case LOG_CHIP_POWER_GOAL:
+            fprintf(file, "[RMD_CONTROL_EVENT] [CHIP_POWER_GOAL_CHANGE] %f at cycle %ld \n", value[0].f, record.cycle);
+            break;
+        case LOG_UNIT_POWER_GOAL:
+            fprintf(file, "[RMD_CONTROL_EVENT] [UNIT_POWER_GOAL_CHANGE] %f at cycle %ld \n", value[0].f, record.cycle);
+            break;
+        case LOG_BLOCK_POWER_GOAL:
+            fprintf(file, "[RMD_CONTROL_EVENT] [BLOCK_POWER_GOAL_CHANGE] %f at cycle %ld \n", value[0].f, record.cycle);
+            break;
+        case LOG_BLOCK_UNDER_CONTROL:
+            fprintf(file, "[RMD_CONTROL_EVENT] [BLOCK_UNDER_CONTROL_CHANGE] %d at cycle %ld \n", (int) value[0].u, record.cycle);
+            break;
+        case LOG_STATE_CHANGE:
+            fprintf(file, "[RMD_CONTROL_EVENT] [STATE_CHANGE] %s at cycle %ld \n", value[0].u ? "FULL" : "HALF", record.cycle);
+            break;
+        case LOG_EMERGENCY:
+            fprintf(file, "[RMD_CONTROL_EVENT] [EMERGENCY] %f at cycle %ld \n", value[0].f, record.cycle);
+            break;
+        case LOG_EMERGENCY_DVFS:
+            fprintf(file, "[RMD_CONTROL_EVENT] [EMERGENCY_DVFS] HALF at cycle %ld after %ld cycles\n", record.cycle, value[0].u);
+            break;
+        case LOG_SYNC_QUANTUM:
+            fprintf(file, "[RMD_SYNC_QUANTUM] Quantum of %ld cycles at cycle %ld (gradient %fC, drift %fC per Mcycle).\n",
+                    value[0].u, record.cycle, value[1].f, value[2].f);
+            break;
+        case LOG_SAMPLES_END:
+            break;
+        default:
+            fprintf(file, "[RMD_UNKNOWN_EVENT] %u at cycle %ld\n", record.event, record.cycle);
+    }
+}
+
+#if LOGGING_LEVEL == 1
+/* Starts the writer thread of LOG_FILE (LOG_ASYNC) -- before the engines. */
+auto logStart() -> void;
+
+/* Gives the calling thread the log of the agent id (ring or text file). */
+auto logRegister(u64 id) -> void;
+
+/* Logs an event of the calling thread at its current cycle. */
+auto logEvent(u64 event, LogValue a = LogValue(), LogValue b = LogValue(), LogValue c = LogValue()) -> void;
+
+/* Closes the text file of the calling thread (without LOG_ASYNC). */
+auto logClose() -> void;
+
+/* Drains every ring and closes LOG_FILE -- after all the threads are done. */
+auto logStop() -> void;
+#else
+auto inline logEvent(u64, LogValue = LogValue(), LogValue = LogValue(), LogValue = LogValue()) -> void {}
+#endif
+#endif
@@ -0,0 +1,177 @@
+/*
+ * Copyright (c) 2014, University of Delaware
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/* safe-log2text: writes the text block logs of a run from its LOG_FILE
+ * (LOG_ASYNC), the same files the engines write without LOG_ASYNC. The
+ * temperatures and powers of LOG_SERIES_FILE, when the run wrote one next to
+ * it, are merged back by cycle. */
+
+#include "ss-log.h"
+#include "ss-series.h"
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <libgen.h>
+#include <vector>
+
+
+int main(int argc, char* argv[])
+{
+    if (argc != 2 && argc != 3)
+    {
+        printf("safe-log2text <%s> [output directory]\n", LOG_FILE);
+        exit(0);
+    }
+
+    //Output next to the binary log unless told otherwise.
+    std::vector<char> input(argv[1], argv[1] + strlen(argv[1]) + 1);
+    const char* inputDirectory = dirname(input.data());
+    const char* directory = argc == 3 ? argv[2] : inputDirectory;
+
+    FILE* log = fopen(argv[1], "r");
+    if (log == NULL)
+    {
+        perror(argv[1]);
+        exit(1);
+    }
+    LogFileHeader header;
+    if (fread(&header, sizeof(LogFileHeader), 1, log) != 1 || memcmp(header.magic, LOG_FILE_MAGIC, sizeof(header.magic)) != 0)
+    {
+        printf("%s: not a SAFE binary log.\n", argv[1]);
+        exit(1);
+    }
+    if (header.recordSize != sizeof(LogRecord) || header.blocksInUnit == 0)
+    {
+        printf("%s: records of %ld bytes, this safe-log2text reads %ld.\n", argv[1], header.recordSize, sizeof(LogRecord));
+        exit(1);
+    }
+
+    //Every block has a log, even without records.
+    std::vector<FILE*> blockLog(header.agents);
+    for (u64 id=0; id<header.agents; id++)
+    {
+        char name[1024];
+        logFileName(name, sizeof(name), directory, id, header.blocksInUnit);
+        if ((blockLog[id] = fopen(name, "w")) == NULL)
+        {
+            perror(name);
+            exit(1);
+        }
+    }
+
+    //With a series, the records are kept by block until the samples are merged
+    //(the log is then only the control events).
+    char seriesName[1024];
+    snprintf(seriesName, sizeof(seriesName), "%s/%s", inputDirectory, LOG_SERIES_FILE);
+    SeriesReader series;
+    bool merge = series.open(seriesName);
+    if (merge && series.agents() != header.agents)
+    {
+        printf("%s: %ld blocks, the log has %ld.\n", seriesName, series.agents(), header.agents);
+        exit(1);
+    }
+    std::vector<std::vector<LogRecord>> pending(merge ? header.agents : 0);
+
+    //Records of a block are in order across the segments.
+    std::vector<LogRecord> record(LOG_SEGMENT_RECORDS);
+    LogSegmentHeader segment;
+    u64 segments = 0, records = 0;
+    while (fread(&segment, sizeof(LogSegmentHeader), 1, log) == 1)
+    {
+        if (segment.magic != LOG_SEGMENT_MAGIC)
+        {
+            printf("WARNING: bad segment %ld, the rest of the log is skipped.\n", segments);
+            break;
+        }
+        if (segment.records > record.size())
+            record.resize(segment.records);
+        u64 count = fread(record.data(), sizeof(LogRecord), segment.records, log);
+        if (count != segment.records)
+            printf("WARNING: segment %ld is truncated (%ld of %ld records).\n", segments, count, segment.records);
+        for (u64 i=0; i<count; i++)
+        {
+            if (record[i].agent < header.agents && merge)
+                pending[record[i].agent].push_back(record[i]);
+            else if (record[i].agent < header.agents)
+                logFormat(blockLog[record[i].agent], record[i]);
+            else
+                printf("WARNING: record of unknown agent %u skipped.\n", record[i].agent);
+        }
+        records += count;
+        segments++;
+    }
+
+    //Samples after the records of their block up to their cycle (the boundary
+    //tick runs the roles before logging).
+    if (merge)
+    {
+        std::vector<double> temperature(header.agents), power(header.agents);
+        std::vector<u64> next(header.agents);
+        LogRecord sample = {};
+        for (u64 row=0; row<series.rows(); row++)
+        {
+            if (!series.read(row, sample.cycle, temperature.data(), power.data()))
+            {
+                printf("WARNING: %s is corrupt at sample %ld, the rest of it is skipped.\n", seriesName, row);
+                break;
+            }
+            for (u64 id=0; id<header.agents; id++)
+            {
+                for (; next[id] < pending[id].size() && pending[id][next[id]].cycle <= sample.cycle; next[id]++)
+                    logFormat(blockLog[id], pending[id][next[id]]);
+                sample.agent = id;
+                if (!seriesMissing(temperature[id]))
+                {
+                    sample.event = LOG_TEMPERATURE;
+                    sample.value[0] = temperature[id];
+                    logFormat(blockLog[id], sample);
+                }
+                if (!seriesMissing(power[id]))
+                {
+                    sample.event = LOG_POWER;
+                    sample.value[0] = power[id];
+                    logFormat(blockLog[id], sample);
+                }
+            }
+        }
+        for (u64 id=0; id<header.agents; id++)
+            for (; next[id] < pending[id].size(); next[id]++)
+                logFormat(blockLog[id], pending[id][next[id]]);
+        printf("%ld samples merged from %s.\n", series.rows(), seriesName);
+        series.close();
+    }
+
+    for (FILE* file : blockLog)
+        fclose(file);
+    fclose(log);
+    printf("%ld records in %ld segments written to %ld block logs in %s.\n", records, segments, header.agents, directory);
+    return EXIT_SUCCESS;
+}
@@ -30,6 +30,9 @@
 
 
 #include "ss-main.h"
+#include "ss-topology.h"
+#include "ss-log.h"
+#include "ss-live.h"
 #include <thread>
 #include <cstdlib>
 #include <unistd.h>
@@ -72,17 +75,22 @@ auto sanityChecks() -> void
     assert(sizeof(saAggInfoMetadata)*8==64);
     assert(sizeof(saBlkCtrlMetadata)*8==64);
     assert(sizeof(saErrInfoMetadata)*8==64);
-    assert(sizeof(saLocation)*8==72);
+    assert(sizeof(saInfCtrlMetadata)*8==64);
+    assert(sizeof(saLocation)*8==32);
+    assert(N_UNITS_IN_CHIP*N_BLOCKS_IN_UNIT <= (1UL << 29)); //must fit saLocation.agent.
 }
 
 
 int main(int argc, char* argv[])
 {
-    if(argc != 2)
+    programStartTime = std::chrono::high_resolution_clock::now();
+    bool synthetic = argc == 3 && strcmp(argv[1], "--synthetic") == 0;
+    if(argc != 2 && !synthetic)
     {
-        printf("sim <work queue>");
+        printf("sim <work queue>\nsim --synthetic <compute|dram|mixed>\n");
         exit(0);
     }
+    workloadName = argv[argc-1];
     printf("==> Sanity checking API...\n");
     sanityChecks();
 
@@ -110,50 +118,66 @@ int main(int argc, char* argv[])
         verifyInstructionsTable();
         printf(" done...\n");
         printf("---------------------------\n");
-        printf("==> Reading instructions file\n");
-        openInstructionsFile(argv[1]);
-        parseInputQueue();
+        if (synthetic)
+        {
+            if (!generateSyntheticQueue(argv[2]))
+                exit(1);
+        }
+        else
+        {
+            printf("==> Reading instructions file\n");
+            openInstructionsFile(argv[1]);
+            parseInputQueue();
+        }
         verifyInstructionsTable(); // Check mega instructions.
         
         closeInstructionsFile();
         closeInstructionsTableFile();
     }
 
-    #if EXECUTION_TIMES == 1 || EXECUTION_TIMES == 2 || EXECUTION_TIMES == 3 
+    #if ARENA_ALLOCATOR == 1
+    arenaReserve(taskPool.size());
+    #endif
+
+    #if EXECUTION_TIMES >= 1
       //Start the timer for total execution time
       simulationStartTime = std::chrono::high_resolution_clock::now();
     #endif
 
+    #if LOGGING_LEVEL == 1
+    logStart();
+    #endif
+    liveStart();
+
     printf("---------------------------\n");
     printf("==> Starting threads...\n");
     std::thread thread[N_BLOCKS_IN_UNIT*N_UNITS_IN_CHIP];
 
+    #if THREAD_PLACEMENT == 1
+    //Engines inherit the affinity of the creator, so the stack and thread
+    //local state of each engine are first touched on the domain of its unit.
+    readTopology();
+    #endif
+
     //Create the first engine with work.
+    #if THREAD_PLACEMENT == 1
+    pinToDomain(unitDomain(0));
+    #endif
     thread[0] = std::thread(&engine, 0);
 
     //Create the rest of the engines without work.
     for (u64 tid=1; tid<N_BLOCKS_IN_UNIT*N_UNITS_IN_CHIP; tid++)
     {
+        #if THREAD_PLACEMENT == 1
+        pinToDomain(unitDomain(tid/N_BLOCKS_IN_UNIT));
+        #endif
         thread[tid] = std::thread(&engine, tid);
-        
-        /*
-        cpu_set_t cpuset;
-        CPU_ZERO(&cpuset);
-        for (u64 off=0; off<=18; off+=6)
-        {
-            if( (tid>=0+off && tid<=5+off) || (tid>=24+off && tid<=29+off) )
-            {
-                for(u64 proc=0+off; proc<=5+off; proc++)
-                    CPU_SET(proc, &cpuset);
-                for(u64 proc=24+off; proc<=29+off; proc++)
-                    CPU_SET(proc, &cpuset);
-            }
-        }
-        pthread_setaffinity_np(thread[tid].native_handle(),
-                                        sizeof(cpu_set_t), &cpuset);
-        */
     }
 
+    #if THREAD_PLACEMENT == 1
+    unpinThread();
+    #endif
+
     for (;;) pause();
 
     return EXIT_SUCCESS;
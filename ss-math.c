@@ -63,3 +63,89 @@ FLOAT_TYPE computeSkew(FLOAT_TYPE* data, FLOAT_TYPE avg, u64 count)
         skew += (data[i]-avg)*(data[i]-avg)*(data[i]-avg); //let the compiler hoist.
     return skew/count;
 }
+
+/* Central moments from the power sums around a shift. */
+static Moments momentsFromSums(FLOAT_TYPE shift, FLOAT_TYPE s1, FLOAT_TYPE s2, FLOAT_TYPE s3, u64 count)
+{
+    Moments m;
+    FLOAT_TYPE d = s1/count;
+    FLOAT_TYPE e2 = s2/count;
+    m.mean = shift + d;
+    m.variance = e2 - d*d;
+    if (m.variance < 0)
+        m.variance = 0; // rounding when all values are (nearly) equal.
+    m.skew = s3/count - 3*d*e2 + 2*d*d*d;
+    return m;
+}
+
+Moments computeMoments(const FLOAT_TYPE* data, u64 count)
+{
+    FLOAT_TYPE shift = count ? data[0] : 0;
+    FLOAT_TYPE s1 = 0, s2 = 0, s3 = 0;
+    for(u64 i=0; i<count; i++)
+    {
+        FLOAT_TYPE x = data[i]-shift;
+        s1 += x;
+        s2 += x*x;
+        s3 += x*x*x;
+    }
+    return momentsFromSums(shift, s1, s2, s3, count);
+}
+
+Moments computePooledMoments(const FLOAT_TYPE* mean, const FLOAT_TYPE* variance, const FLOAT_TYPE* skew, u64 count)
+{
+    //Pooled: var = avg(var) + var(mean), skew = avg(skew) + skew(mean) + 3*cov(mean, var).
+    FLOAT_TYPE shift = count ? mean[0] : 0;
+    FLOAT_TYPE s1 = 0, s2 = 0, s3 = 0, sv = 0, ss = 0, sdv = 0;
+    for(u64 i=0; i<count; i++)
+    {
+        FLOAT_TYPE x = mean[i]-shift;
+        s1 += x;
+        s2 += x*x;
+        s3 += x*x*x;
+        sv += variance[i];
+        ss += skew[i];
+        sdv += x*variance[i];
+    }
+    Moments m = momentsFromSums(shift, s1, s2, s3, count);
+    FLOAT_TYPE avgOfVar = sv/count;
+    m.skew += ss/count + 3*(sdv/count - (s1/count)*avgOfVar);
+    m.variance += avgOfVar;
+    return m;
+}
+
+void momentsInit(MomentsAccumulator* acc, const FLOAT_TYPE* data, u64 count)
+{
+    FLOAT_TYPE shift = count ? data[0] : 0;
+    acc->shift = shift;
+    acc->sum[0] = acc->sum[1] = acc->sum[2] = 0;
+    for(u64 i=0; i<count; i++)
+    {
+        FLOAT_TYPE x = data[i]-shift;
+        acc->sum[0] += x;
+        acc->sum[1] += x*x;
+        acc->sum[2] += x*x*x;
+    }
+    acc->count = count;
+    acc->updates = 0;
+}
+
+void momentsReplace(MomentsAccumulator* acc, FLOAT_TYPE* data, u64 index, FLOAT_TYPE value)
+{
+    FLOAT_TYPE old = data[index]-acc->shift;
+    FLOAT_TYPE x = value-acc->shift;
+    data[index] = value;
+    if (++acc->updates >= MOMENTS_RESYNC)
+    {
+        momentsInit(acc, data, acc->count);
+        return;
+    }
+    acc->sum[0] += x - old;
+    acc->sum[1] += x*x - old*old;
+    acc->sum[2] += x*x*x - old*old*old;
+}
+
+Moments momentsGet(const MomentsAccumulator* acc)
+{
+    return momentsFromSums(acc->shift, acc->sum[0], acc->sum[1], acc->sum[2], acc->count);
+}
@@ -37,4 +37,34 @@ FLOAT_TYPE computeAverage(FLOAT_TYPE* data, u64 count);
 FLOAT_TYPE computeVariance(FLOAT_TYPE* data, FLOAT_TYPE avg, u64 count);
 FLOAT_TYPE computeCovariance(FLOAT_TYPE* data, FLOAT_TYPE avg, FLOAT_TYPE* data2, FLOAT_TYPE avg2, u64 count);
 FLOAT_TYPE computeSkew(FLOAT_TYPE* data, FLOAT_TYPE avg, u64 count);
+
+/* Mean, variance and third central moment (what computeSkew returns) of a sample. */
+typedef struct Moments
+{
+    FLOAT_TYPE mean;
+    FLOAT_TYPE variance;
+    FLOAT_TYPE skew;
+} Moments;
+
+/* All three moments in a single pass. */
+Moments computeMoments(const FLOAT_TYPE* data, u64 count);
+
+/* Moments of the union of count groups from the moments of each (equal sizes). */
+Moments computePooledMoments(const FLOAT_TYPE* mean, const FLOAT_TYPE* variance, const FLOAT_TYPE* skew, u64 count);
+
+/* Power sums of a sample kept up to date as its values are replaced one at a time. */
+//Note: the sums are taken around a shift (a sample value) to limit cancellation
+//      and rebuilt from the data every MOMENTS_RESYNC replacements so rounding
+//      errors do not pile up.
+typedef struct MomentsAccumulator
+{
+    FLOAT_TYPE shift;
+    FLOAT_TYPE sum[3]; // sums of (x-shift), (x-shift)^2 and (x-shift)^3.
+    u64 count;
+    u64 updates; // replacements since the last rebuild.
+} MomentsAccumulator;
+
+void momentsInit(MomentsAccumulator* acc, const FLOAT_TYPE* data, u64 count);
+void momentsReplace(MomentsAccumulator* acc, FLOAT_TYPE* data, u64 index, FLOAT_TYPE value);
+Moments momentsGet(const MomentsAccumulator* acc);
 #endif
@@ -57,7 +57,7 @@ auto updateClockMSR() -> void
 
 auto readPowerMSR() -> FLOAT_TYPE
 {
-    return agent.accumulatedEnergy*(MAX_XE_CLOCK_SPEED_MHZ*1E-6/ROLLING_ENERGY_WINDOW/INST_PER_MEGA_INST); //normalize for picojoules and megahertz.
+    return ENERGY_TO_PJ(agent.accumulatedEnergy)*(MAX_XE_CLOCK_SPEED_MHZ*1E-6/ROLLING_ENERGY_WINDOW/INST_PER_MEGA_INST); //normalize for picojoules and megahertz.
 }
 
 /*Updates the current energy based on the currently running tasks and state of each XE.*/
@@ -123,42 +123,42 @@ auto readPowerMSR() -> FLOAT_TYPE
 
 u8 readTemperatureMSR()
 {
-    return TEMPERATURE_JUNCTION - (u64)agent.temperature; //report temperatures in terms of delta.
+    return TEMPERATURE_JUNCTION - (u64)agent.exchange->temperature; //report temperatures in terms of delta.
 }
 
 /*Updates the current temperature using the current front of the energy Window and neighbor temperatures.*/
 auto updateTemperatureMSR() -> void
 {
     //Grab the energy for this cycle.
-    static thread_local FLOAT_TYPE energy = 0.0;
+    static thread_local ENERGY_TYPE energy = 0;
     if (agent.energyWindow.empty() == false)
             energy += agent.energyWindow.front();
 
     if(readClockMSR() % 2 == 0)
     {
         //Update the temperature.
-        computeTemperature(energy, 2);
-        energy = 0.0;
-        if(agent.temperature > TEMPERATURE_JUNCTION) //maximum possible junction temperature.
+        computeTemperature(ENERGY_TO_PJ(energy), 2);
+        energy = 0;
+        if(agent.exchange->temperature > TEMPERATURE_JUNCTION) //maximum possible junction temperature.
         {
-            agent.temperature = TEMPERATURE_JUNCTION;
+            agent.exchange->temperature = TEMPERATURE_JUNCTION;
             if (!maxOperatingTempWarning)
             {
               //printf("unt%ld.blk%ld: WARNING: exceeded junction temperatures, your chip is a mushroom cloud!\n", agent.uid, agent.bid);
               maxOperatingTempWarning=true;
             }
         }
-        else if(agent.temperature > TEMPERATURE_OPERATION) //maximum operating temperature allowed.
+        else if(agent.exchange->temperature > TEMPERATURE_OPERATION) //maximum operating temperature allowed.
         {
             if(!maxChipTempWarning)
             {
-              //printf("unt%ld.blk%ld: WARNING: exceeded allowed operating temperature (%lfC)!\n", agent.uid, agent.bid, agent.temperature);
+              //printf("unt%ld.blk%ld: WARNING: exceeded allowed operating temperature (%lfC)!\n", agent.uid, agent.bid, agent.exchange->temperature);
               maxChipTempWarning=true;
             }
         }
-        else if(agent.temperature < 50.0)
+        else if(agent.exchange->temperature < 50.0)
         {
-            agent.temperature = TEMPERATURE_AMBIENT;
+            agent.exchange->temperature = TEMPERATURE_AMBIENT;
             maxChipTempWarning=false;
             maxOperatingTempWarning=false;
         }
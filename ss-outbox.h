@@ -0,0 +1,177 @@
+/*
+ * Copyright (c) 2014, University of Delaware
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef _SS_OUTBOX_GUARD_
+#define _SS_OUTBOX_GUARD_
+#include "ss-conf.h"
+#include "ss-agent.h"
+#include "ss-msr.h"
+#include "sa-api.h"
+#include "ss-trace.h"
+#include <cassert>
+
+/* Coalescing key of a message -- its type plus the attribute it carries. */
+//Note: control messages carry one control field each (SA_ATR_FUB_CTRL) and
+//      info requests one requested type, so those are part of the key.
+static auto inline saMessageKey(const saMetadata& msg) -> u64
+{
+    switch (msg.SA_ATR_METADATA_TYPE)
+    {
+        case SA_METADATA_TYPE_BLK_CTRL:
+            return SA_METADATA_TYPE_BLK_CTRL | ((u64) ((const saBlkCtrlMetadata&) msg).SA_ATR_FUB_CTRL << 3);
+        case SA_METADATA_TYPE_INF_CTRL:
+            return SA_METADATA_TYPE_INF_CTRL | ((u64) ((const saInfCtrlMetadata&) msg).SA_ATR_REQ_METADATA_TYPE << 3);
+        default:
+            return msg.SA_ATR_METADATA_TYPE;
+    }
+}
+
+/* Keys a destination can have pending: a plain message of every type, a
+ * control message per control field and an info request per requested type. */
+static constexpr u64 OUTBOX_KEYS = SA_METADATA_TYPE_LAST +
+    __builtin_popcount(SA_ATR_FUB_CTRL_XE_VALID | SA_ATR_FUB_CTRL_FPU_VALID | SA_ATR_FUB_CTRL_BSM_VALID |
+                       SA_ATR_FUB_CTRL_DVFS_VALID | SA_ATR_FUB_CTRL_POWER_GOAL_VALID | SA_ATR_FUB_CTRL_UNDER_CONTROL_VALID) +
+    SA_METADATA_TYPE_LAST;
+
+/* Locations of the destinations of an outbox. */
+static auto inline outboxParent(u64) -> saLocation { return saGetParentLocation(); }
+static auto inline outboxChild(u64 child) -> saLocation { return saGetChildLocation(child); }
+
+/* Per-destination outgoing messages of a node, delivered once per epoch. */
+//Note: a newer message with the same key replaces the pending one (last writer
+//      wins) in place. Only destinations marked in the dirty bitmap are visited.
+//      Urgent messages skip the epoch and are sent right away.
+template <u64 DESTINATIONS, saLocation (*LOCATE)(u64)>
+struct Outbox
+{
+    static_assert(DESTINATIONS <= 64, "the dirty bitmap holds 64 destinations");
+
+    struct
+    {
+        u64 key[OUTBOX_KEYS];
+        saMetadata msg[OUTBOX_KEYS];
+        u64 count;
+    } pending[DESTINATIONS];
+    u64 dirty; // destinations with pending messages.
+
+    auto push(u64 destination, const saMetadata& msg) -> void
+    {
+        auto& p = pending[destination];
+        u64 key = saMessageKey(msg);
+        if (msg.SA_ATR_URGENCY)
+        {
+            //Supersedes the routine message with the same key.
+            for (u64 i = 0; i < p.count; i++)
+            {
+                if (p.key[i] == key)
+                {
+                    remove(destination, i);
+                    agent.statistics.messagesCoalesced++;
+                    break;
+                }
+            }
+            if (saSendMetadata(LOCATE(destination), (void*) &msg) == 0)
+            {
+                agent.statistics.messagesUrgent++;
+                agent.statistics.messagesSent++;
+                agent.statistics.messagesByType[msg.SA_ATR_METADATA_TYPE]++;
+                return;
+            }
+            //Urgent lane full -- goes out with the next epoch.
+        }
+        for (u64 i = 0; i < p.count; i++)
+        {
+            if (p.key[i] == key)
+            {
+                p.msg[i] = msg;
+                agent.statistics.messagesCoalesced++;
+                return;
+            }
+        }
+        //Note: a message carrying several control fields is a key of its own.
+        assert(p.count < OUTBOX_KEYS && "more distinct pending messages than OUTBOX_KEYS");
+        if (p.count == OUTBOX_KEYS)
+        {
+            agent.statistics.messagesDropped++;
+            return;
+        }
+        p.key[p.count] = key;
+        p.msg[p.count] = msg;
+        p.count++;
+        dirty |= 1UL << destination;
+    }
+
+    /* Removes a pending message keeping the order of the rest. */
+    auto remove(u64 destination, u64 index) -> void
+    {
+        auto& p = pending[destination];
+        for (u64 i = index+1; i < p.count; i++)
+        {
+            p.key[i-1] = p.key[i];
+            p.msg[i-1] = p.msg[i];
+        }
+        p.count--;
+        if (p.count == 0)
+            dirty &= ~(1UL << destination);
+    }
+
+    /* Sends the pending messages at the epoch boundary. */
+    //Note: messages that do not fit in a full mailbox stay pending (and keep
+    //      coalescing) until the next epoch.
+    auto deliver() -> void
+    {
+        if (dirty == 0 || readClockMSR() % SA_MESSAGE_EPOCH != 0)
+            return;
+        TRACE_SCOPE("deliver", __builtin_popcountl(dirty));
+
+        for (u64 bits = dirty; bits != 0; bits &= bits - 1)
+        {
+            u64 destination = __builtin_ctzl(bits);
+            auto& p = pending[destination];
+            saLocation location = LOCATE(destination);
+            u64 sent = 0;
+            while (sent < p.count && saSendMetadata(location, (void*) &p.msg[sent]) == 0)
+                agent.statistics.messagesByType[p.msg[sent++].SA_ATR_METADATA_TYPE]++;
+            agent.statistics.messagesSent += sent;
+
+            //Keep what did not fit.
+            for (u64 i = sent; i < p.count; i++)
+            {
+                p.key[i-sent] = p.key[i];
+                p.msg[i-sent] = p.msg[i];
+            }
+            p.count -= sent;
+            if (p.count == 0)
+                dirty &= ~(1UL << destination);
+        }
+    }
+};
+#endif
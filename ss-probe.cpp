@@ -0,0 +1,259 @@
+/*
+ * Copyright (c) 2014, University of Delaware
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "ss-probe.h"
+#include <algorithm>
+#include <cstdio>
+#include <thread>
+#include <atomic>
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#if PROBES == 1
+#define PROBE_STRAGGLERS 8 // slowest threads listed in the report.
+
+thread_local ProbeTable* probeTable;
+
+/* Tables of every engine thread -- indexed by agent id. */
+static ProbeTable probeTables[N_UNITS_IN_CHIP*N_BLOCKS_IN_UNIT];
+static bool probeRegistered[N_UNITS_IN_CHIP*N_BLOCKS_IN_UNIT];
+
+static const char* probeNames[PROBE_PHASES] = {"chip role", "unit role", "block role", "execute", "thermal", "barrier wait", "flush"};
+
+#if PROBE_COUNTERS == 1
+/* perf_event_open type and config of each event. */
+static const u32 probeEventType[PROBE_EVENTS]   = {PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_SOFTWARE};
+static const u64 probeEventConfig[PROBE_EVENTS] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES,
+                                                   PERF_COUNT_HW_BRANCH_MISSES, PERF_COUNT_SW_CONTEXT_SWITCHES};
+
+/* Opens the counters of the calling thread as one group -- the events the host lacks are left out. */
+static auto probeOpenCounters(ProbeTable* table) -> void
+{
+    static std::atomic<bool> warned(false);
+    table->counters = -1;
+    table->counterCount = 0;
+    int error = 0;
+    for (u64 event=0; event<PROBE_EVENTS; event++)
+    {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = probeEventType[event];
+        attr.config = probeEventConfig[event];
+        attr.read_format = PERF_FORMAT_GROUP;
+        attr.exclude_kernel = (attr.type == PERF_TYPE_HARDWARE); // context switches happen in the kernel.
+        attr.exclude_hv = 1;
+        int fd = syscall(__NR_perf_event_open, &attr, 0, -1, table->counters, 0);
+        if (fd < 0)
+        {
+            error = errno;
+            continue;
+        }
+        if (table->counters < 0)
+            table->counters = fd;
+        table->counterFd[table->counterCount] = fd;
+        table->counterEvent[table->counterCount++] = event;
+    }
+    if (table->counterCount < PROBE_EVENTS && !warned.exchange(true))
+        printf("WARNING: %ld of %d performance counters available (perf_event_open: %s), the others are not reported.\n",
+               table->counterCount, PROBE_EVENTS, strerror(error));
+}
+
+auto probeReadCounters(u64 values[PROBE_EVENTS]) -> void
+{
+    u64 group[1+PROBE_EVENTS]; // count of counters then their values.
+    memset(values, 0, PROBE_EVENTS*sizeof(u64));
+    if (probeTable->counters < 0 || read(probeTable->counters, group, sizeof(group)) <= 0)
+        return;
+    for (u64 i=0; i<probeTable->counterCount; i++)
+        values[probeTable->counterEvent[i]] = group[1+i];
+}
+
+auto probeAddCounters(u64 phase, const u64 start[PROBE_EVENTS]) -> void
+{
+    u64 values[PROBE_EVENTS];
+    probeReadCounters(values);
+    for (u64 event=0; event<PROBE_EVENTS; event++)
+        probeTable->events[phase][event] += values[event] - start[event];
+}
+#endif
+
+auto probeRegister(u64 id) -> void
+{
+    probeTable = &probeTables[id];
+    probeRegistered[id] = true;
+    #if PROBE_COUNTERS == 1
+    probeOpenCounters(probeTable);
+    #endif
+}
+
+auto probeUnregister() -> void
+{
+    #if PROBE_COUNTERS == 1
+    //Members first, the group leader last.
+    for (u64 i=probeTable->counterCount; i-- > 0; )
+        close(probeTable->counterFd[i]);
+    probeTable->counters = -1; // counterCount stays for the report.
+    #endif
+}
+
+/* Upper bound in nanoseconds of the bucket holding the given fraction of the samples. */
+static auto probePercentile(const u64* histogram, u64 count, double fraction) -> u64
+{
+    u64 rank = (u64)(fraction*count), seen = 0;
+    for (u64 bucket=0; bucket<PROBE_BUCKETS; bucket++)
+    {
+        seen += histogram[bucket];
+        if (seen > rank)
+            return 2UL << bucket;
+    }
+    return 0;
+}
+
+/* Factor from the sampled ticks of a thread to all the ticks -- barrier waits are always timed. */
+static auto probeScale(const ProbeTable* table, u64 phase, u64 ticks) -> double
+{
+    return (phase == PROBE_BARRIER) ? 1.0 : (double)ticks/std::max<u64>(1, table->sampledTicks);
+}
+
+/* Whether the report lists the phase -- EXECUTION_TIMES 2 only has the roles, barriers and work. */
+static auto probeReported(u64 phase) -> bool
+{
+    return EXECUTION_TIMES == 3 || (phase != PROBE_THERMAL && phase != PROBE_FLUSH);
+}
+
+/* Seconds a thread spent in the phase. */
+static auto probeSeconds(const ProbeTable* table, u64 phase, u64 ticks) -> double
+{
+    return table->total[phase]*1e-9*probeScale(table, phase, ticks);
+}
+
+auto probeReport(u64 ticks) -> void
+{
+    const u64 threads = N_UNITS_IN_CHIP*N_BLOCKS_IN_UNIT;
+    printf("==> Probes: %ld threads, 1 in %d cycles timed, barrier waits always (percentiles are bucket upper bounds)...\n", threads, PROBE_SAMPLE);
+    if (std::thread::hardware_concurrency() < threads)
+        printf("  * %d host CPUs for %ld threads: the latencies include the time threads are preempted.\n", std::thread::hardware_concurrency(), threads);
+    printf("  * %-12s %12s %12s %10s %10s %10s %10s %12s\n", "phase", "count", "thread s", "mean ns", "p50 ns", "p90 ns", "p99 ns", "max ns");
+    for (u64 phase=0; phase<PROBE_PHASES; phase++)
+    {
+        if (!probeReported(phase))
+            continue;
+        u64 histogram[PROBE_BUCKETS] = {0};
+        u64 count = 0, total = 0, max = 0;
+        double seconds = 0;
+        for (u64 i=0; i<threads; i++)
+        {
+            const ProbeTable* table = &probeTables[i];
+            if (!probeRegistered[i])
+                continue;
+            count += table->count[phase];
+            total += table->total[phase];
+            max    = std::max(max, table->max[phase]);
+            for (u64 bucket=0; bucket<PROBE_BUCKETS; bucket++)
+                histogram[bucket] += table->histogram[phase][bucket];
+            seconds += probeSeconds(table, phase, ticks);
+        }
+        if (count == 0)
+            continue;
+        printf("  * %-12s %12ld %12.6f %10ld %10ld %10ld %10ld %12ld\n", probeNames[phase], count, seconds, total/count,
+               probePercentile(histogram, count, 0.5), probePercentile(histogram, count, 0.9), probePercentile(histogram, count, 0.99), max);
+    }
+
+    #if PROBE_COUNTERS == 1
+    //Counters: the events of each thread extrapolated like the times.
+    u64 available = 0;
+    for (u64 i=0; i<threads; i++)
+        if (probeRegistered[i])
+            for (u64 c=0; c<probeTables[i].counterCount; c++)
+                available |= 1UL << probeTables[i].counterEvent[c];
+    if (available != 0)
+    {
+        double simulatedCycles = (double)ticks*INST_PER_MEGA_INST*threads;
+        printf("  * %-12s %8s %16s %16s %16s\n", "phase", "IPC", "LLC miss/cycle", "branch miss/cycle", "ctx switches");
+        for (u64 phase=0; phase<PROBE_PHASES; phase++)
+        {
+            double events[PROBE_EVENTS] = {0};
+            u64 count = 0;
+            for (u64 i=0; i<threads; i++)
+            {
+                if (!probeRegistered[i])
+                    continue;
+                count += probeTables[i].count[phase];
+                for (u64 event=0; event<PROBE_EVENTS; event++)
+                    events[event] += probeTables[i].events[phase][event]*probeScale(&probeTables[i], phase, ticks);
+            }
+            if (count == 0 || !probeCounted(phase) || !probeReported(phase))
+                continue;
+            char ipc[32] = "n/a", llc[32] = "n/a", branch[32] = "n/a", switches[32] = "n/a";
+            if ((available & (1UL << PROBE_CYCLES)) && (available & (1UL << PROBE_INSTRUCTIONS)) && events[PROBE_CYCLES] > 0)
+                snprintf(ipc, sizeof(ipc), "%.3f", events[PROBE_INSTRUCTIONS]/events[PROBE_CYCLES]);
+            if (available & (1UL << PROBE_LLC_MISSES))
+                snprintf(llc, sizeof(llc), "%.6f", events[PROBE_LLC_MISSES]/simulatedCycles);
+            if (available & (1UL << PROBE_BRANCH_MISSES))
+                snprintf(branch, sizeof(branch), "%.6f", events[PROBE_BRANCH_MISSES]/simulatedCycles);
+            if (available & (1UL << PROBE_CONTEXT_SWITCHES))
+                snprintf(switches, sizeof(switches), "%.0f", events[PROBE_CONTEXT_SWITCHES]);
+            printf("  * %-12s %8s %16s %16s %16s\n", probeNames[phase], ipc, llc, branch, switches);
+        }
+    }
+    #endif
+
+    #if EXECUTION_TIMES == 3
+    //Stragglers: the threads with the most time in the roles and the work.
+    double busy[N_UNITS_IN_CHIP*N_BLOCKS_IN_UNIT] = {0};
+    u64 order[N_UNITS_IN_CHIP*N_BLOCKS_IN_UNIT];
+    u64 registered = 0;
+    for (u64 i=0; i<threads; i++)
+    {
+        const ProbeTable* table = &probeTables[i];
+        if (!probeRegistered[i])
+            continue;
+        for (u64 phase : {PROBE_ROLE_CHIP, PROBE_ROLE_UNIT, PROBE_ROLE_BLOCK, PROBE_EXECUTE})
+            busy[i] += probeSeconds(table, phase, ticks);
+        order[registered++] = i;
+    }
+    if (registered == 0)
+        return;
+    std::sort(order, order+registered, [&busy](u64 a, u64 b) { return busy[a] > busy[b]; });
+    printf("  * Stragglers (roles + execute, median thread %f s):\n", busy[order[registered/2]]);
+    for (u64 rank=0; rank<std::min<u64>(PROBE_STRAGGLERS, registered); rank++)
+    {
+        u64 i = order[rank];
+        printf("    %ld. unit %02ld block %02ld: busy %f s, barrier wait %f s\n", rank+1, i/N_BLOCKS_IN_UNIT, i%N_BLOCKS_IN_UNIT,
+               busy[i], probeSeconds(&probeTables[i], PROBE_BARRIER, ticks));
+    }
+    #endif
+}
+#endif
@@ -0,0 +1,166 @@
+/*
+ * Copyright (c) 2014, University of Delaware
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef _SS_PROBE_GUARD_
+#define _SS_PROBE_GUARD_
+#include "ss-conf.h"
+#include <chrono>
+
+/* Phases of the engine timed by the probes. */
+//Note: thermal is part of execute and flush is part of the roles.
+enum ProbePhase
+{
+    PROBE_ROLE_CHIP,
+    PROBE_ROLE_UNIT,
+    PROBE_ROLE_BLOCK,
+    PROBE_EXECUTE,
+    PROBE_THERMAL,
+    PROBE_BARRIER,
+    PROBE_FLUSH,
+    PROBE_PHASES
+};
+
+/* Events counted per phase with PROBE_COUNTERS (perf_event_open). */
+enum ProbeEvent
+{
+    PROBE_CYCLES,
+    PROBE_INSTRUCTIONS,
+    PROBE_LLC_MISSES,
+    PROBE_BRANCH_MISSES,
+    PROBE_CONTEXT_SWITCHES,
+    PROBE_EVENTS
+};
+
+#if PROBES == 1
+#define PROBE_BUCKETS 64 // log2 buckets of nanoseconds.
+
+/* Latencies seen by one thread -- a log-scale histogram per phase. */
+struct alignas(CACHE_LINE_SIZE) ProbeTable
+{
+    u64 count[PROBE_PHASES];
+    u64 total[PROBE_PHASES]; // nanoseconds.
+    u64 max[PROBE_PHASES];
+    u64 histogram[PROBE_PHASES][PROBE_BUCKETS];
+    u64 sampledTicks;        // ticks the sampled phases were timed on.
+    bool sampling;           // the current tick is timed.
+    #if PROBE_COUNTERS == 1
+    u64 events[PROBE_PHASES][PROBE_EVENTS];
+    int counters;                // group of the counters the host has, -1 if none.
+    int counterFd[PROBE_EVENTS];    // file descriptor of each counter, in group order.
+    u64 counterEvent[PROBE_EVENTS]; // event of each counter, in group order.
+    u64 counterCount;
+    #endif
+};
+extern thread_local ProbeTable* probeTable; // table of the calling thread (see probeRegister).
+
+/* Monotonic time in nanoseconds. */
+inline auto probeNow() -> u64
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/* Adds the time since start to the phase. */
+inline auto probeRecord(u64 phase, u64 start) -> void
+{
+    u64 latency = probeNow() - start;
+    probeTable->count[phase]++;
+    probeTable->total[phase] += latency;
+    if (latency > probeTable->max[phase])
+        probeTable->max[phase] = latency;
+    probeTable->histogram[phase][63 - __builtin_clzl(latency | 1)]++;
+}
+
+#if PROBE_COUNTERS == 1
+/* Reads the counters of the calling thread (zero for the events the host lacks). */
+auto probeReadCounters(u64 values[PROBE_EVENTS]) -> void;
+
+/* Adds the events counted since start to the phase. */
+auto probeAddCounters(u64 phase, const u64 start[PROBE_EVENTS]) -> void;
+
+/* Phases with counters -- not the nested ones, whose reads would be counted in the outer phase. */
+inline auto probeCounted(u64 phase) -> bool
+{
+    return phase != PROBE_THERMAL && phase != PROBE_FLUSH;
+}
+#endif
+
+/* Times the enclosing scope -- on the sampled ticks only unless ALWAYS. */
+template <bool ALWAYS>
+struct ProbeScope
+{
+    u64  phase;
+    bool timed;
+    u64  start;
+    #if PROBE_COUNTERS == 1
+    u64  events[PROBE_EVENTS];
+    #endif
+
+    ProbeScope(u64 phase) : phase(phase), timed(ALWAYS || probeTable->sampling), start(0)
+    {
+        if (!timed)
+            return;
+        #if PROBE_COUNTERS == 1
+        if (probeCounted(phase))
+            probeReadCounters(events);
+        #endif
+        start = probeNow();
+    }
+    ~ProbeScope()
+    {
+        if (!timed)
+            return;
+        probeRecord(phase, start);
+        #if PROBE_COUNTERS == 1
+        if (probeCounted(phase))
+            probeAddCounters(phase, events);
+        #endif
+    }
+};
+
+#define PROBE_NAME_(line) probe_##line
+#define PROBE_NAME(line) PROBE_NAME_(line)
+#define PROBE(phase)        ProbeScope<false> PROBE_NAME(__LINE__)(phase)
+#define PROBE_ALWAYS(phase) ProbeScope<true>  PROBE_NAME(__LINE__)(phase)
+
+/* Gives the calling thread the table of the agent id -- before any probe. */
+//Note: tables outlive the threads so the report can be printed once they exit.
+auto probeRegister(u64 id) -> void;
+
+/* Releases what the calling thread opened in probeRegister (the counters) -- after its last probe. */
+auto probeUnregister() -> void;
+
+/* Prints the merged histograms and the slowest threads -- after all the threads are done. */
+auto probeReport(u64 ticks) -> void;
+#else
+#define PROBE(phase)
+#define PROBE_ALWAYS(phase)
+#endif
+#endif
@@ -0,0 +1,316 @@
+/*
+ * Copyright (c) 2014, University of Delaware
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/* safe-render: heat map frames of a run from its LOG_SERIES_FILE -- one frame
+ * per sample, the blocks laid out as on the chip (unit borders thicker) and
+ * colored with the jet color map, with the color scale on the right. Frames
+ * are written as PPM files or as one raw RGB24 stream (for ffmpeg), rendered
+ * by a pool of threads from a bounded queue of decoded rows. */
+
+#include "ss-series.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define RENDER_CELL     16   // default pixels per block (border included).
+#define RENDER_SCALE    16   // pixels of the color scale.
+#define RENDER_QUEUE    2    // decoded rows queued per thread.
+
+/* Settings from the command line. */
+static struct
+{
+    const char* output = "frames"; // directory of the PPM files, "-" for raw frames on stdout.
+    u64 cell = RENDER_CELL;
+    double minimum = 0;            // color scale.
+    double maximum = 200;
+    bool power = false;            // render the powers instead of the temperatures.
+    u64 threads = std::max(1U, std::thread::hardware_concurrency());
+    u64 first = 0;                 // cycles rendered.
+    u64 last = -1UL;
+} settings;
+
+/* Frame geometry. */
+static struct
+{
+    u64 blockWidth;  // blocks per unit side.
+    u64 unitWidth;   // units per chip side.
+    u64 side;        // blocks per chip side.
+    u64 grid;        // pixels of the grid side.
+    u64 width;       // pixels of the frame (grid, gap and scale).
+    u64 height;
+} frame;
+
+static u8 jet[256][3];
+
+/* Matplotlib's jet: blue, cyan, yellow, red. */
+static auto initializeColors() -> void
+{
+    for (u64 i = 0; i < 256; i++)
+    {
+        double x = i/255.0;
+        double rgb[3] = {1.5 - fabs(4*x - 3), 1.5 - fabs(4*x - 2), 1.5 - fabs(4*x - 1)};
+        for (u64 c = 0; c < 3; c++)
+            jet[i][c] = std::max(0.0, std::min(1.0, rgb[c]))*255 + 0.5;
+    }
+}
+
+static auto color(double value) -> const u8*
+{
+    static const u8 grey[3] = {128, 128, 128}; // blocks without a sample.
+    if (seriesMissing(value))
+        return grey;
+    double x = (value - settings.minimum)/(settings.maximum - settings.minimum);
+    return jet[(u64) (std::max(0.0, std::min(1.0, x))*255 + 0.5)];
+}
+
+/* Draws the values (indexed by agent) in the RGB24 image. */
+//Note: same placement as tempAnalysisScript.py -- unit by unit, first block on top-left.
+static auto rasterize(const double* value, u64 blocksInUnit, std::vector<u8>& image) -> void
+{
+    std::fill(image.begin(), image.end(), 255);
+    const u64 cell = settings.cell;
+    for (u64 id = 0; id < frame.side*frame.side; id++)
+    {
+        u64 unit = id/blocksInUnit, block = id%blocksInUnit;
+        u64 col = block%frame.blockWidth + unit%frame.unitWidth*frame.blockWidth;
+        u64 row = block/frame.blockWidth + unit/frame.unitWidth*frame.blockWidth;
+        const u8* rgb = color(value[id]);
+        for (u64 y = row*cell; y < (row + 1)*cell; y++)
+            for (u64 x = col*cell; x < (col + 1)*cell; x++)
+                memcpy(&image[(y*frame.width + x)*3], rgb, 3);
+    }
+
+    //Borders: one pixel between blocks, three between units.
+    for (u64 line = 0; line <= frame.side; line++)
+    {
+        u64 thickness = line%frame.blockWidth == 0 ? 3 : 1;
+        for (u64 t = 0; t < thickness; t++)
+        {
+            u64 at = std::min(line*cell + t - (line == frame.side ? thickness - 1 : 0), frame.grid - 1);
+            for (u64 i = 0; i < frame.grid; i++)
+            {
+                memset(&image[(at*frame.width + i)*3], 0, 3);
+                memset(&image[(i*frame.width + at)*3], 0, 3);
+            }
+        }
+    }
+
+    //Color scale, maximum on top.
+    for (u64 y = 0; y < frame.height; y++)
+    {
+        const u8* rgb = jet[255 - y*255/(frame.height - 1)];
+        for (u64 x = frame.width - RENDER_SCALE; x < frame.width; x++)
+            memcpy(&image[(y*frame.width + x)*3], rgb, 3);
+    }
+}
+
+/* Rows waiting for a renderer and the order of the raw stream. */
+struct RenderJob
+{
+    u64 frame;
+    u64 cycle;
+    std::vector<double> value;
+};
+
+static struct
+{
+    std::mutex lock;
+    std::condition_variable changed;
+    std::deque<RenderJob> queue;
+    bool finished = false;
+    u64 written = 0; // frames out, in order on stdout.
+    bool failed = false;
+} pool;
+
+static auto writeFrame(const RenderJob& job, const std::vector<u8>& image) -> bool
+{
+    if (strcmp(settings.output, "-") == 0)
+    {
+        std::unique_lock<std::mutex> lock(pool.lock);
+        pool.changed.wait(lock, [&] { return pool.written == job.frame; });
+        bool ok = fwrite(image.data(), 1, image.size(), stdout) == image.size();
+        pool.written++;
+        pool.changed.notify_all();
+        return ok;
+    }
+    char name[1024];
+    snprintf(name, sizeof(name), "%s/block-heat-%06lu.ppm", settings.output, job.frame);
+    FILE* file = fopen(name, "w");
+    if (file == NULL)
+    {
+        perror(name);
+        return false;
+    }
+    fprintf(file, "P6\n# cycle %lu\n%lu %lu\n255\n", job.cycle, frame.width, frame.height);
+    bool ok = fwrite(image.data(), 1, image.size(), file) == image.size();
+    return fclose(file) == 0 && ok;
+}
+
+static auto renderer(u64 blocksInUnit) -> void
+{
+    std::vector<u8> image(frame.width*frame.height*3);
+    for (;;)
+    {
+        RenderJob job;
+        {
+            std::unique_lock<std::mutex> lock(pool.lock);
+            pool.changed.wait(lock, [] { return !pool.queue.empty() || pool.finished; });
+            if (pool.queue.empty())
+                return;
+            job = std::move(pool.queue.front());
+            pool.queue.pop_front();
+            pool.changed.notify_all();
+        }
+        rasterize(job.value.data(), blocksInUnit, image);
+        if (!writeFrame(job, image))
+        {
+            std::lock_guard<std::mutex> lock(pool.lock);
+            pool.failed = true;
+        }
+    }
+}
+
+static auto usage() -> void
+{
+    printf("safe-render [-o DIRECTORY|-] [-c CELL] [-r MIN:MAX] [-p] [-j THREADS] [-f FIRST:LAST] <%s>\n", LOG_SERIES_FILE);
+    printf("  -o  directory of the block-heat-NNNNNN.ppm frames (%s), - for raw RGB24 frames on stdout\n", settings.output);
+    printf("  -c  pixels per block (%d)\n", RENDER_CELL);
+    printf("  -r  range of the color scale (%.0f:%.0f C, 0:%.0f W with -p)\n", settings.minimum, settings.maximum, MAX_POWER_PER_BLOCK);
+    printf("  -p  render the block powers instead of the temperatures\n");
+    printf("  -j  rendering threads (%lu)\n", settings.threads);
+    printf("  -f  cycles rendered\n");
+    exit(0);
+}
+
+
+int main(int argc, char* argv[])
+{
+    bool range = false;
+    for (int option; (option = getopt(argc, argv, "o:c:r:pj:f:")) != -1;)
+    {
+        switch (option)
+        {
+            case 'o': settings.output = optarg; break;
+            case 'c': settings.cell = std::max(4L, atol(optarg)); break;
+            case 'r': range = sscanf(optarg, "%lf:%lf", &settings.minimum, &settings.maximum) == 2; break;
+            case 'p': settings.power = true; break;
+            case 'j': settings.threads = std::max(1L, atol(optarg)); break;
+            case 'f': sscanf(optarg, "%lu:%lu", &settings.first, &settings.last); break;
+            default: usage();
+        }
+    }
+    if (optind != argc - 1)
+        usage();
+    if (settings.power && !range)
+    {
+        settings.minimum = 0;
+        settings.maximum = MAX_POWER_PER_BLOCK;
+    }
+
+    SeriesReader series;
+    if (!series.open(argv[optind]))
+    {
+        printf("%s: not a SAFE series.\n", argv[optind]);
+        exit(1);
+    }
+    u64 blocksInUnit = series.header.blocksInUnit;
+    frame.blockWidth = sqrt(blocksInUnit);
+    frame.unitWidth  = sqrt(series.agents()/blocksInUnit);
+    frame.side   = frame.blockWidth*frame.unitWidth;
+    frame.grid   = frame.side*settings.cell + 1;
+    frame.width  = frame.grid + settings.cell/2 + RENDER_SCALE;
+    frame.width += frame.width%2; // even sides for the video encoders.
+    frame.height = frame.grid + frame.grid%2;
+    if (frame.side*frame.side != series.agents())
+    {
+        printf("%s: the %lu blocks are not a square layout.\n", argv[optind], series.agents());
+        exit(1);
+    }
+    bool raw = strcmp(settings.output, "-") == 0;
+    if (!raw)
+        mkdir(settings.output, S_IRWXU | S_IRWXG | S_IROTH | S_IXOTH);
+    initializeColors();
+
+    u64 first = series.find(settings.first);
+    u64 last  = std::min(series.rows(), series.find(settings.last) + (settings.last != -1UL));
+    fprintf(stderr, "==> Rendering up to %lu frames of %lux%lu (%s) with %lu threads...\n",
+            last > first ? last - first : 0, frame.width, frame.height, settings.power ? "power" : "temperature", settings.threads);
+    if (raw)
+        fprintf(stderr, "    e.g. | ffmpeg -f rawvideo -pix_fmt rgb24 -s %lux%lu -r 2 -i - block-heat.mp4\n", frame.width, frame.height);
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (u64 t = 0; t < settings.threads; t++)
+        threads.emplace_back(renderer, blocksInUnit);
+
+    //Decode the rows in order and hand them out -- at most RENDER_QUEUE per thread wait.
+    std::vector<double> temperature(series.agents()), power(series.agents());
+    u64 frames = 0;
+    for (u64 row = first; row < last; row++, frames++)
+    {
+        RenderJob job = {row - first, 0, {}};
+        if (!series.read(row, job.cycle, temperature.data(), power.data()))
+        {
+            fprintf(stderr, "WARNING: %s is corrupt at sample %lu, the rest of it is skipped.\n", argv[optind], row);
+            break;
+        }
+        if (job.cycle > settings.last)
+            break;
+        job.value = settings.power ? power : temperature;
+        std::unique_lock<std::mutex> lock(pool.lock);
+        pool.changed.wait(lock, [] { return pool.queue.size() < RENDER_QUEUE*settings.threads || pool.failed; });
+        if (pool.failed)
+            break;
+        pool.queue.push_back(std::move(job));
+        pool.changed.notify_all();
+    }
+    {
+        std::lock_guard<std::mutex> lock(pool.lock);
+        pool.finished = true;
+        pool.changed.notify_all();
+    }
+    for (std::thread& thread : threads)
+        thread.join();
+    series.close();
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    fprintf(stderr, "==> %lu frames in %.2f s (%.0f frames/s)%s.\n", frames, seconds, frames/seconds, pool.failed ? ", some could not be written" : "");
+    return pool.failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,91 @@
+/*
+ * Copyright (c) 2014, University of Delaware
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef _SS_RING_GUARD_
+#define _SS_RING_GUARD_
+#include "ss-conf.h"
+#include <atomic>
+
+/* Lock-free single producer / single consumer ring. */
+//Note: the producer only writes tail and the consumer only writes head, each on
+//      its own cache line together with its cached copy of the other index.
+//      A slot is published by the release store of tail and handed back by the
+//      release store of head, so the payload never races.
+template <class TYPE, u64 DEPTH>
+struct SpscRing
+{
+    static_assert(DEPTH != 0 && (DEPTH & (DEPTH - 1)) == 0, "ring depth must be a power of two");
+
+    struct alignas(CACHE_LINE_SIZE)
+    {
+        std::atomic<u64> tail;
+        u64 head; // last head seen by the producer.
+    } producer;
+
+    struct alignas(CACHE_LINE_SIZE)
+    {
+        std::atomic<u64> head;
+        u64 tail; // last tail seen by the consumer.
+    } consumer;
+
+    alignas(CACHE_LINE_SIZE) TYPE slot[DEPTH];
+
+    /* Producer side. Returns false if the ring is full. */
+    auto push(const TYPE& value) -> bool
+    {
+        u64 tail = producer.tail.load(std::memory_order_relaxed);
+        if (tail - producer.head == DEPTH)
+        {
+            producer.head = consumer.head.load(std::memory_order_acquire);
+            if (tail - producer.head == DEPTH)
+                return false;
+        }
+        slot[tail & (DEPTH - 1)] = value;
+        producer.tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    /* Consumer side. Returns false if the ring is empty. */
+    auto pop(TYPE& value) -> bool
+    {
+        u64 head = consumer.head.load(std::memory_order_relaxed);
+        if (head == consumer.tail)
+        {
+            consumer.tail = producer.tail.load(std::memory_order_acquire);
+            if (head == consumer.tail)
+                return false;
+        }
+        value = slot[head & (DEPTH - 1)];
+        consumer.head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+};
+#endif
@@ -0,0 +1,353 @@
+/*
+ * Copyright (c) 2014, University of Delaware
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "ss-series.h"
+#include <algorithm>
+#include <cstring>
+
+/* Bit stream, most significant bit first. */
+struct BitWriter
+{
+    std::vector<u8>& bytes;
+    u64 current = 0;
+    u64 fill = 0;     // bits in current.
+
+    BitWriter(std::vector<u8>& bytes) : bytes(bytes) {}
+
+    auto put(u64 bits, u64 count) -> void
+    {
+        while (count)
+        {
+            u64 take = std::min(count, 8 - fill);
+            current = current << take | ((bits >> (count - take)) & ((1UL << take) - 1));
+            fill += take;
+            count -= take;
+            if (fill == 8)
+            {
+                bytes.push_back(current);
+                current = fill = 0;
+            }
+        }
+    }
+
+    /* Pads the last byte -- every column starts on a byte. */
+    auto flush() -> void
+    {
+        if (fill)
+            put(0, 8 - fill);
+    }
+};
+
+struct BitReader
+{
+    const u8* byte;
+    const u8* end;
+    u64 used = 0;     // bits of *byte already read.
+
+    BitReader(const u8* byte, const u8* end) : byte(byte), end(end) {}
+
+    /* Zeroes past the end (the caller checks the sizes). */
+    auto get(u64 count) -> u64
+    {
+        u64 bits = 0;
+        while (count)
+        {
+            u64 take = std::min(count, 8 - used);
+            u64 current = byte < end ? *byte : 0;
+            bits = bits << take | ((current >> (8 - used - take)) & ((1UL << take) - 1));
+            used += take;
+            count -= take;
+            if (used == 8)
+            {
+                byte++;
+                used = 0;
+            }
+        }
+        return bits;
+    }
+};
+
+/* Values of a column XOR-ed with the previous one. Equal values take one bit;
+ * the others keep the bits between the leading and trailing zeros, in the
+ * window of the previous value when they fit in it. */
+//Note: 5 bits of leading zeros (at most 31 are dropped), 6 bits of length-1.
+struct XorCoder
+{
+    u64 previous = 0;
+    u64 leading = 64;  // window of the previous value, none yet.
+    u64 trailing = 0;
+
+    auto encode(BitWriter& out, double value) -> void
+    {
+        u64 bits;
+        memcpy(&bits, &value, sizeof(bits));
+        u64 x = bits ^ previous;
+        previous = bits;
+        if (x == 0)
+        {
+            out.put(0, 1);
+            return;
+        }
+        u64 lz = std::min<u64>(__builtin_clzl(x), 31);
+        u64 tz = __builtin_ctzl(x);
+        if (leading != 64 && lz >= leading && tz >= trailing)
+        {
+            out.put(2, 2);
+            out.put(x >> trailing, 64 - leading - trailing);
+            return;
+        }
+        out.put(3, 2);
+        out.put(lz, 5);
+        out.put(64 - lz - tz - 1, 6);
+        out.put(x >> tz, 64 - lz - tz);
+        leading = lz;
+        trailing = tz;
+    }
+
+    auto decode(BitReader& in) -> double
+    {
+        if (in.get(1))
+        {
+            if (in.get(1))
+            {
+                leading = in.get(5);
+                u64 length = in.get(6) + 1;
+                trailing = 64 - leading - length;
+            }
+            previous ^= in.get(64 - leading - trailing) << trailing;
+        }
+        double value;
+        memcpy(&value, &previous, sizeof(value));
+        return value;
+    }
+};
+
+/* Cycles as deltas -- one bit while the sample interval does not change. */
+struct DeltaCoder
+{
+    u64 previous;
+    u64 delta = 0;
+
+    DeltaCoder(u64 first) : previous(first) {}
+
+    auto encode(BitWriter& out, u64 cycle) -> void
+    {
+        if (cycle - previous == delta)
+            out.put(0, 1);
+        else
+        {
+            delta = cycle - previous;
+            out.put(1, 1);
+            out.put(delta, 64);
+        }
+        previous = cycle;
+    }
+
+    auto decode(BitReader& in) -> u64
+    {
+        if (in.get(1))
+            delta = in.get(64);
+        return previous += delta;
+    }
+};
+
+auto SeriesWriter::open(const char* path, u64 agents, u64 blocksInUnit) -> bool
+{
+    if ((file = fopen(path, "w")) == NULL)
+        return false;
+    this->agents = agents;
+    SeriesFileHeader header = {{}, agents, blocksInUnit, LOG_SERIES_ROWS};
+    memcpy(header.magic, SERIES_FILE_MAGIC, sizeof(header.magic));
+    bytes = fwrite(&header, 1, sizeof(header), file);
+    return true;
+}
+
+auto SeriesWriter::append(u64 cycle, const double* temperature, const double* power) -> void
+{
+    this->cycle.push_back(cycle);
+    value.insert(value.end(), temperature, temperature + agents);
+    value.insert(value.end(), power, power + agents);
+    rows++;
+    if (this->cycle.size() == LOG_SERIES_ROWS)
+        writeBlock();
+}
+
+auto SeriesWriter::writeBlock() -> void
+{
+    u64 count = cycle.size();
+    if (count == 0)
+        return;
+    u64 columns = 1 + 2*agents;
+    std::vector<u32> offset(columns);
+    std::vector<u8> stream;
+    stream.reserve(count*columns*4);
+
+    //Column 0: the cycles (the first one is in the header).
+    BitWriter out(stream);
+    DeltaCoder cycles(cycle[0]);
+    for (u64 row=1; row<count; row++)
+        cycles.encode(out, cycle[row]);
+    out.flush();
+
+    //Then every temperature and every power column.
+    for (u64 column=1; column<columns; column++)
+    {
+        offset[column] = stream.size();
+        XorCoder values;
+        for (u64 row=0; row<count; row++)
+            values.encode(out, value[row*(columns-1) + column-1]);
+        out.flush();
+    }
+
+    SeriesBlockHeader header = {SERIES_BLOCK_MAGIC, cycle[0], cycle[count-1], count, columns, stream.size()};
+    index.push_back({cycle[0], cycle[count-1], bytes, count});
+    bytes += fwrite(&header, 1, sizeof(header), file);
+    bytes += fwrite(offset.data(), 1, columns*sizeof(u32), file);
+    bytes += fwrite(stream.data(), 1, stream.size(), file);
+    cycle.clear();
+    value.clear();
+}
+
+auto SeriesWriter::close() -> void
+{
+    writeBlock();
+    SeriesTrailer trailer = {bytes, index.size(), SERIES_TRAILER_MAGIC};
+    bytes += fwrite(index.data(), 1, index.size()*sizeof(SeriesIndexEntry), file);
+    bytes += fwrite(&trailer, 1, sizeof(trailer), file);
+    fclose(file);
+    file = NULL;
+}
+
+auto SeriesReader::open(const char* path) -> bool
+{
+    if ((file = fopen(path, "r")) == NULL)
+        return false;
+    if (fread(&header, sizeof(header), 1, file) != 1 || memcmp(header.magic, SERIES_FILE_MAGIC, sizeof(header.magic)) != 0)
+    {
+        close();
+        return false;
+    }
+
+    //Index from the footer, or from the block headers.
+    SeriesTrailer trailer;
+    if (fseek(file, -(long) sizeof(trailer), SEEK_END) == 0 && fread(&trailer, sizeof(trailer), 1, file) == 1 && trailer.magic == SERIES_TRAILER_MAGIC)
+    {
+        index.resize(trailer.blocks);
+        fseek(file, trailer.indexOffset, SEEK_SET);
+        if (fread(index.data(), sizeof(SeriesIndexEntry), index.size(), file) != index.size())
+            index.clear();
+    }
+    else
+        scan();
+
+    for (u64 block=0, row=0; block<index.size(); row+=index[block++].rows)
+        firstRow.push_back(row);
+    return true;
+}
+
+auto SeriesReader::scan() -> void
+{
+    SeriesBlockHeader block;
+    long offset = sizeof(SeriesFileHeader);
+    while (fseek(file, offset, SEEK_SET) == 0 && fread(&block, sizeof(block), 1, file) == 1 && block.magic == SERIES_BLOCK_MAGIC)
+    {
+        long next = offset + sizeof(block) + block.columns*sizeof(u32) + block.size;
+        if (fseek(file, next - 1, SEEK_SET) != 0 || fgetc(file) == EOF)
+            break; // truncated.
+        index.push_back({block.firstCycle, block.lastCycle, (u64) offset, block.rows});
+        offset = next;
+    }
+}
+
+auto SeriesReader::close() -> void
+{
+    if (file)
+        fclose(file);
+    file = NULL;
+}
+
+auto SeriesReader::find(u64 cycle) -> u64
+{
+    auto block = std::lower_bound(index.begin(), index.end(), cycle,
+                                  [](const SeriesIndexEntry& entry, u64 cycle) { return entry.lastCycle < cycle; });
+    if (block == index.end() || !readBlock(block - index.begin()))
+        return rows();
+    return firstRow[cachedBlock] + (std::lower_bound(this->cycle.begin(), this->cycle.end(), cycle) - this->cycle.begin());
+}
+
+auto SeriesReader::read(u64 row, u64& cycle, double* temperature, double* power) -> bool
+{
+    if (row >= rows())
+        return false;
+    u64 block = std::upper_bound(firstRow.begin(), firstRow.end(), row) - firstRow.begin() - 1;
+    if (!readBlock(block))
+        return false;
+    row -= firstRow[block];
+    const double* values = &value[row*2*header.agents];
+    cycle = this->cycle[row];
+    std::copy(values, values + header.agents, temperature);
+    std::copy(values + header.agents, values + 2*header.agents, power);
+    return true;
+}
+
+auto SeriesReader::readBlock(u64 block) -> bool
+{
+    if (block == cachedBlock)
+        return true;
+    SeriesBlockHeader header;
+    if (fseek(file, index[block].offset, SEEK_SET) != 0 || fread(&header, sizeof(header), 1, file) != 1 ||
+        header.magic != SERIES_BLOCK_MAGIC || header.columns != 1 + 2*this->header.agents)
+        return false;
+    std::vector<u32> offset(header.columns);
+    std::vector<u8> stream(header.size);
+    if (fread(offset.data(), sizeof(u32), header.columns, file) != header.columns ||
+        fread(stream.data(), 1, header.size, file) != header.size)
+        return false;
+
+    u64 count = header.rows;
+    cycle.resize(count);
+    value.resize(count*(header.columns-1));
+    const u8* end = stream.data() + stream.size();
+    BitReader cycles(stream.data(), end);
+    DeltaCoder delta(header.firstCycle);
+    cycle[0] = header.firstCycle;
+    for (u64 row=1; row<count; row++)
+        cycle[row] = delta.decode(cycles);
+    for (u64 column=1; column<header.columns; column++)
+    {
+        BitReader in(stream.data() + offset[column], end);
+        XorCoder values;
+        for (u64 row=0; row<count; row++)
+            value[row*(header.columns-1) + column-1] = values.decode(in);
+    }
+    cachedBlock = block;
+    return true;
+}
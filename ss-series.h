@@ -0,0 +1,149 @@
+/*
+ * Copyright (c) 2014, University of Delaware
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef _SS_SERIES_GUARD_
+#define _SS_SERIES_GUARD_
+#include "ss-conf.h"
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+/* Columnar temperature and power series (LOG_SERIES_FILE).
+ *
+ * One row per sample: the cycle, then the temperature and the power of every
+ * block (NaN where a block did not log the sample). Rows are grouped in
+ * blocks of LOG_SERIES_ROWS and each block is stored by column: the cycles as
+ * deltas, the values XOR-ed with the previous row of their column and bit
+ * packed (leading and trailing zero bits dropped). A footer indexes the
+ * blocks by cycle.
+ *
+ *   SeriesFileHeader
+ *   SeriesBlockHeader, u32 column offsets, column streams   (per block)
+ *   SeriesIndexEntry                                        (per block)
+ *   SeriesTrailer */
+#define SERIES_FILE_MAGIC    "SAFESER1"
+#define SERIES_BLOCK_MAGIC   0x4b434f4c42534553UL // "SESBLOCK"
+#define SERIES_TRAILER_MAGIC 0x5845444e49534553UL // "SESINDEX"
+
+struct SeriesFileHeader
+{
+    char magic[8];
+    u64 agents;       // blocks of the chip (values per row and quantity).
+    u64 blocksInUnit;
+    u64 blockRows;    // rows per block (the last one may have less).
+};
+
+struct SeriesBlockHeader
+{
+    u64 magic;
+    u64 firstCycle;
+    u64 lastCycle;
+    u64 rows;
+    u64 columns;      // 1 + 2*agents.
+    u64 size;         // bytes of the column streams.
+};
+
+struct SeriesIndexEntry
+{
+    u64 firstCycle;
+    u64 lastCycle;
+    u64 offset;       // of the block header in the file.
+    u64 rows;
+};
+
+struct SeriesTrailer
+{
+    u64 indexOffset;
+    u64 blocks;
+    u64 magic;
+};
+
+/* Whether a value is the NaN of a block that did not log the sample. */
+//Note: checks the bits -- std::isnan is folded to false under -ffast-math.
+inline auto seriesMissing(double value) -> bool
+{
+    u64 bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return (bits & 0x7ff0000000000000UL) == 0x7ff0000000000000UL && (bits & 0x000fffffffffffffUL) != 0;
+}
+
+/* Writes a series file row by row. */
+struct SeriesWriter
+{
+    FILE* file = NULL;
+    u64 agents = 0;
+    u64 rows = 0;                         // appended in total.
+    u64 bytes = 0;                        // written so far.
+    std::vector<u64> cycle;               // rows of the pending block...
+    std::vector<double> value;            // ...and their values, row after row.
+    std::vector<SeriesIndexEntry> index;
+
+    /* Creates the file -- false if it cannot be. */
+    auto open(const char* path, u64 agents, u64 blocksInUnit) -> bool;
+
+    /* Appends the row of the cycle (agents temperatures and powers). */
+    auto append(u64 cycle, const double* temperature, const double* power) -> void;
+
+    /* Writes the pending rows and the index, then closes the file. */
+    auto close() -> void;
+
+    auto writeBlock() -> void;
+};
+
+/* Reads a series file by row, with the block of the last row read cached. */
+struct SeriesReader
+{
+    FILE* file = NULL;
+    SeriesFileHeader header;
+    std::vector<SeriesIndexEntry> index;
+    std::vector<u64> firstRow;            // of every block.
+    u64 cachedBlock = -1UL;
+    std::vector<u64> cycle;               // rows of the cached block...
+    std::vector<double> value;            // ...and their values, row after row.
+
+    /* Opens the file -- false if it is not a series. Without a footer (the
+     * run did not end) the blocks are indexed by scanning the file. */
+    auto open(const char* path) -> bool;
+    auto close() -> void;
+
+    auto agents() const -> u64 { return header.agents; }
+    auto rows() const -> u64 { return firstRow.empty() ? 0 : firstRow.back() + index.back().rows; }
+
+    /* First row at or after the cycle, rows() if none. */
+    auto find(u64 cycle) -> u64;
+
+    /* Decodes a row: its cycle and agents() temperatures and powers. */
+    auto read(u64 row, u64& cycle, double* temperature, double* power) -> bool;
+
+    auto scan() -> void;
+    auto readBlock(u64 block) -> bool;
+};
+#endif
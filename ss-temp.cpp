@@ -29,6 +29,7 @@
  */
 
 
+#include <algorithm>
 #include "ss-temp.h"
 #include "ss-agent.h"
 #include "ss-msr.h"
@@ -91,6 +92,12 @@ void temperatureModelInit()
     }
 }
 
+/* Fraction of the temperature difference with a neighbor that flows into the block in one clock tick. */
+FLOAT_TYPE temperatureConductance()
+{
+    return std::max(my_therm_R.top_bottom_r, my_therm_R.left_right_r) * INST_PER_MEGA_INST * CYCLES_PER_ITERATION * temperature_sync_info.time_per_tick / temperature_sync_info.thermal_mass;
+}
+
 /* pass in energy in picojoules*/
 FLOAT_TYPE estimateTemperature(FLOAT_TYPE energy, FLOAT_TYPE cycles)
 {
@@ -140,10 +147,31 @@ FLOAT_TYPE computeTemperature(FLOAT_TYPE energy, FLOAT_TYPE curTemp, FLOAT_TYPE
     return curTemp; //new temperature.
 }
 
+#if THREAD_PLACEMENT == 1
+/* Counts the neighbor exchange areas a model step read and pushed heat into, and the ones on another host domain. */
+static void countExchanges(const FLOAT_TYPE pushed[4])
+{
+    const AgentMap* neighbors[4] = {agent.topNeighbor, agent.btmNeighbor, agent.lftNeighbor, agent.rhtNeighbor};
+    for (u64 i = 0; i < 4; i++)
+    {
+        if (neighbors[i] == NULL)
+            continue;
+        bool crossDomain = neighbors[i]->domain != agent.domain;
+        agent.statistics.exchangeReads++;
+        agent.statistics.exchangeReadsCrossDomain += crossDomain;
+        if (pushed[i] != 0.0)
+        {
+            agent.statistics.exchangePushes++;
+            agent.statistics.exchangePushesCrossDomain += crossDomain;
+        }
+    }
+}
+#endif
+
 /* pass in energy in picojoules*/
 void computeTemperature(FLOAT_TYPE energy, FLOAT_TYPE cycles)
 {
-    FLOAT_TYPE curTemp = agent.temperature;
+    FLOAT_TYPE curTemp = agent.exchange->temperature;
     FLOAT_TYPE heat_buffer[10] = {0};
 
     //compute heat going to neighbors (always push heat to cooler neighbors and our hotter neighbors will add heat to us)
@@ -151,29 +179,33 @@ void computeTemperature(FLOAT_TYPE energy, FLOAT_TYPE cycles)
     FLOAT_TYPE normalize = cycles * INST_PER_MEGA_INST * CYCLES_PER_ITERATION * temperature_sync_info.time_per_tick;
 
     //////heat in joules to be transfered to neighbors..
-    if (agent.topNeighbor && (curTemp-agent.topNeighbor->temperature) > 0.0) { // check if neighbor exists.
-        heat_buffer[0] = -(curTemp-agent.topNeighbor->temperature) * my_therm_R.top_bottom_r  * normalize;
-        agent.topNeighbor->temp.btm_push -= heat_buffer[0];
+    if (agent.topNeighbor && (curTemp-agent.topNeighbor->exchange->temperature) > 0.0) { // check if neighbor exists.
+        heat_buffer[0] = -(curTemp-agent.topNeighbor->exchange->temperature) * my_therm_R.top_bottom_r  * normalize;
+        agent.topNeighbor->exchange->btm_push -= heat_buffer[0];
     }
 
-    if (agent.btmNeighbor && (curTemp-agent.btmNeighbor->temperature) > 0.0) { // check if neighbor exists.
-        heat_buffer[1] = -(curTemp-agent.btmNeighbor->temperature) * my_therm_R.top_bottom_r  * normalize;
-        agent.btmNeighbor->temp.top_push -= heat_buffer[1];
+    if (agent.btmNeighbor && (curTemp-agent.btmNeighbor->exchange->temperature) > 0.0) { // check if neighbor exists.
+        heat_buffer[1] = -(curTemp-agent.btmNeighbor->exchange->temperature) * my_therm_R.top_bottom_r  * normalize;
+        agent.btmNeighbor->exchange->top_push -= heat_buffer[1];
     }
 
-    if (agent.lftNeighbor && (curTemp-agent.lftNeighbor->temperature) > 0.0) { // check if neighbor exists.
-        heat_buffer[2] = -(curTemp-agent.lftNeighbor->temperature) * my_therm_R.left_right_r * normalize;
-        agent.lftNeighbor->temp.rht_push -= heat_buffer[2];
+    if (agent.lftNeighbor && (curTemp-agent.lftNeighbor->exchange->temperature) > 0.0) { // check if neighbor exists.
+        heat_buffer[2] = -(curTemp-agent.lftNeighbor->exchange->temperature) * my_therm_R.left_right_r * normalize;
+        agent.lftNeighbor->exchange->rht_push -= heat_buffer[2];
     }
 
-    if (agent.rhtNeighbor && (curTemp-agent.rhtNeighbor->temperature) > 0.0) { // check if neighbor exists.
-        heat_buffer[3] = -(curTemp-agent.rhtNeighbor->temperature) * my_therm_R.left_right_r * normalize;
-        agent.rhtNeighbor->temp.lft_push -= heat_buffer[3];
+    if (agent.rhtNeighbor && (curTemp-agent.rhtNeighbor->exchange->temperature) > 0.0) { // check if neighbor exists.
+        heat_buffer[3] = -(curTemp-agent.rhtNeighbor->exchange->temperature) * my_therm_R.left_right_r * normalize;
+        agent.rhtNeighbor->exchange->lft_push -= heat_buffer[3];
     }
 
+    #if THREAD_PLACEMENT == 1
+    countExchanges(heat_buffer);
+    #endif
+
     //Grab pushed heat from neighbors.
-    heat_buffer[4] = agent.temp.top_push; heat_buffer[5] = agent.temp.btm_push;
-    heat_buffer[6] = agent.temp.lft_push; heat_buffer[7] = agent.temp.rht_push;
+    heat_buffer[4] = agent.exchange->top_push; heat_buffer[5] = agent.exchange->btm_push;
+    heat_buffer[6] = agent.exchange->lft_push; heat_buffer[7] = agent.exchange->rht_push;
 
     //Add cool down.
     heat_buffer[8] = (TEMPERATURE_AMBIENT-curTemp) * temperature_sync_info.thermal_r_heatsink * normalize;
@@ -197,5 +229,5 @@ void computeTemperature(FLOAT_TYPE energy, FLOAT_TYPE cycles)
     //compute temperature changes.
     //curTemp += (energy * .000000000001) /  temperature_sync_info.thermal_mass ; //temp increase from compute (constant is to get the thermal mass into picojoules)
 
-    agent.temperature = curTemp; //new temperature.
+    agent.exchange->temperature = curTemp; //new temperature.
 }
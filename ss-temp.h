@@ -34,6 +34,7 @@
 #include "ss-conf.h"
 
 void temperatureModelInit();
+FLOAT_TYPE temperatureConductance();
 FLOAT_TYPE estimateTemperature(FLOAT_TYPE energy, FLOAT_TYPE cycles);
 FLOAT_TYPE computeTemperature(FLOAT_TYPE energy, FLOAT_TYPE curTemp, FLOAT_TYPE topNeighborTemp, FLOAT_TYPE btmNeighborTemp, FLOAT_TYPE lftNeighborTemp, FLOAT_TYPE rhtNeighborTemp);
 void computeTemperature(FLOAT_TYPE energy, FLOAT_TYPE cycles);
@@ -0,0 +1,153 @@
+/*
+ * Copyright (c) 2014, University of Delaware
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+
+#ifndef _SS_TIMER_GUARD_
+#define _SS_TIMER_GUARD_
+#include "ss-conf.h"
+
+/* Hierarchical timer wheel keyed on clock ticks. */
+//Note: level 0 has one slot per tick of the current group of SLOTS ticks and
+//      level 1 one slot per group of the next SLOTS groups. Deadlines further
+//      away wait in the overflow set, which is placed again each time level 1
+//      wraps. Timers are the bits of a u64 so a slot is a bitmap: expiring a
+//      tick is one load, and a level 1 slot cascades when its group starts.
+template <u64 TIMERS>
+struct TimerWheel
+{
+    static_assert(TIMERS <= 64, "timers are the bits of a u64");
+
+    static const u64 BITS  = 6;
+    static const u64 SLOTS = 1UL << BITS;
+    static const u64 NEVER = (u64) -1;
+
+    u64 now;              // last tick expired.
+    u64 ready;            // timers due at the next advance.
+    u64 deadline[TIMERS]; // NEVER when not armed.
+    u64* slot[TIMERS];    // bitmap holding an armed timer.
+    u64 level0[SLOTS];
+    u64 level1[SLOTS];
+    u64 overflow;
+
+    auto init(u64 tick) -> void
+    {
+        now = tick;
+        ready = 0;
+        overflow = 0;
+        for (u64 i = 0; i < TIMERS; i++)
+        {
+            deadline[i] = NEVER;
+            slot[i] = 0;
+        }
+        for (u64 i = 0; i < SLOTS; i++)
+            level0[i] = level1[i] = 0;
+    }
+
+    /* Arms a timer, unless it already fires by then. Past ticks fire at the next advance. */
+    auto schedule(u64 timer, u64 tick) -> void
+    {
+        if (deadline[timer] <= tick)
+            return;
+        cancel(timer);
+        if (tick <= now)
+        {
+            deadline[timer] = now;
+            ready |= 1UL << timer;
+            return;
+        }
+        deadline[timer] = tick;
+        place(timer);
+    }
+
+    auto cancel(u64 timer) -> void
+    {
+        if (deadline[timer] == NEVER)
+            return;
+        if (slot[timer])
+            *slot[timer] &= ~(1UL << timer);
+        ready &= ~(1UL << timer);
+        slot[timer] = 0;
+        deadline[timer] = NEVER;
+    }
+
+    /* Moves the wheel up to a tick and returns the timers that fired (they are disarmed). */
+    auto advance(u64 tick) -> u64
+    {
+        u64 fired = ready;
+        ready = 0;
+        while (now < tick)
+        {
+            now++;
+            if ((now & (SLOTS-1)) == 0)
+            {
+                u64 group = now >> BITS;
+                //Level 1 wrapped -- bring in the overflow.
+                if ((group & (SLOTS-1)) == 0)
+                {
+                    u64 bits = overflow;
+                    overflow = 0;
+                    for (; bits != 0; bits &= bits - 1)
+                        place(__builtin_ctzl(bits));
+                }
+                //Cascade the group that starts.
+                u64 bits = level1[group & (SLOTS-1)];
+                level1[group & (SLOTS-1)] = 0;
+                for (; bits != 0; bits &= bits - 1)
+                    place(__builtin_ctzl(bits));
+            }
+            fired |= level0[now & (SLOTS-1)];
+            level0[now & (SLOTS-1)] = 0;
+        }
+        for (u64 bits = fired; bits != 0; bits &= bits - 1)
+        {
+            u64 timer = __builtin_ctzl(bits);
+            deadline[timer] = NEVER;
+            slot[timer] = 0;
+        }
+        return fired;
+    }
+
+private:
+    /* Puts an armed timer in the slot of its deadline relative to now. */
+    auto place(u64 timer) -> void
+    {
+        u64 tick = deadline[timer];
+        u64 groups = (tick >> BITS) - (now >> BITS);
+        if (groups == 0)
+            slot[timer] = &level0[tick & (SLOTS-1)];
+        else if (groups < SLOTS)
+            slot[timer] = &level1[(tick >> BITS) & (SLOTS-1)];
+        else
+            slot[timer] = &overflow;
+        *slot[timer] |= 1UL << timer;
+    }
+};
+#endif
@@ -0,0 +1,117 @@
+/*
+ * Copyright (c) 2014, University of Delaware
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/* safe-top: watches a running simulation through its live state (LIVE),
+ * attached read-only -- the run never waits for it. */
+
+#include "ss-live.h"
+#include <cerrno>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+
+int main(int argc, char* argv[])
+{
+    u64 interval = 1000; // ms.
+    bool once = false;
+    for (int option; (option = getopt(argc, argv, "n:1h")) != -1;)
+    {
+        switch (option)
+        {
+            case 'n': interval = std::max(10L, atol(optarg)); break;
+            case '1': once = true; break;
+            default:
+                printf("safe-top [-n MILLISECONDS] [-1] PID | NAME\n");
+                printf("  -n  refresh interval (1000)\n");
+                printf("  -1  print the state once, without clearing the screen\n");
+                printf("  -h  this help\n");
+                printf("  PID of the run (%s-PID) or NAME of the shared memory object\n", LIVE_NAME);
+                exit(0);
+        }
+    }
+    if (optind >= argc)
+    {
+        printf("safe-top: the PID of the run or the NAME of its shared memory object is missing (-h).\n");
+        exit(1);
+    }
+    const char* argument = argv[optind];
+    std::string name = argument;
+    if (*argument && strspn(argument, "0123456789") == strlen(argument))
+        name = LIVE_NAME "-" + name;
+
+    LiveRegion* region = liveAttach(name.c_str());
+    if (region == NULL)
+    {
+        printf("No SAFE run publishes %s (built with LIVE 1?).\n", name.c_str());
+        exit(1);
+    }
+    const u64 agents = region->header.agents;
+    std::vector<double> temperature(agents), power(agents);
+    LiveState state;
+    for (;;)
+    {
+        //Note: sequence 0 -- the run did not publish its first state yet.
+        if (region->sequence.load(std::memory_order_acquire) == 0)
+        {
+            if (kill(region->header.pid, 0) != 0 && errno == ESRCH)
+            {
+                printf("SAFE run %lu: gone before publishing any state.\n", region->header.pid);
+                return EXIT_FAILURE;
+            }
+            usleep(std::min(interval, 100UL)*1000);
+            continue;
+        }
+        LiveReadStatus status = liveRead(region, state, temperature.data(), power.data());
+        if (status == LIVE_READ_STALE)
+        {
+            printf("SAFE run %lu: gone in the middle of a write, stale state.\n", region->header.pid);
+            return EXIT_FAILURE;
+        }
+        if (status == LIVE_READ_BUSY)
+        {
+            usleep(interval*1000);
+            continue;
+        }
+        bool gone = kill(region->header.pid, 0) != 0 && errno == ESRCH;
+        if (!once)
+            printf("\033[H\033[2J");
+        printf("SAFE run %lu: %lu blocks%s\n", region->header.pid, agents, state.done ? ", done" : gone ? ", gone" : "");
+        livePrint(stdout, state, temperature.data(), power.data(), agents, region->header.blocksInUnit);
+        if (once || state.done || gone)
+            break;
+        usleep(interval*1000);
+    }
+    return EXIT_SUCCESS;
+}
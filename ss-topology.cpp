@@ -0,0 +1,247 @@
+/*
+ * Copyright (c) 2014, University of Delaware
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "ss-topology.h"
+#include "ss-agent.h"
+#include <vector>
+#include <set>
+#include <cstdio>
+#include <cstdlib>
+#include <pthread.h>
+#include <sched.h>
+
+#define SYSFS_NODE_PATH "/sys/devices/system/node"
+#define SYSFS_CPU_PATH  "/sys/devices/system/cpu"
+#define MAX_SYSFS_ENTRIES 4096 // max nodes/cpus probed.
+
+/* CPUs of each domain -- only the ones the process is allowed to run on. */
+static std::vector<std::vector<u64>> domains;
+static cpu_set_t initialAffinity;
+
+/* Parses a sysfs cpulist ("0-3,8,10-11") into the given set. Returns false if it cannot be read. */
+static auto readCpuList(const char* path, std::set<u64>& cpus) -> bool
+{
+    FILE* file = fopen(path, "r");
+    if (file == NULL)
+        return false;
+
+    unsigned long first, last;
+    int c;
+    while (fscanf(file, "%lu", &first) == 1)
+    {
+        last = first;
+        if ((c = fgetc(file)) == '-')
+        {
+            if (fscanf(file, "%lu", &last) != 1)
+                break;
+            c = fgetc(file);
+        }
+        for (u64 cpu = first; cpu <= last; cpu++)
+            if (cpu < CPU_SETSIZE && CPU_ISSET(cpu, &initialAffinity))
+                cpus.insert(cpu);
+        if (c != ',')
+            break;
+    }
+    fclose(file);
+    return true;
+}
+
+/* Adds the domain if it has usable CPUs and was not seen already. */
+static auto addDomain(const std::set<u64>& cpus) -> void
+{
+    if (cpus.empty())
+        return;
+    std::vector<u64> domain(cpus.begin(), cpus.end());
+    for (auto& d : domains)
+        if (d == domain)
+            return;
+    domains.push_back(domain);
+}
+
+auto readTopology() -> u64
+{
+    char path[1024];
+    const char* source = "NUMA nodes";
+
+    domains.clear();
+    if (sched_getaffinity(0, sizeof(cpu_set_t), &initialAffinity) != 0)
+        fatal("sched_getaffinity");
+
+    //NUMA nodes -- memory only nodes have an empty cpulist and are skipped.
+    for (u64 node = 0; node < MAX_SYSFS_ENTRIES; node++)
+    {
+        std::set<u64> cpus;
+        sprintf(path, SYSFS_NODE_PATH "/node%lu/cpulist", node);
+        if (!readCpuList(path, cpus))
+            continue;
+        addDomain(cpus);
+    }
+
+    //Single node -- fall back to the L3 groups.
+    if (domains.size() <= 1)
+    {
+        std::vector<std::vector<u64>> nodes;
+        nodes.swap(domains);
+        for (u64 cpu = 0; cpu < CPU_SETSIZE; cpu++)
+        {
+            if (!CPU_ISSET(cpu, &initialAffinity))
+                continue;
+            for (u64 index = 0; index < MAX_SYSFS_ENTRIES; index++)
+            {
+                int level = 0;
+                sprintf(path, SYSFS_CPU_PATH "/cpu%lu/cache/index%lu/level", cpu, index);
+                FILE* file = fopen(path, "r");
+                if (file == NULL)
+                    break;
+                if (fscanf(file, "%d", &level) != 1)
+                    level = 0;
+                fclose(file);
+                if (level != 3)
+                    continue;
+                std::set<u64> cpus;
+                sprintf(path, SYSFS_CPU_PATH "/cpu%lu/cache/index%lu/shared_cpu_list", cpu, index);
+                if (readCpuList(path, cpus))
+                    addDomain(cpus);
+            }
+        }
+        source = "L3 caches";
+        if (domains.size() <= 1)
+        {
+            domains.swap(nodes);
+            source = "NUMA nodes";
+        }
+    }
+
+    //No sysfs at all -- a single domain with every CPU we may run on.
+    if (domains.empty())
+    {
+        std::set<u64> cpus;
+        for (u64 cpu = 0; cpu < CPU_SETSIZE; cpu++)
+            if (CPU_ISSET(cpu, &initialAffinity))
+                cpus.insert(cpu);
+        addDomain(cpus);
+        source = "affinity mask";
+    }
+
+    printf("==> Host topology: %lu domain(s) from %s.\n", (u64) domains.size(), source);
+    for (u64 i = 0; i < domains.size(); i++)
+    {
+        u64 first = i*N_UNITS_IN_CHIP/domains.size();
+        u64 last = (i+1)*N_UNITS_IN_CHIP/domains.size();
+        if (last > first)
+            printf("  * Domain %lu: %lu cpu(s), units %lu-%lu.\n", i, (u64) domains[i].size(), first, last-1);
+        else
+            printf("  * Domain %lu: %lu cpu(s), unused.\n", i, (u64) domains[i].size());
+    }
+    return domains.size();
+}
+
+auto unitDomain(u64 uid) -> u64
+{
+    //Contiguous unit ranges -- units are numbered row major so vertical and
+    //horizontal unit neighbors mostly end up on the same domain.
+    if (domains.empty())
+        return 0;
+    return uid*domains.size()/N_UNITS_IN_CHIP;
+}
+
+auto pinToDomain(u64 domain) -> bool
+{
+    if (domain >= domains.size())
+        return false;
+
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    for (u64 cpu : domains[domain])
+        CPU_SET(cpu, &cpuset);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuset) != 0)
+    {
+        printf("WARNING: could not pin thread to domain %lu.\n", domain);
+        return false;
+    }
+    return true;
+}
+
+auto unpinThread() -> void
+{
+    pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &initialAffinity);
+}
+
+auto reportPlacement() -> void
+{
+    u64 neighborLinks = 0, neighborCrossLinks = 0;
+    u64 parentLinks = 0, parentCrossLinks = 0;
+
+    for (u64 i = 0; i < N_UNITS_IN_CHIP*N_BLOCKS_IN_UNIT; i++)
+    {
+        AgentMap* a = agentMap[i];
+        AgentMap* neighbors[4] = {a->topNeighbor, a->btmNeighbor, a->lftNeighbor, a->rhtNeighbor};
+        for (AgentMap* n : neighbors)
+        {
+            if (n == NULL)
+                continue;
+            neighborLinks++;
+            if (n->domain != a->domain)
+                neighborCrossLinks++;
+        }
+
+        //Parent of the block role, then of the unit role.
+        AgentMap* parent = (a->bid != 0) ? agentMap[a->uid*N_BLOCKS_IN_UNIT] : (a->uid != 0 ? agentMap[0] : NULL);
+        if (parent != NULL)
+        {
+            parentLinks++;
+            if (parent->domain != a->domain)
+                parentCrossLinks++;
+        }
+    }
+
+    //Static links only -- the traffic they carry is counted during the run (reportCrossDomainTraffic).
+    printf("==> Thread placement:\n");
+    printf("  * Neighbor links crossing domains: %lu of %lu.\n", neighborCrossLinks, neighborLinks);
+    printf("  * Parent links crossing domains:   %lu of %lu.\n", parentCrossLinks, parentLinks);
+}
+
+auto reportCrossDomainTraffic() -> void
+{
+    u64 reads = 0, crossReads = 0, pushes = 0, crossPushes = 0, messages = 0, crossMessages = 0;
+    for (u64 i = 0; i < N_UNITS_IN_CHIP*N_BLOCKS_IN_UNIT; i++)
+    {
+        auto& statistics = agentMap[i]->statistics;
+        reads         += statistics.exchangeReads;
+        crossReads    += statistics.exchangeReadsCrossDomain;
+        pushes        += statistics.exchangePushes;
+        crossPushes   += statistics.exchangePushesCrossDomain;
+        messages      += statistics.messagesSent;
+        crossMessages += statistics.messagesCrossDomain;
+    }
+    printf("  * Cross-domain traffic: %lu of %lu neighbor exchange reads, %lu of %lu heat pushes, %lu of %lu SA messages\n",
+           crossReads, reads, crossPushes, pushes, crossMessages, messages);
+}
@@ -0,0 +1,55 @@
+/*
+ * Copyright (c) 2014, University of Delaware
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef _SS_TOPOLOGY_GUARD_
+#define _SS_TOPOLOGY_GUARD_
+#include "ss-conf.h"
+
+/* Host topology used to place the engines -- read from sysfs. */
+//Note: a domain is a NUMA node with CPUs. If the host has a single node the
+//      L3 groups are used instead so units still keep their traffic in one cache.
+auto readTopology() -> u64;
+
+/* Domain a whole unit is placed on. */
+auto unitDomain(u64 uid) -> u64;
+
+/* Pins the calling thread to every CPU of the domain (threads created after inherit it). */
+auto pinToDomain(u64 domain) -> bool;
+
+/* Restores the affinity the process was started with for the calling thread. */
+auto unpinThread() -> void;
+
+/* Prints how many neighbor and parent links cross domains -- after the agents are initialized. */
+auto reportPlacement() -> void;
+
+/* Prints the neighbor exchanges and SA messages that crossed domains during the run. */
+auto reportCrossDomainTraffic() -> void;
+#endif
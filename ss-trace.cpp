@@ -0,0 +1,133 @@
+/*
+ * Copyright (c) 2014, University of Delaware
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "ss-trace.h"
+#include "ss-msr.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+#if TRACE == 1
+/* Events of one engine thread -- only written by it, read once every thread is done. */
+struct alignas(CACHE_LINE_SIZE) TraceBuffer
+{
+    TraceEvent* events; // TRACE_EVENTS of them, only the used pages are touched.
+    u64 count;
+    u64 dropped;
+};
+
+static thread_local TraceBuffer* traceBuffer;
+
+/* Buffers of every engine thread -- indexed by agent id. */
+static TraceBuffer traceBuffers[N_UNITS_IN_CHIP*N_BLOCKS_IN_UNIT];
+
+static auto traceNow() -> u64
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+auto traceRegister(u64 id) -> void
+{
+    traceBuffer = &traceBuffers[id];
+    traceBuffer->events = (TraceEvent*) malloc(TRACE_EVENTS*sizeof(TraceEvent));
+    if (traceBuffer->events == NULL)
+    {
+        printf("unt%02ld.blk%02ld: WARNING: no memory for the trace buffer, the thread is not traced.\n", id/N_BLOCKS_IN_UNIT, id%N_BLOCKS_IN_UNIT);
+        traceBuffer = NULL;
+    }
+}
+
+auto traceRecord(u64 kind, const char* name, u64 value) -> void
+{
+    TraceBuffer* buffer = traceBuffer;
+    if (buffer == NULL)
+        return;
+    if (buffer->count == TRACE_EVENTS)
+    {
+        buffer->dropped++;
+        return;
+    }
+    buffer->events[buffer->count++] = {traceNow(), name, readClockMSR(), value, kind};
+}
+
+//Note: timestamps are microseconds from the first event. A span still open
+//      when its buffer filled up has no end and lasts to the end of the view.
+auto traceWrite() -> void
+{
+    const u64 threads = N_UNITS_IN_CHIP*N_BLOCKS_IN_UNIT;
+    char path[1024];
+    const char* SAFE_LOGS_PATH = getenv("SAFE_LOGS_PATH");
+    if (SAFE_LOGS_PATH == 0) SAFE_LOGS_PATH = "./logs";
+    snprintf(path, sizeof(path), "%s/%s", SAFE_LOGS_PATH, TRACE_FILE);
+    FILE* file = fopen(path, "w");
+    if (file == NULL)
+    {
+        printf("WARNING: could not write the trace to %s.\n", path);
+        return;
+    }
+
+    u64 origin = (u64) -1, events = 0, dropped = 0, full = 0;
+    for (u64 i=0; i<threads; i++)
+        if (traceBuffers[i].count != 0)
+            origin = std::min(origin, traceBuffers[i].events[0].time);
+
+    fprintf(file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    fprintf(file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":0,\"tid\":0,\"args\":{\"name\":\"safe\"}}");
+    for (u64 i=0; i<threads; i++)
+    {
+        const TraceBuffer& buffer = traceBuffers[i];
+        if (buffer.events == NULL)
+            continue;
+        fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%ld,\"args\":{\"name\":\"unt%02ld.blk%02ld\"}}", i, i/N_BLOCKS_IN_UNIT, i%N_BLOCKS_IN_UNIT);
+        fprintf(file, ",\n{\"name\":\"thread_sort_index\",\"ph\":\"M\",\"pid\":0,\"tid\":%ld,\"args\":{\"sort_index\":%ld}}", i, i);
+        for (u64 e=0; e<buffer.count; e++)
+        {
+            const TraceEvent& event = buffer.events[e];
+            double ts = (event.time - origin)*1e-3;
+            if (event.kind == TRACE_END)
+                fprintf(file, ",\n{\"ph\":\"E\",\"pid\":0,\"tid\":%ld,\"ts\":%.3f}", i, ts);
+            else
+                fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"%c\",%s\"pid\":0,\"tid\":%ld,\"ts\":%.3f,\"args\":{\"cycle\":%ld,\"value\":%ld}}",
+                        event.name, (char) event.kind, event.kind == TRACE_INSTANT ? "\"s\":\"t\"," : "", i, ts, event.cycle*INST_PER_MEGA_INST, event.value);
+        }
+        events += buffer.count;
+        dropped += buffer.dropped;
+        full += buffer.dropped != 0;
+    }
+    fprintf(file, "\n]}\n");
+    fclose(file);
+
+    printf("==> Trace: %ld events written to %s (chrome://tracing or ui.perfetto.dev).\n", events, path);
+    if (dropped != 0)
+        printf("  * WARNING: %ld threads filled their buffer of %d events, %ld later events were dropped.\n", full, TRACE_EVENTS, dropped);
+}
+#endif
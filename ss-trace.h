@@ -0,0 +1,85 @@
+/*
+ * Copyright (c) 2014, University of Delaware
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef _SS_TRACE_GUARD_
+#define _SS_TRACE_GUARD_
+#include "ss-conf.h"
+
+/* Kinds of trace events -- the Chrome trace-event phases. */
+enum TraceKind
+{
+    TRACE_BEGIN   = 'B', // a span starts (phase, barrier arrive, ...).
+    TRACE_END     = 'E', // the innermost open span of the thread ends.
+    TRACE_INSTANT = 'i'  // a point in time (message sent or received).
+};
+
+#if TRACE == 1
+/* One event of the timeline. */
+//Note: names are string literals -- only the pointer is kept.
+struct TraceEvent
+{
+    u64 time;         // host nanoseconds (steady clock).
+    const char* name;
+    u64 cycle;        // simulated clock tick of the thread.
+    u64 value;        // event argument (peer agent, tick count...).
+    u64 kind;
+};
+
+/* Records an event in the buffer of the calling thread -- dropped if it has none or it is full. */
+auto traceRecord(u64 kind, const char* name, u64 value) -> void;
+
+/* Records a span over the enclosing scope. */
+struct TraceScope
+{
+    TraceScope(const char* name, u64 value) { traceRecord(TRACE_BEGIN, name, value); }
+    ~TraceScope() { traceRecord(TRACE_END, "", 0); }
+};
+
+#define TRACE_NAME_(line) trace_##line
+#define TRACE_NAME(line) TRACE_NAME_(line)
+#define TRACE_SCOPE(name, value)   TraceScope TRACE_NAME(__LINE__)(name, value)
+#define TRACE_SPAN_BEGIN(name, value) traceRecord(TRACE_BEGIN, name, value)
+#define TRACE_SPAN_END()           traceRecord(TRACE_END, "", 0)
+#define TRACE_INSTANT_EVENT(name, value) traceRecord(TRACE_INSTANT, name, value)
+
+/* Gives the calling thread the buffer of the agent id -- events before are dropped. */
+//Note: buffers outlive the threads so the trace can be written once they exit.
+auto traceRegister(u64 id) -> void;
+
+/* Writes every buffer to SAFE_LOGS_PATH/TRACE_FILE as Chrome trace-event JSON -- after all the threads are done. */
+auto traceWrite() -> void;
+#else
+#define TRACE_SCOPE(name, value)
+#define TRACE_SPAN_BEGIN(name, value)
+#define TRACE_SPAN_END()
+#define TRACE_INSTANT_EVENT(name, value)
+#endif
+#endif